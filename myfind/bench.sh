@@ -0,0 +1,226 @@
+#!/bin/sh
+#
+# bench.sh - Generates reproducible synthetic directory trees and measures
+# myfind (and GNU find, if available) on them.
+#
+# Usage: bench.sh [<path to myfind>]
+#
+# The size of the trees and the number of runs can be adjusted with the
+# following environment variables:
+#
+#   BENCH_DIR              Directory in which to create the trees. A temporary
+#                          directory is created (and removed) if not set.
+#   BENCH_WIDE_FILES       Number of files in the single wide directory. (1000000)
+#   BENCH_DEEP_LEVELS      Number of nested directories in the deep tree. (5000)
+#   BENCH_REALISTIC_FILES  Number of files in the source checkout like tree. (200000)
+#   BENCH_RUNS             Number of measured runs per mode; the best is reported. (3)
+#   BENCH_SEED             Seed of the pseudo random generator. (1)
+#   BENCH_TREES            Space separated list of trees to run. (wide deep realistic)
+
+set -e
+
+MYFIND=${1:-./myfind}
+WIDE_FILES=${BENCH_WIDE_FILES:-1000000}
+DEEP_LEVELS=${BENCH_DEEP_LEVELS:-5000}
+REALISTIC_FILES=${BENCH_REALISTIC_FILES:-200000}
+RUNS=${BENCH_RUNS:-3}
+SEED=${BENCH_SEED:-1}
+TREES=${BENCH_TREES:-"wide deep realistic"}
+
+if [ ! -x "$MYFIND" ]; then
+	echo "bench.sh: \"$MYFIND\" is not executable; build it with \"make\" first." >&2
+	exit 1
+fi
+
+# Resolve the binary before changing directories
+MYFIND=$(cd "$(dirname "$MYFIND")" && pwd)/$(basename "$MYFIND")
+
+if [ -n "$BENCH_DIR" ]; then
+	mkdir -p "$BENCH_DIR"
+	ROOT=$BENCH_DIR
+else
+	ROOT=$(mktemp -d "${TMPDIR:-/tmp}/myfind-bench.XXXXXX")
+	trap 'rm -rf "$ROOT"' EXIT INT TERM
+fi
+
+GNU_FIND=
+if find --version 2>/dev/null | grep -q GNU; then
+	GNU_FIND=find
+fi
+
+STRACE=
+if command -v strace >/dev/null 2>&1; then
+	STRACE=strace
+fi
+
+
+########## Tree generators ##########
+
+# A single directory containing $WIDE_FILES empty files
+generate_wide() {
+	mkdir -p "$1"
+	(cd "$1" && awk -v n="$WIDE_FILES" 'BEGIN { for (i = 0; i < n; i++) printf "file%07d\n", i }' | xargs touch)
+}
+
+# A chain of $DEEP_LEVELS nested directories with one file on each level.
+# The full paths exceed PATH_MAX, which is part of what is measured.
+generate_deep() {
+	mkdir -p "$1"
+	(
+		cd "$1"
+		level=0
+		while [ "$level" -lt "$DEEP_LEVELS" ]; do
+			: > f
+			mkdir d
+			cd d
+			level=$((level + 1))
+		done
+	)
+}
+
+# A tree resembling a source checkout: nested modules with source files,
+# headers, scripts, documentation, build output, a few symbolic links and
+# a version control directory with many small objects. File sizes follow a
+# log-normal like distribution; files are sparse to keep generation fast.
+generate_realistic() {
+	mkdir -p "$1"
+	(
+		cd "$1"
+		awk -v n="$REALISTIC_FILES" -v seed="$SEED" '
+		BEGIN {
+			srand(seed)
+			split("c h c cpp hpp py md txt json sh mk o", ext, " ")
+			dirs = 0
+			path[dirs++] = "src"
+			# Roughly 20 files per directory, nested up to 8 levels
+			for (d = 1; d < n / 20; d++) {
+				parent = path[int(rand() * dirs)]
+				depth = split(parent, parts, "/")
+				if (depth >= 8)
+					parent = "src"
+				path[dirs++] = parent "/mod" d
+			}
+			for (d = 0; d < dirs; d++)
+				print "D " path[d]
+			for (i = 0; i < n; i++) {
+				if (rand() < 0.15) {
+					# Version control objects: many small files in 256 fan-out directories
+					print "F 40 .git/objects/" sprintf("%02x", int(rand() * 256)) "/obj" i
+					continue
+				}
+				e = ext[1 + int(rand() * 12)]
+				# Sum of uniform values approximates a normal distribution of the exponent
+				x = (rand() + rand() + rand() + rand() - 2) * 3 + 8
+				size = int(exp(x))
+				print "F " size " " path[int(rand() * dirs)] "/file" i "." e
+			}
+			for (i = 0; i < n / 500; i++)
+				print "L " path[int(rand() * dirs)] "/link" i
+		}' > ../realistic.list
+
+		awk '$1 == "D" { print $2 }' ../realistic.list | xargs mkdir -p
+		awk '$1 == "F" { n = split($3, p, "/"); d = substr($3, 1, length($3) - length(p[n]) - 1); print d }' ../realistic.list | sort -u | xargs mkdir -p
+		# Group the files by size, so that a single truncate call creates many files
+		awk '$1 == "F" { print $2, $3 }' ../realistic.list | sort -n -k1,1 | awk '
+			$1 != size { if (files != "") print size files; size = $1; files = "" }
+			{ files = files " " $2; if (length(files) > 60000) { print size files; files = "" } }
+			END { if (files != "") print size files }' |
+		while read -r size files; do
+			# shellcheck disable=SC2086
+			truncate -s "$size" $files
+		done
+		awk '$1 == "L" { print $2 }' ../realistic.list | while read -r link; do
+			ln -s ../README.md "$link"
+		done
+		rm -f ../realistic.list
+	)
+}
+
+
+########## Measurement ##########
+
+# Prints the current time in seconds with nanosecond precision
+now() {
+	date +%s.%N
+}
+
+# Runs a command $RUNS times and prints the best wall time in seconds
+best_time() {
+	best=
+	run=0
+	while [ "$run" -lt "$RUNS" ]; do
+		start=$(now)
+		"$@" > /dev/null 2>&1 || true
+		end=$(now)
+		elapsed=$(echo "$end $start" | awk '{ printf "%.3f", $1 - $2 }')
+		if [ -z "$best" ] || awk -v a="$elapsed" -v b="$best" 'BEGIN { exit !(a < b) }'; then
+			best=$elapsed
+		fi
+		run=$((run + 1))
+	done
+	echo "$best"
+}
+
+# Prints the total number of system calls made by a command, or "-" without strace
+count_syscalls() {
+	if [ -z "$STRACE" ]; then
+		echo "-"
+		return
+	fi
+	"$STRACE" -f -c -o "$ROOT/strace.out" "$@" > /dev/null 2>&1 || true
+	# The calls are the fourth column, whether or not the error column is present
+	awk '$NF == "total" { print $4; found = 1 } END { if (!found) print "-" }' "$ROOT/strace.out"
+}
+
+# Prints the number of entries read by myfind according to its statistics
+count_entries() {
+	"$MYFIND" -D stats "$@" 2>&1 > /dev/null | awk '/entries read/ { print $3 }'
+}
+
+# Prints one line of the result table
+report() {
+	tree=$1 mode=$2 tool=$3 seconds=$4 entries=$5 syscalls=$6
+	rate=$(awk -v e="$entries" -v s="$seconds" 'BEGIN { if (s > 0 && e > 0) printf "%.0f", e / s; else print "-" }')
+	printf "%-10s %-16s %-8s %10s %12s %14s %12s\n" "$tree" "$mode" "$tool" "$seconds" "$entries" "$rate" "$syscalls"
+}
+
+# Measures myfind and, if available, GNU find with the same arguments
+measure() {
+	tree=$1 mode=$2
+	shift 2
+
+	# Warm the caches, so that all runs measure the same thing
+	"$MYFIND" "$ROOT/$tree" "$@" > /dev/null 2>&1 || true
+
+	entries=$(count_entries "$ROOT/$tree" "$@")
+	seconds=$(best_time "$MYFIND" "$ROOT/$tree" "$@")
+	report "$tree" "$mode" myfind "$seconds" "${entries:-0}" "$(count_syscalls "$MYFIND" "$ROOT/$tree" "$@")"
+
+	if [ -n "$GNU_FIND" ] && [ "$mode" != "summary" ]; then
+		seconds=$(best_time "$GNU_FIND" "$ROOT/$tree" "$@")
+		report "$tree" "$mode" find "$seconds" "${entries:-0}" "$(count_syscalls "$GNU_FIND" "$ROOT/$tree" "$@")"
+	fi
+}
+
+
+########## Main ##########
+
+echo "Generating trees in $ROOT (seed $SEED)"
+
+for tree in $TREES; do
+	if [ ! -d "$ROOT/$tree" ]; then
+		start=$(now)
+		"generate_$tree" "$ROOT/$tree"
+		echo "  $tree: $(echo "$(now) $start" | awk '{ printf "%.1f", $1 - $2 }') s"
+	fi
+done
+
+echo
+printf "%-10s %-16s %-8s %10s %12s %14s %12s\n" tree mode tool seconds entries entries/sec syscalls
+
+for tree in $TREES; do
+	measure "$tree" print
+	measure "$tree" type-f -type f
+	measure "$tree" name-glob -name '*.c'
+	measure "$tree" summary -summary
+done
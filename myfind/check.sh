@@ -0,0 +1,113 @@
+#!/bin/sh
+#
+# check.sh - Compares the output of myfind with GNU find for the inode
+# predicates -inum, -samefile and -links.
+#
+# Usage: check.sh [<path to myfind>]
+#
+# myfind decides -inum and -samefile from the inode numbers returned by
+# readdir() where it can. At mount points, these differ from the ones
+# returned by lstat(), so the tree contains a mount point if a tmpfs can be
+# mounted, which usually requires root. Each query runs on the walk and on
+# the stat threads, which only examine directories with more than 1024
+# entries.
+
+set -e
+
+MYFIND=${1:-./myfind}
+
+if [ ! -x "$MYFIND" ]; then
+	echo "check.sh: \"$MYFIND\" is not executable; build it with \"make\" first." >&2
+	exit 1
+fi
+
+if ! find --version 2>/dev/null | grep -q GNU; then
+	echo "check.sh: GNU find is needed to compare the output with." >&2
+	exit 1
+fi
+
+# Resolve the binary before changing directories
+MYFIND=$(cd "$(dirname "$MYFIND")" && pwd)/$(basename "$MYFIND")
+
+ROOT=$(mktemp -d "${TMPDIR:-/tmp}/myfind-check.XXXXXX")
+MOUNTED=
+
+cleanup() {
+	if [ -n "$MOUNTED" ]; then
+		umount "$ROOT/wide/mnt"
+	fi
+
+	rm -rf "$ROOT"
+}
+
+trap cleanup EXIT INT TERM
+
+
+########## Tree ##########
+
+# A directory too large to be examined in a single chunk, holding hard links
+# of a file in another directory, and a mount point
+mkdir -p "$ROOT/wide/mnt" "$ROOT/other"
+(cd "$ROOT/wide" && awk 'BEGIN { for (i = 0; i < 3000; i++) printf "file%04d\n", i }' | xargs touch)
+echo content > "$ROOT/other/original"
+ln "$ROOT/other/original" "$ROOT/wide/link1"
+ln "$ROOT/other/original" "$ROOT/wide/link2"
+
+if mount -t tmpfs myfind-check "$ROOT/wide/mnt" 2>/dev/null; then
+	MOUNTED=yes
+	echo inside > "$ROOT/wide/mnt/file"
+else
+	echo "Cannot mount a tmpfs; checking without a mount point"
+fi
+
+cd "$ROOT"
+
+
+########## Checks ##########
+
+FAILURES=0
+
+# Runs a query with myfind in both modes and with GNU find, and compares the sorted output
+check() {
+	expected=$(find . "$@" | sort)
+
+	for mode in walk stat-threads; do
+		if [ "$mode" = walk ]; then
+			actual=$("$MYFIND" . "$@" | sort)
+		else
+			actual=$("$MYFIND" . "$@" -stat-threads 4 -strategy fixed | sort)
+		fi
+
+		if [ "$actual" = "$expected" ]; then
+			echo "  ok      $mode: $*"
+		else
+			echo "  FAILED  $mode: $*"
+			echo "$expected" > expected.out
+			echo "$actual" > actual.out
+			diff expected.out actual.out | sed 's/^/          /' || true
+			FAILURES=$((FAILURES + 1))
+		fi
+	done
+}
+
+check -samefile other/original
+check -samefile wide/link1 -type f
+check -inum "$(ls -i other/original | awk '{ print $1 }')"
+check -inum "+$(ls -i wide/file1500 | awk '{ print $1 }')" -name 'file1*'
+check -links 3
+check -links +1 -type f
+check -links -2 -name 'file2*'
+
+if [ -n "$MOUNTED" ]; then
+	# The root of the tmpfs; readdir() reports the inode of the directory below it instead
+	check -inum "$(stat -c %i wide/mnt)"
+	check -samefile wide/mnt
+	check -samefile wide/mnt/file
+fi
+
+if [ "$FAILURES" -gt 0 ]; then
+	echo "$FAILURES checks failed"
+	exit 1
+fi
+
+echo "All checks passed"
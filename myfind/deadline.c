@@ -0,0 +1,137 @@
+/// \file deadline.c
+/// Calls a function once a time limit has passed, used to implement "-timeout".
+///
+/// A separate thread waits for the deadline, so that the search does not have to
+/// read the clock for every entry and a slow system call does not delay noticing
+/// the deadline for the files that are already waiting to be printed.
+
+
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "deadline.h"
+
+
+
+/// The state shared between the caller and the timer thread.
+struct Deadline
+{
+	/// The point in time on the monotonic clock at which \p expired is called.
+	struct timespec time;
+
+	/// The function to call once the deadline has passed.
+	DeadlineExpired expired;
+
+	/// The context pointer passed to \p expired.
+	void* context;
+
+	/// Protects \p stopping and is used with \p stopRequested.
+	pthread_mutex_t lock;
+
+	/// Signalled when the timer thread should exit before the deadline.
+	pthread_cond_t stopRequested;
+
+	/// Indicates whether the timer thread should exit.
+	bool stopping;
+
+	/// The timer thread.
+	pthread_t thread;
+};
+
+
+
+/// Waits until the deadline has passed or the deadline is stopped.
+/// \param argument A pointer to the struct Deadline to wait for.
+/// \return Always NULL.
+static void* RunDeadline(void* argument)
+{
+	struct Deadline* deadline = argument;
+
+	pthread_mutex_lock(&deadline->lock);
+
+	while (!deadline->stopping && (pthread_cond_timedwait(&deadline->stopRequested, &deadline->lock, &deadline->time) == 0))
+		;
+
+	bool stopped = deadline->stopping;
+
+	pthread_mutex_unlock(&deadline->lock);
+
+	if (!stopped)
+		deadline->expired(deadline->context);
+
+	return NULL;
+}
+
+/// Starts a thread that calls \p expired once the specified time has passed.
+/// \param milliseconds The time from now after which \p expired is called.
+/// \param expired The function to call once the time has passed.
+/// \param context The context pointer passed to \p expired.
+/// \return The deadline, which needs to be stopped with StopDeadline(). NULL if the timer thread could not be started.
+struct Deadline* StartDeadline(unsigned long long milliseconds, DeadlineExpired expired, void* context)
+{
+	assert(expired != NULL);
+
+
+	struct Deadline* deadline = calloc(1, sizeof(struct Deadline));
+
+	if (deadline == NULL)
+		return NULL;
+
+	deadline->expired = expired;
+	deadline->context = context;
+
+	// The deadline is measured on the monotonic clock, so that changes of the system time do not matter
+	clock_gettime(CLOCK_MONOTONIC, &deadline->time);
+
+	deadline->time.tv_sec += milliseconds / 1000;
+	deadline->time.tv_nsec += (milliseconds % 1000) * 1000000L;
+
+	if (deadline->time.tv_nsec >= 1000000000L)
+	{
+		deadline->time.tv_sec++;
+		deadline->time.tv_nsec -= 1000000000L;
+	}
+
+	pthread_condattr_t attributes;
+
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(&deadline->stopRequested, &attributes);
+	pthread_condattr_destroy(&attributes);
+
+	pthread_mutex_init(&deadline->lock, NULL);
+
+	if (pthread_create(&deadline->thread, NULL, RunDeadline, deadline) != 0)
+	{
+		pthread_cond_destroy(&deadline->stopRequested);
+		pthread_mutex_destroy(&deadline->lock);
+		free(deadline);
+
+		return NULL;
+	}
+
+	return deadline;
+}
+
+/// Stops the timer thread and frees the deadline. Once this function returns, \p expired is not called anymore.
+/// \param deadline The deadline to stop. May be NULL.
+void StopDeadline(struct Deadline* deadline)
+{
+	if (deadline == NULL)
+		return;
+
+	pthread_mutex_lock(&deadline->lock);
+	deadline->stopping = true;
+	pthread_cond_signal(&deadline->stopRequested);
+	pthread_mutex_unlock(&deadline->lock);
+
+	pthread_join(deadline->thread, NULL);
+
+	pthread_cond_destroy(&deadline->stopRequested);
+	pthread_mutex_destroy(&deadline->lock);
+	free(deadline);
+}
@@ -0,0 +1,20 @@
+/// \file deadline.h
+/// Calls a function once a time limit has passed, used to implement "-timeout".
+
+
+
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+
+
+/// The function called once the time limit has passed. It is called on the timer thread.
+/// \param context The context pointer that was passed to StartDeadline().
+typedef void (*DeadlineExpired)(void* context);
+
+struct Deadline;
+
+struct Deadline* StartDeadline(unsigned long long milliseconds, DeadlineExpired expired, void* context);
+void StopDeadline(struct Deadline* deadline);
+
+#endif
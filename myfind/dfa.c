@@ -0,0 +1,1316 @@
+/// \file dfa.c
+/// Regular expressions matched in linear time by a lazily constructed DFA, used to implement "-regex" and "-iregex".
+///
+/// A pattern in POSIX extended syntax is parsed into a tree and compiled into a
+/// Thompson NFA, which never changes afterwards and can be shared by threads.
+/// Each thread matches with its own RegexMatcher, which builds the DFA states as
+/// the strings lead to them: A DFA state is the set of NFA states reachable after
+/// the bytes read so far, and its transitions are filled in on first use. So every
+/// byte costs a table lookup once the states for the common paths exist, and no
+/// pattern can make the matcher backtrack. The number of DFA states is limited;
+/// A pattern that needs more of them throws the cache away and starts over.
+///
+/// The whole string has to match, as with "find -regex". A literal that every
+/// match has to contain is extracted from the tree, so that most strings can be
+/// rejected by memmem() without running the DFA at all.
+
+
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include "dfa.h"
+#include "fold.h"
+
+
+
+/// The maximum number of NFA states a pattern may compile to, which bounds the work per byte and the size of a DFA state.
+#define REGEX_MAX_NFA_STATES 8192
+
+/// The maximum count in a bounded repetition like "a{2,5}".
+#define REGEX_MAX_REPEAT 255
+
+/// The initial number of buckets of the hash table of DFA states. It is a power of two.
+#define REGEX_INITIAL_BUCKETS 64
+
+/// Marks a transition that has not been computed yet.
+#define REGEX_UNKNOWN -1
+
+/// The kinds of nodes of a parsed pattern.
+enum RegexNodeKind
+{
+	/// Matches the empty string.
+	RegexEmpty,
+	/// Matches one byte of the set \p set.
+	RegexSet,
+	/// Matches \p left followed by \p right.
+	RegexConcat,
+	/// Matches \p left or \p right.
+	RegexAlternate,
+	/// Matches \p left repeated between \p min and \p max times.
+	RegexRepeat,
+};
+
+/// A node of a parsed pattern. Nodes refer to each other by their index, as the array holding them grows.
+struct RegexNode
+{
+	/// The kind of the node.
+	enum RegexNodeKind kind;
+
+	/// The first operand. Only valid for RegexConcat, RegexAlternate and RegexRepeat.
+	int left;
+
+	/// The second operand. Only valid for RegexConcat and RegexAlternate.
+	int right;
+
+	/// The minimum number of repetitions. Only valid for RegexRepeat.
+	int min;
+
+	/// The maximum number of repetitions, or -1 for no limit. Only valid for RegexRepeat.
+	int max;
+
+	/// The bytes matched, one bit per byte value. Only valid for RegexSet.
+	uint8_t set[32];
+};
+
+/// The state of the parser of a pattern.
+struct RegexParser
+{
+	/// The pattern.
+	const char* pattern;
+
+	/// The position of the next character to parse.
+	const char* position;
+
+	/// Indicates whether letters match in any case.
+	bool ignoreCase;
+
+	/// The nodes parsed so far.
+	struct RegexNode* nodes;
+
+	/// The number of entries in \p nodes.
+	size_t nodeCount;
+
+	/// The number of entries \p nodes has room for.
+	size_t nodeCapacity;
+
+	/// The first error found. NULL if none.
+	const char* error;
+};
+
+/// The kinds of NFA states.
+enum RegexStateKind
+{
+	/// Reads a byte of the set \p set and continues at \p out.
+	RegexStateSet,
+	/// Continues at \p out and \p out1 without reading a byte.
+	RegexStateSplit,
+	/// The whole pattern has matched.
+	RegexStateMatch,
+};
+
+/// A state of the NFA.
+struct RegexState
+{
+	/// The kind of the state.
+	enum RegexStateKind kind;
+
+	/// The next state.
+	int out;
+
+	/// The other next state. Only valid for RegexStateSplit.
+	int out1;
+
+	/// The index of the byte set in the program's \p sets. Only valid for RegexStateSet.
+	int set;
+};
+
+/// A compiled pattern. It is never modified after CompileRegex() returns, so that any number of matchers can use it concurrently.
+struct RegexProgram
+{
+	/// The states of the NFA.
+	struct RegexState* states;
+
+	/// The number of entries in \p states.
+	size_t stateCount;
+
+	/// The byte sets read by the states, 32 bytes each.
+	uint8_t (*sets)[32];
+
+	/// The number of entries in \p sets.
+	size_t setCount;
+
+	/// The state the NFA starts in.
+	int start;
+
+	/// A literal that every matching string contains, zero-terminated. Lowercase if \p ignoreCase is set. Empty if there is none.
+	char literal[REGEX_MAX_LITERAL + 1];
+
+	/// The number of characters in \p literal.
+	size_t literalLength;
+
+	/// Indicates whether letters match in any case.
+	bool ignoreCase;
+};
+
+/// A state of the DFA: The set of NFA states the NFA can be in.
+struct RegexDfaState
+{
+	/// The DFA states reached by each byte value. REGEX_UNKNOWN if not computed yet.
+	int next[256];
+
+	/// The offset of the sorted NFA state indices in the matcher's \p members.
+	size_t firstMember;
+
+	/// The number of NFA states in the set. A set without any states is the dead state, from which nothing matches anymore.
+	size_t memberCount;
+
+	/// Indicates whether the set contains the match state.
+	bool accepting;
+};
+
+/// The DFA of a program, built lazily. Each thread matching the program needs its own.
+struct RegexMatcher
+{
+	/// The program to match.
+	const struct RegexProgram* program;
+
+	/// The DFA states built so far.
+	struct RegexDfaState* states;
+
+	/// The number of entries in \p states.
+	size_t stateCount;
+
+	/// The NFA state indices of all DFA states.
+	int* members;
+
+	/// The number of entries in \p members.
+	size_t memberCount;
+
+	/// The number of entries \p members has room for.
+	size_t memberCapacity;
+
+	/// The hash table of the DFA states by their NFA states. Each bucket holds a state index plus one, or zero if empty.
+	int* buckets;
+
+	/// The number of entries in \p buckets, a power of two.
+	size_t bucketCount;
+
+	/// The DFA state for the empty string. REGEX_UNKNOWN if not built yet.
+	int start;
+
+	/// The NFA states of the DFA state being built.
+	int* scratch;
+
+	/// The number of entries in \p scratch.
+	size_t scratchCount;
+
+	/// The generation each NFA state was last added to \p scratch in, to add it only once.
+	unsigned int* marks;
+
+	/// The current generation for \p marks.
+	unsigned int generation;
+
+	/// The number of times the DFA states have been discarded because of REGEX_MAX_DFA_STATES.
+	unsigned long long flushes;
+
+	/// The lowercase form of the string being matched, searched for the literal if letters match in any case.
+	char* folded;
+
+	/// The number of bytes allocated for \p folded.
+	size_t foldedCapacity;
+};
+
+
+
+/// Adds a byte to a set.
+/// \param set The set.
+/// \param c The byte to add.
+static void AddToSet(uint8_t set[32], unsigned char c)
+{
+	set[c >> 3] |= (uint8_t) (1u << (c & 7));
+}
+
+/// Determines whether a byte is in a set.
+/// \param set The set.
+/// \param c The byte to check.
+/// \return true if the byte is in the set. Otherwise, false.
+static bool IsInSet(const uint8_t set[32], unsigned char c)
+{
+	return (set[c >> 3] & (1u << (c & 7))) != 0;
+}
+
+/// Adds the other case of every ASCII letter in a set, for "-iregex".
+/// \param set The set.
+static void FoldSet(uint8_t set[32])
+{
+	for (unsigned char c = 'a'; c <= 'z'; c++)
+	{
+		unsigned char upper = (unsigned char) (c - 'a' + 'A');
+
+		if (IsInSet(set, c) || IsInSet(set, upper))
+		{
+			AddToSet(set, c);
+			AddToSet(set, upper);
+		}
+	}
+}
+
+/// Appends a node to the parsed pattern.
+/// \param parser The parser.
+/// \param kind The kind of the node.
+/// \param left The first operand.
+/// \param right The second operand.
+/// \return The index of the node. -1 if out of memory.
+static int AddNode(struct RegexParser* parser, enum RegexNodeKind kind, int left, int right)
+{
+	if (parser->nodeCount == parser->nodeCapacity)
+	{
+		size_t capacity = (parser->nodeCapacity > 0) ? parser->nodeCapacity * 2 : 32;
+		struct RegexNode* nodes = realloc(parser->nodes, capacity * sizeof(struct RegexNode));
+
+		if (nodes == NULL)
+		{
+			parser->error = "out of memory";
+
+			return -1;
+		}
+
+		parser->nodes = nodes;
+		parser->nodeCapacity = capacity;
+	}
+
+	struct RegexNode* node = &parser->nodes[parser->nodeCount];
+
+	memset(node, 0, sizeof(struct RegexNode));
+	node->kind = kind;
+	node->left = left;
+	node->right = right;
+
+	return (int) parser->nodeCount++;
+}
+
+/// Appends a node matching a single byte.
+/// \param parser The parser.
+/// \param c The byte.
+/// \return The index of the node. -1 if out of memory.
+static int AddByteNode(struct RegexParser* parser, unsigned char c)
+{
+	int node = AddNode(parser, RegexSet, -1, -1);
+
+	if (node >= 0)
+	{
+		AddToSet(parser->nodes[node].set, c);
+
+		if (parser->ignoreCase)
+			FoldSet(parser->nodes[node].set);
+	}
+
+	return node;
+}
+
+/// Adds the bytes of a character class like "[:alpha:]" to a set.
+/// \param set The set.
+/// \param name The name of the class, not terminated.
+/// \param length The number of characters in \p name.
+/// \return true if the class is known. Otherwise, false.
+static bool AddClassToSet(uint8_t set[32], const char* name, size_t length)
+{
+	static const struct
+	{
+		const char* name;
+		int (*test)(int);
+	} Classes[] =
+	{
+		{ "alnum", isalnum }, { "alpha", isalpha }, { "blank", isblank }, { "cntrl", iscntrl },
+		{ "digit", isdigit }, { "graph", isgraph }, { "lower", islower }, { "print", isprint },
+		{ "punct", ispunct }, { "space", isspace }, { "upper", isupper }, { "xdigit", isxdigit },
+	};
+
+	for (size_t i = 0; i < sizeof(Classes) / sizeof(Classes[0]); i++)
+	{
+		if ((strlen(Classes[i].name) == length) && (memcmp(Classes[i].name, name, length) == 0))
+		{
+			// Only ASCII bytes, as the classes of other bytes depend on the locale and the encoding
+			for (int c = 0; c < 128; c++)
+			{
+				if (Classes[i].test(c))
+					AddToSet(set, (unsigned char) c);
+			}
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/// Parses a bracket expression like "[a-z_]" or "[^/]". The opening bracket has been read.
+/// \param parser The parser.
+/// \return The index of the node. -1 if the expression is invalid.
+static int ParseBracket(struct RegexParser* parser)
+{
+	int node = AddNode(parser, RegexSet, -1, -1);
+
+	if (node < 0)
+		return -1;
+
+	uint8_t set[32] = { 0 };
+	bool negate = false;
+	const char* p = parser->position;
+
+	if (*p == '^')
+	{
+		negate = true;
+		p++;
+	}
+
+	// A closing bracket right at the start is a member, not the end
+	bool first = true;
+
+	while (first || (*p != ']'))
+	{
+		if (*p == '\0')
+		{
+			parser->error = "unterminated bracket expression";
+
+			return -1;
+		}
+
+		first = false;
+
+		if ((p[0] == '[') && (p[1] == ':'))
+		{
+			const char* end = strstr(p + 2, ":]");
+
+			if ((end == NULL) || !AddClassToSet(set, p + 2, (size_t) (end - p - 2)))
+			{
+				parser->error = "invalid character class";
+
+				return -1;
+			}
+
+			p = end + 2;
+			continue;
+		}
+
+		// As in POSIX, a backslash is an ordinary member of a bracket expression
+		unsigned char low = (unsigned char) *p++;
+		unsigned char high = low;
+
+		if ((p[0] == '-') && (p[1] != ']') && (p[1] != '\0'))
+		{
+			high = (unsigned char) p[1];
+			p += 2;
+
+			if (high < low)
+			{
+				parser->error = "invalid range in bracket expression";
+
+				return -1;
+			}
+		}
+
+		for (unsigned int c = low; c <= high; c++)
+			AddToSet(set, (unsigned char) c);
+	}
+
+	parser->position = p + 1;
+
+	if (parser->ignoreCase)
+		FoldSet(set);
+
+	if (negate)
+	{
+		for (size_t i = 0; i < sizeof(set); i++)
+			set[i] = (uint8_t) ~set[i];
+	}
+
+	memcpy(parser->nodes[node].set, set, sizeof(set));
+
+	return node;
+}
+
+static int ParseAlternation(struct RegexParser* parser);
+
+/// Parses a single atom: A byte, a bracket expression, "." or a parenthesized expression.
+/// \param parser The parser.
+/// \return The index of the node. -1 if the atom is invalid.
+static int ParseAtom(struct RegexParser* parser)
+{
+	char c = *parser->position++;
+
+	switch (c)
+	{
+	case '(':
+	{
+		int node = ParseAlternation(parser);
+
+		if (node < 0)
+			return -1;
+
+		if (*parser->position != ')')
+		{
+			parser->error = "unmatched parenthesis";
+
+			return -1;
+		}
+
+		parser->position++;
+
+		return node;
+	}
+
+	case '[':
+		return ParseBracket(parser);
+
+	case '.':
+	{
+		int node = AddNode(parser, RegexSet, -1, -1);
+
+		if (node >= 0)
+			memset(parser->nodes[node].set, 0xFF, sizeof(parser->nodes[node].set));
+
+		return node;
+	}
+
+	case '^':
+		// The whole path has to match anyway, so an anchor is only accepted where it is implied
+		if (parser->position - 1 != parser->pattern)
+		{
+			parser->error = "\"^\" is only supported at the start of the pattern";
+
+			return -1;
+		}
+
+		return AddNode(parser, RegexEmpty, -1, -1);
+
+	case '$':
+		if (*parser->position != '\0')
+		{
+			parser->error = "\"$\" is only supported at the end of the pattern";
+
+			return -1;
+		}
+
+		return AddNode(parser, RegexEmpty, -1, -1);
+
+	case '*':
+	case '+':
+	case '?':
+	case '{':
+		parser->error = "repetition without an expression to repeat";
+
+		return -1;
+
+	case '\\':
+		if (*parser->position == '\0')
+		{
+			parser->error = "trailing backslash";
+
+			return -1;
+		}
+
+		return AddByteNode(parser, (unsigned char) *parser->position++);
+
+	default:
+		return AddByteNode(parser, (unsigned char) c);
+	}
+}
+
+/// Parses a count of a bounded repetition.
+/// \param parser The parser.
+/// \param count Receives the count.
+/// \return true if a count was parsed. Otherwise, false.
+static bool ParseCount(struct RegexParser* parser, int* count)
+{
+	if (!isdigit((unsigned char) *parser->position))
+		return false;
+
+	*count = 0;
+
+	while (isdigit((unsigned char) *parser->position))
+	{
+		*count = *count * 10 + (*parser->position++ - '0');
+
+		if (*count > REGEX_MAX_REPEAT)
+		{
+			parser->error = "repetition count too large";
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// Parses an atom followed by any number of "*", "+", "?" and "{m,n}".
+/// \param parser The parser.
+/// \return The index of the node. -1 if the expression is invalid.
+static int ParseRepetition(struct RegexParser* parser)
+{
+	int node = ParseAtom(parser);
+
+	while (node >= 0)
+	{
+		int min;
+		int max;
+
+		switch (*parser->position)
+		{
+		case '*':
+			min = 0;
+			max = -1;
+			break;
+
+		case '+':
+			min = 1;
+			max = -1;
+			break;
+
+		case '?':
+			min = 0;
+			max = 1;
+			break;
+
+		case '{':
+			parser->position++;
+
+			if (!ParseCount(parser, &min))
+			{
+				if (parser->error == NULL)
+					parser->error = "invalid repetition count";
+
+				return -1;
+			}
+
+			max = min;
+
+			if (*parser->position == ',')
+			{
+				parser->position++;
+				max = -1;
+
+				if ((*parser->position != '}') && !ParseCount(parser, &max))
+				{
+					if (parser->error == NULL)
+						parser->error = "invalid repetition count";
+
+					return -1;
+				}
+			}
+
+			if ((*parser->position != '}') || ((max >= 0) && (max < min)))
+			{
+				parser->error = "invalid repetition count";
+
+				return -1;
+			}
+			break;
+
+		default:
+			return node;
+		}
+
+		parser->position++;
+		node = AddNode(parser, RegexRepeat, node, -1);
+
+		if (node >= 0)
+		{
+			parser->nodes[node].min = min;
+			parser->nodes[node].max = max;
+		}
+	}
+
+	return node;
+}
+
+/// Parses a sequence of repetitions up to the next "|" or ")".
+/// \param parser The parser.
+/// \return The index of the node. -1 if the expression is invalid.
+static int ParseConcatenation(struct RegexParser* parser)
+{
+	int node = -1;
+
+	while ((*parser->position != '\0') && (*parser->position != '|') && (*parser->position != ')'))
+	{
+		int next = ParseRepetition(parser);
+
+		if (next < 0)
+			return -1;
+
+		node = (node < 0) ? next : AddNode(parser, RegexConcat, node, next);
+
+		if (node < 0)
+			return -1;
+	}
+
+	return (node < 0) ? AddNode(parser, RegexEmpty, -1, -1) : node;
+}
+
+/// Parses alternatives separated by "|".
+/// \param parser The parser.
+/// \return The index of the node. -1 if the expression is invalid.
+static int ParseAlternation(struct RegexParser* parser)
+{
+	int node = ParseConcatenation(parser);
+
+	while ((node >= 0) && (*parser->position == '|'))
+	{
+		parser->position++;
+
+		int next = ParseConcatenation(parser);
+
+		node = (next < 0) ? -1 : AddNode(parser, RegexAlternate, node, next);
+	}
+
+	return node;
+}
+
+/// Appends a state to the NFA.
+/// \param program The program.
+/// \param kind The kind of the state.
+/// \param out The next state.
+/// \param out1 The other next state.
+/// \return The index of the state. -1 if the NFA would get too large.
+static int AddState(struct RegexProgram* program, enum RegexStateKind kind, int out, int out1)
+{
+	if (program->stateCount == REGEX_MAX_NFA_STATES)
+		return -1;
+
+	struct RegexState* state = &program->states[program->stateCount];
+
+	state->kind = kind;
+	state->out = out;
+	state->out1 = out1;
+	state->set = -1;
+
+	return (int) program->stateCount++;
+}
+
+/// Compiles a node into NFA states. The NFA is built backwards, so that every fragment knows the state it continues at.
+/// \param program The program.
+/// \param nodes The parsed pattern.
+/// \param node The index of the node.
+/// \param next The state to continue at after the node has matched.
+/// \return The state to start the node at. -1 if the NFA would get too large.
+static int CompileNode(struct RegexProgram* program, const struct RegexNode* nodes, int node, int next)
+{
+	if (next < 0)
+		return -1;
+
+	switch (nodes[node].kind)
+	{
+	case RegexEmpty:
+		return next;
+
+	case RegexSet:
+	{
+		int state = AddState(program, RegexStateSet, next, -1);
+
+		if (state >= 0)
+		{
+			program->states[state].set = (int) program->setCount;
+			memcpy(program->sets[program->setCount++], nodes[node].set, 32);
+		}
+
+		return state;
+	}
+
+	case RegexConcat:
+		return CompileNode(program, nodes, nodes[node].left, CompileNode(program, nodes, nodes[node].right, next));
+
+	case RegexAlternate:
+	{
+		int left = CompileNode(program, nodes, nodes[node].left, next);
+		int right = CompileNode(program, nodes, nodes[node].right, next);
+
+		return ((left < 0) || (right < 0)) ? -1 : AddState(program, RegexStateSplit, left, right);
+	}
+
+	case RegexRepeat:
+	{
+		int start = next;
+
+		if (nodes[node].max < 0)
+		{
+			// A loop: The split either enters the operand, which returns to the split, or leaves
+			int loop = AddState(program, RegexStateSplit, -1, next);
+			int body = CompileNode(program, nodes, nodes[node].left, loop);
+
+			if (body < 0)
+				return -1;
+
+			program->states[loop].out = body;
+			start = loop;
+		}
+		else
+		{
+			// "a{2,4}" is compiled as "aa(a(a)?)?", so each optional copy can skip all following ones
+			for (int i = nodes[node].min; i < nodes[node].max; i++)
+			{
+				int body = CompileNode(program, nodes, nodes[node].left, start);
+
+				start = (body < 0) ? -1 : AddState(program, RegexStateSplit, body, next);
+
+				if (start < 0)
+					return -1;
+			}
+		}
+
+		for (int i = 0; i < nodes[node].min; i++)
+			start = CompileNode(program, nodes, nodes[node].left, start);
+
+		return start;
+	}
+	}
+
+	return -1;
+}
+
+/// Determines whether a node matches exactly one byte, or one letter in any case, and gets it.
+/// \param program The program, for the case sensitivity.
+/// \param node The node.
+/// \param c Receives the byte, lowercase if letters match in any case.
+/// \return true if the node matches a single byte. Otherwise, false.
+static bool GetSingleByte(const struct RegexProgram* program, const struct RegexNode* node, char* c)
+{
+	if (node->kind != RegexSet)
+		return false;
+
+	int count = 0;
+	int member = 0;
+
+	for (int i = 0; i < 256; i++)
+	{
+		if (IsInSet(node->set, (unsigned char) i))
+		{
+			count++;
+			member = (count == 1) ? i : member;
+		}
+	}
+
+	if (count == 1)
+	{
+		*c = (char) member;
+
+		return true;
+	}
+
+	// The first member of a folded letter is its uppercase form
+	if (program->ignoreCase && (count == 2) && (member >= 'A') && (member <= 'Z') && IsInSet(node->set, (unsigned char) (member | 0x20)))
+	{
+		*c = (char) (member | 0x20);
+
+		return true;
+	}
+
+	return false;
+}
+
+/// Finds the longest literal that every string matching a node contains. Sequences of single bytes are candidates, as well as the literals of operands that have to match at least once.
+/// \param program The program receiving the literal in \p literal.
+/// \param nodes The parsed pattern.
+/// \param node The index of the node.
+/// \param run The literal the bytes before the node have formed, which the node may extend.
+/// \param runLength The number of characters in \p run.
+/// \return The number of characters in \p run after the node. 0 if the node ends the run.
+static size_t FindLiteral(struct RegexProgram* program, const struct RegexNode* nodes, int node, char* run, size_t runLength)
+{
+	char c;
+
+	switch (nodes[node].kind)
+	{
+	case RegexEmpty:
+		return runLength;
+
+	case RegexSet:
+		if (!GetSingleByte(program, &nodes[node], &c))
+			return 0;
+
+		if (runLength < REGEX_MAX_LITERAL)
+			run[runLength++] = c;
+
+		if (runLength > program->literalLength)
+		{
+			memcpy(program->literal, run, runLength);
+			program->literal[runLength] = '\0';
+			program->literalLength = runLength;
+		}
+
+		return runLength;
+
+	case RegexConcat:
+		runLength = FindLiteral(program, nodes, nodes[node].left, run, runLength);
+
+		return FindLiteral(program, nodes, nodes[node].right, run, runLength);
+
+	case RegexRepeat:
+		if (nodes[node].min > 0)
+		{
+			// The operand's literals are required, but the run does not continue across the repetition
+			char inner[REGEX_MAX_LITERAL];
+
+			FindLiteral(program, nodes, nodes[node].left, inner, 0);
+		}
+
+		return 0;
+
+	case RegexAlternate:
+		return 0;
+	}
+
+	return 0;
+}
+
+/// Compiles a regular expression in POSIX extended syntax. The expression has to match the whole string.
+/// \param pattern The regular expression.
+/// \param ignoreCase Indicates whether ASCII letters match in any case.
+/// \param error Receives a description of the error if the expression is invalid.
+/// \return The program, which needs to be released with FreeRegex(). NULL if the expression is invalid or out of memory.
+struct RegexProgram* CompileRegex(const char* pattern, bool ignoreCase, const char** error)
+{
+	assert(pattern != NULL);
+	assert(error != NULL);
+
+
+	struct RegexParser parser = { .pattern = pattern, .position = pattern, .ignoreCase = ignoreCase };
+	int root = ParseAlternation(&parser);
+
+	if ((root >= 0) && (*parser.position != '\0'))
+	{
+		// ParseAlternation() only stops early at an unmatched closing parenthesis
+		parser.error = "unmatched parenthesis";
+		root = -1;
+	}
+
+	if (root < 0)
+	{
+		*error = parser.error;
+		free(parser.nodes);
+
+		return NULL;
+	}
+
+	struct RegexProgram* program = calloc(1, sizeof(struct RegexProgram));
+
+	if (program != NULL)
+	{
+		program->states = malloc(REGEX_MAX_NFA_STATES * sizeof(struct RegexState));
+		program->sets = malloc(REGEX_MAX_NFA_STATES * sizeof(program->sets[0]));
+		program->ignoreCase = ignoreCase;
+	}
+
+	if ((program == NULL) || (program->states == NULL) || (program->sets == NULL))
+	{
+		*error = "out of memory";
+		free(parser.nodes);
+		FreeRegex(program);
+
+		return NULL;
+	}
+
+	program->start = CompileNode(program, parser.nodes, root, AddState(program, RegexStateMatch, -1, -1));
+
+	char run[REGEX_MAX_LITERAL];
+
+	FindLiteral(program, parser.nodes, root, run, 0);
+	free(parser.nodes);
+
+	if (program->start < 0)
+	{
+		*error = "expression too large";
+		FreeRegex(program);
+
+		return NULL;
+	}
+
+	// Give back the room the NFA has not used; It stays where it is if that fails
+	struct RegexState* states = realloc(program->states, program->stateCount * sizeof(struct RegexState));
+
+	if (states != NULL)
+		program->states = states;
+
+	if (program->setCount > 0)
+	{
+		uint8_t (*sets)[32] = realloc(program->sets, program->setCount * sizeof(program->sets[0]));
+
+		if (sets != NULL)
+			program->sets = sets;
+	}
+
+	return program;
+}
+
+/// Gets the literal every string matching a program contains.
+/// \param program The program.
+/// \return The literal, lowercase for "-iregex". Empty if there is none.
+const char* GetRegexLiteral(const struct RegexProgram* program)
+{
+	assert(program != NULL);
+
+
+	return program->literal;
+}
+
+/// Frees a program. No matcher may use it anymore.
+/// \param program The program to free. May be NULL.
+void FreeRegex(struct RegexProgram* program)
+{
+	if (program == NULL)
+		return;
+
+	free(program->states);
+	free(program->sets);
+	free(program);
+}
+
+/// Creates a matcher for a program. Its DFA states are built as strings are matched.
+/// \param program The program to match. It must remain valid until the matcher is freed.
+/// \return The matcher, which needs to be released with FreeRegexMatcher(). NULL if out of memory.
+struct RegexMatcher* CreateRegexMatcher(const struct RegexProgram* program)
+{
+	assert(program != NULL);
+
+
+	struct RegexMatcher* matcher = calloc(1, sizeof(struct RegexMatcher));
+
+	if (matcher == NULL)
+		return NULL;
+
+	matcher->program = program;
+	matcher->start = REGEX_UNKNOWN;
+	matcher->states = malloc(REGEX_MAX_DFA_STATES * sizeof(struct RegexDfaState));
+	matcher->bucketCount = REGEX_INITIAL_BUCKETS;
+	matcher->buckets = calloc(matcher->bucketCount, sizeof(int));
+	matcher->scratch = malloc(program->stateCount * sizeof(int));
+	matcher->marks = calloc(program->stateCount, sizeof(unsigned int));
+
+	if ((matcher->states == NULL) || (matcher->buckets == NULL) || (matcher->scratch == NULL) || (matcher->marks == NULL))
+	{
+		FreeRegexMatcher(matcher);
+
+		return NULL;
+	}
+
+	return matcher;
+}
+
+/// Adds an NFA state and all states reachable from it without reading a byte to the scratch set. Only states that read a byte or match are kept.
+/// \param matcher The matcher.
+/// \param state The NFA state.
+static void AddClosure(struct RegexMatcher* matcher, int state)
+{
+	const struct RegexState* states = matcher->program->states;
+
+	// Follow the first branch of each split in a loop and recurse into the second one only
+	while (matcher->marks[state] != matcher->generation)
+	{
+		matcher->marks[state] = matcher->generation;
+
+		if (states[state].kind != RegexStateSplit)
+		{
+			matcher->scratch[matcher->scratchCount++] = state;
+
+			return;
+		}
+
+		AddClosure(matcher, states[state].out1);
+		state = states[state].out;
+	}
+}
+
+/// Starts a new scratch set.
+/// \param matcher The matcher.
+static void ClearScratch(struct RegexMatcher* matcher)
+{
+	matcher->scratchCount = 0;
+	matcher->generation++;
+
+	if (matcher->generation == 0)
+	{
+		// The generation has wrapped around; Old marks could be mistaken for current ones
+		memset(matcher->marks, 0, matcher->program->stateCount * sizeof(unsigned int));
+		matcher->generation = 1;
+	}
+}
+
+/// Compares two NFA state indices for qsort().
+static int CompareStates(const void* a, const void* b)
+{
+	int x = *(const int*) a;
+	int y = *(const int*) b;
+
+	return (x > y) - (x < y);
+}
+
+/// Computes the hash of a set of NFA states.
+/// \param members The sorted NFA state indices.
+/// \param count The number of entries in \p members.
+/// \return The hash.
+static size_t HashStates(const int* members, size_t count)
+{
+	// FNV-1a over the indices
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		hash ^= (uint64_t) (unsigned int) members[i];
+		hash *= 1099511628211ull;
+	}
+
+	return (size_t) (hash ^ (hash >> 32));
+}
+
+/// Discards all DFA states, as their number has reached REGEX_MAX_DFA_STATES.
+/// \param matcher The matcher.
+static void FlushStates(struct RegexMatcher* matcher)
+{
+	matcher->stateCount = 0;
+	matcher->memberCount = 0;
+	matcher->start = REGEX_UNKNOWN;
+	memset(matcher->buckets, 0, matcher->bucketCount * sizeof(int));
+	matcher->flushes++;
+}
+
+/// Inserts a DFA state into the hash table.
+/// \param matcher The matcher.
+/// \param index The index of the state.
+static void InsertState(struct RegexMatcher* matcher, int index)
+{
+	const struct RegexDfaState* state = &matcher->states[index];
+	size_t bucket = HashStates(matcher->members + state->firstMember, state->memberCount) & (matcher->bucketCount - 1);
+
+	while (matcher->buckets[bucket] != 0)
+		bucket = (bucket + 1) & (matcher->bucketCount - 1);
+
+	matcher->buckets[bucket] = index + 1;
+}
+
+/// Gets the DFA state for the NFA states in the scratch set, adding it if it does not exist yet.
+/// \param matcher The matcher.
+/// \return The index of the DFA state. -1 if out of memory.
+static int FindState(struct RegexMatcher* matcher)
+{
+	qsort(matcher->scratch, matcher->scratchCount, sizeof(int), CompareStates);
+
+	size_t bytes = matcher->scratchCount * sizeof(int);
+	size_t bucket = HashStates(matcher->scratch, matcher->scratchCount) & (matcher->bucketCount - 1);
+
+	for (; matcher->buckets[bucket] != 0; bucket = (bucket + 1) & (matcher->bucketCount - 1))
+	{
+		int index = matcher->buckets[bucket] - 1;
+		const struct RegexDfaState* state = &matcher->states[index];
+
+		if ((state->memberCount == matcher->scratchCount) && (memcmp(matcher->members + state->firstMember, matcher->scratch, bytes) == 0))
+			return index;
+	}
+
+	if (matcher->stateCount == REGEX_MAX_DFA_STATES)
+		FlushStates(matcher);
+
+	if (matcher->memberCount + matcher->scratchCount > matcher->memberCapacity)
+	{
+		size_t capacity = (matcher->memberCapacity > 0) ? matcher->memberCapacity : 256;
+
+		while (capacity < matcher->memberCount + matcher->scratchCount)
+			capacity *= 2;
+
+		int* members = realloc(matcher->members, capacity * sizeof(int));
+
+		if (members == NULL)
+			return -1;
+
+		matcher->members = members;
+		matcher->memberCapacity = capacity;
+	}
+
+	// Keep the hash table at most half full
+	if ((matcher->stateCount + 1) * 2 > matcher->bucketCount)
+	{
+		int* buckets = calloc(matcher->bucketCount * 2, sizeof(int));
+
+		if (buckets == NULL)
+			return -1;
+
+		free(matcher->buckets);
+		matcher->buckets = buckets;
+		matcher->bucketCount *= 2;
+
+		for (size_t i = 0; i < matcher->stateCount; i++)
+			InsertState(matcher, (int) i);
+	}
+
+	int index = (int) matcher->stateCount++;
+	struct RegexDfaState* state = &matcher->states[index];
+
+	for (int c = 0; c < 256; c++)
+		state->next[c] = REGEX_UNKNOWN;
+
+	state->firstMember = matcher->memberCount;
+	state->memberCount = matcher->scratchCount;
+	state->accepting = false;
+	memcpy(matcher->members + state->firstMember, matcher->scratch, bytes);
+	matcher->memberCount += matcher->scratchCount;
+
+	for (size_t i = 0; i < matcher->scratchCount; i++)
+	{
+		if (matcher->program->states[matcher->scratch[i]].kind == RegexStateMatch)
+			state->accepting = true;
+	}
+
+	InsertState(matcher, index);
+
+	return index;
+}
+
+/// Computes the transition of a DFA state on a byte and stores it in the state.
+/// \param matcher The matcher.
+/// \param from The index of the DFA state.
+/// \param c The byte.
+/// \return The index of the next DFA state, which is only valid until the next call, as the states may have been discarded. -1 if out of memory.
+static int ComputeTransition(struct RegexMatcher* matcher, int from, unsigned char c)
+{
+	const struct RegexProgram* program = matcher->program;
+	const struct RegexDfaState* state = &matcher->states[from];
+
+	ClearScratch(matcher);
+
+	for (size_t i = 0; i < state->memberCount; i++)
+	{
+		const struct RegexState* member = &program->states[matcher->members[state->firstMember + i]];
+
+		if ((member->kind == RegexStateSet) && IsInSet(program->sets[member->set], c))
+			AddClosure(matcher, member->out);
+	}
+
+	size_t flushes = matcher->flushes;
+	int next = FindState(matcher);
+
+	// If the states have been discarded, the old one is gone, and so is its transition table
+	if ((next >= 0) && (matcher->flushes == flushes))
+		matcher->states[from].next[c] = next;
+
+	return next;
+}
+
+/// Determines whether a whole string matches the program of a matcher.
+/// \param matcher The matcher of the calling thread.
+/// \param string The string to match.
+/// \param length The number of characters in \p string.
+/// \return true if the whole string matches. Otherwise, false.
+bool MatchRegex(struct RegexMatcher* matcher, const char* string, size_t length)
+{
+	assert(matcher != NULL);
+	assert(string != NULL);
+
+
+	const struct RegexProgram* program = matcher->program;
+
+	// Most strings do not contain the required literal; Those never get to the DFA
+	if (program->literalLength > 0)
+	{
+		const char* haystack = string;
+
+		if (program->ignoreCase)
+		{
+			if (length > matcher->foldedCapacity)
+			{
+				size_t capacity = (matcher->foldedCapacity > 0) ? matcher->foldedCapacity : 256;
+
+				while (capacity < length)
+					capacity *= 2;
+
+				char* folded = realloc(matcher->folded, capacity);
+
+				if (folded == NULL)
+				{
+					// Out of memory
+					exit(-1);
+				}
+
+				matcher->folded = folded;
+				matcher->foldedCapacity = capacity;
+			}
+
+			// Only ASCII letters match in any case, so the literal is searched for in the ASCII lowercase form
+			FoldAscii(string, length, matcher->folded);
+			haystack = matcher->folded;
+		}
+
+		if (memmem(haystack, length, program->literal, program->literalLength) == NULL)
+			return false;
+	}
+
+	int state = matcher->start;
+
+	if (state == REGEX_UNKNOWN)
+	{
+		ClearScratch(matcher);
+		AddClosure(matcher, program->start);
+		state = matcher->start = FindState(matcher);
+
+		if (state < 0)
+		{
+			// Out of memory
+			exit(-1);
+		}
+	}
+
+	for (size_t i = 0; i < length; i++)
+	{
+		unsigned char c = (unsigned char) string[i];
+		int next = matcher->states[state].next[c];
+
+		if (next == REGEX_UNKNOWN)
+		{
+			next = ComputeTransition(matcher, state, c);
+
+			if (next < 0)
+			{
+				// Out of memory
+				exit(-1);
+			}
+		}
+
+		state = next;
+
+		// Nothing can match once the set of NFA states is empty
+		if (matcher->states[state].memberCount == 0)
+			return false;
+	}
+
+	return matcher->states[state].accepting;
+}
+
+/// Gets the number of times a matcher has discarded its DFA states because of REGEX_MAX_DFA_STATES.
+/// \param matcher The matcher.
+/// \return The number of times.
+unsigned long long GetRegexCacheFlushes(const struct RegexMatcher* matcher)
+{
+	assert(matcher != NULL);
+
+
+	return matcher->flushes;
+}
+
+/// Frees a matcher.
+/// \param matcher The matcher to free. May be NULL.
+void FreeRegexMatcher(struct RegexMatcher* matcher)
+{
+	if (matcher == NULL)
+		return;
+
+	free(matcher->states);
+	free(matcher->members);
+	free(matcher->buckets);
+	free(matcher->scratch);
+	free(matcher->marks);
+	free(matcher->folded);
+	free(matcher);
+}
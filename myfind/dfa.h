@@ -0,0 +1,32 @@
+/// \file dfa.h
+/// Regular expressions matched in linear time by a lazily constructed DFA, used to implement "-regex" and "-iregex".
+
+
+
+#ifndef DFA_H
+#define DFA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+
+/// The maximum number of DFA states a matcher keeps. Once reached, the states are discarded and built again as needed.
+#define REGEX_MAX_DFA_STATES 1024
+
+/// The maximum number of bytes of the literal that every match has to contain, which is searched for before running the DFA.
+#define REGEX_MAX_LITERAL 64
+
+struct RegexProgram;
+struct RegexMatcher;
+
+struct RegexProgram* CompileRegex(const char* pattern, bool ignoreCase, const char** error);
+const char* GetRegexLiteral(const struct RegexProgram* program);
+void FreeRegex(struct RegexProgram* program);
+
+struct RegexMatcher* CreateRegexMatcher(const struct RegexProgram* program);
+bool MatchRegex(struct RegexMatcher* matcher, const char* string, size_t length);
+unsigned long long GetRegexCacheFlushes(const struct RegexMatcher* matcher);
+void FreeRegexMatcher(struct RegexMatcher* matcher);
+
+#endif
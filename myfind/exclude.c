@@ -0,0 +1,382 @@
+/// \file exclude.c
+/// Sets of excluded file names and path prefixes, whose cost per entry does not grow with their size.
+///
+/// Exclusion lists of backup jobs hold thousands of names and prefixes, and every
+/// entry of the walk has to be checked against all of them. Names are kept in a
+/// hash set. Prefixes are split into their components and kept as a trie, whose
+/// edges are stored in the same hash table, keyed by the parent node and the
+/// component. The walk remembers the trie node of each directory on its stack, so
+/// that checking an entry against all prefixes is a single lookup of its name.
+
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "exclude.h"
+
+
+
+/// The initial number of slots of the hash table. It is a power of two.
+#define EXCLUDE_INITIAL_SLOTS 256
+
+/// The parent of the entries of the hash table that are excluded names rather than trie edges.
+#define EXCLUDE_NAME_PARENT -2
+
+/// An entry of the hash table: An excluded name, or an edge of the prefix trie.
+struct ExcludeSlot
+{
+	/// The hash of \p parent and the string.
+	uint64_t hash;
+
+	/// The trie node the edge starts at. EXCLUDE_NAME_PARENT for an excluded name. EXCLUDE_NONE if the slot is empty.
+	int parent;
+
+	/// The trie node the edge leads to. Only valid for edges.
+	int node;
+
+	/// The offset of the name or component in the set's \p strings.
+	size_t offset;
+
+	/// The number of characters of the name or component.
+	size_t length;
+};
+
+/// A set of excluded names and path prefixes. It is never modified once built, so that any number of walks can use it concurrently.
+struct ExcludeSet
+{
+	/// The hash table of names and trie edges, using linear probing.
+	struct ExcludeSlot* slots;
+
+	/// The number of entries in \p slots, a power of two.
+	size_t slotCount;
+
+	/// The number of slots in use.
+	size_t usedCount;
+
+	/// The characters of all names and components, one after the other.
+	char* strings;
+
+	/// The number of bytes used in \p strings.
+	size_t stringsSize;
+
+	/// The number of bytes allocated for \p strings.
+	size_t stringsCapacity;
+
+	/// Indicates for each trie node whether the path it stands for is excluded, together with everything below it.
+	bool* terminal;
+
+	/// The number of trie nodes, including EXCLUDE_ROOT.
+	size_t nodeCount;
+
+	/// The number of entries allocated for \p terminal.
+	size_t nodeCapacity;
+};
+
+
+
+/// Computes the hash of a name or trie edge.
+/// \param parent The node the edge starts at, or EXCLUDE_NAME_PARENT for a name.
+/// \param name The name or component.
+/// \param length The number of characters in \p name.
+/// \return The hash.
+static uint64_t HashExcludeKey(int parent, const char* name, size_t length)
+{
+	// FNV-1a, starting with the parent so that equal components below different nodes spread out
+	uint64_t hash = 14695981039346656037ull ^ (uint64_t) (unsigned int) parent;
+
+	hash *= 1099511628211ull;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char) name[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash ^ (hash >> 29);
+}
+
+/// Looks up a name or trie edge.
+/// \param set The set.
+/// \param parent The node the edge starts at, or EXCLUDE_NAME_PARENT for a name.
+/// \param name The name or component.
+/// \param length The number of characters in \p name.
+/// \param hash The hash computed by HashExcludeKey().
+/// \return The slot holding the key, or the empty slot where it would be inserted.
+static struct ExcludeSlot* FindSlot(const struct ExcludeSet* set, int parent, const char* name, size_t length, uint64_t hash)
+{
+	size_t mask = set->slotCount - 1;
+
+	for (size_t i = (size_t) hash & mask; ; i = (i + 1) & mask)
+	{
+		struct ExcludeSlot* slot = &set->slots[i];
+
+		if (slot->parent == EXCLUDE_NONE)
+			return slot;
+
+		if ((slot->hash == hash) && (slot->parent == parent) && (slot->length == length) && (memcmp(set->strings + slot->offset, name, length) == 0))
+			return slot;
+	}
+}
+
+/// Doubles the number of slots of the hash table if it is half full.
+/// \param set The set.
+/// \return true if there is room for another key. false if out of memory.
+static bool ReserveSlot(struct ExcludeSet* set)
+{
+	if ((set->usedCount + 1) * 2 <= set->slotCount)
+		return true;
+
+	struct ExcludeSlot* old = set->slots;
+	size_t oldCount = set->slotCount;
+	struct ExcludeSlot* slots = malloc(oldCount * 2 * sizeof(struct ExcludeSlot));
+
+	if (slots == NULL)
+		return false;
+
+	for (size_t i = 0; i < oldCount * 2; i++)
+		slots[i].parent = EXCLUDE_NONE;
+
+	set->slots = slots;
+	set->slotCount = oldCount * 2;
+
+	for (size_t i = 0; i < oldCount; i++)
+	{
+		if (old[i].parent != EXCLUDE_NONE)
+			*FindSlot(set, old[i].parent, set->strings + old[i].offset, old[i].length, old[i].hash) = old[i];
+	}
+
+	free(old);
+
+	return true;
+}
+
+/// Inserts a name or trie edge that is not in the table yet.
+/// \param set The set.
+/// \param parent The node the edge starts at, or EXCLUDE_NAME_PARENT for a name.
+/// \param name The name or component.
+/// \param length The number of characters in \p name.
+/// \return The slot of the key. NULL if out of memory.
+static struct ExcludeSlot* InsertSlot(struct ExcludeSet* set, int parent, const char* name, size_t length)
+{
+	if (!ReserveSlot(set))
+		return NULL;
+
+	if (set->stringsSize + length > set->stringsCapacity)
+	{
+		size_t capacity = (set->stringsCapacity > 0) ? set->stringsCapacity : 4096;
+
+		while (capacity < set->stringsSize + length)
+			capacity *= 2;
+
+		char* strings = realloc(set->strings, capacity);
+
+		if (strings == NULL)
+			return NULL;
+
+		set->strings = strings;
+		set->stringsCapacity = capacity;
+	}
+
+	uint64_t hash = HashExcludeKey(parent, name, length);
+	struct ExcludeSlot* slot = FindSlot(set, parent, name, length, hash);
+
+	memcpy(set->strings + set->stringsSize, name, length);
+
+	slot->hash = hash;
+	slot->parent = parent;
+	slot->node = EXCLUDE_NONE;
+	slot->offset = set->stringsSize;
+	slot->length = length;
+
+	set->stringsSize += length;
+	set->usedCount++;
+
+	return slot;
+}
+
+/// Adds a node to the prefix trie.
+/// \param set The set.
+/// \return The index of the node. EXCLUDE_NONE if out of memory.
+static int AddNode(struct ExcludeSet* set)
+{
+	if (set->nodeCount == set->nodeCapacity)
+	{
+		size_t capacity = (set->nodeCapacity > 0) ? set->nodeCapacity * 2 : 64;
+		bool* terminal = realloc(set->terminal, capacity * sizeof(bool));
+
+		if (terminal == NULL)
+			return EXCLUDE_NONE;
+
+		set->terminal = terminal;
+		set->nodeCapacity = capacity;
+	}
+
+	set->terminal[set->nodeCount] = false;
+
+	return (int) set->nodeCount++;
+}
+
+/// Creates an empty set.
+/// \return The set, which needs to be released with FreeExcludeSet(). NULL if out of memory.
+struct ExcludeSet* CreateExcludeSet(void)
+{
+	struct ExcludeSet* set = calloc(1, sizeof(struct ExcludeSet));
+
+	if (set == NULL)
+		return NULL;
+
+	set->slotCount = EXCLUDE_INITIAL_SLOTS;
+	set->slots = malloc(set->slotCount * sizeof(struct ExcludeSlot));
+
+	if ((set->slots == NULL) || (AddNode(set) != EXCLUDE_ROOT))
+	{
+		FreeExcludeSet(set);
+
+		return NULL;
+	}
+
+	for (size_t i = 0; i < set->slotCount; i++)
+		set->slots[i].parent = EXCLUDE_NONE;
+
+	return set;
+}
+
+/// Excludes all files with a name, wherever they are.
+/// \param set The set.
+/// \param name The name.
+/// \param length The number of characters in \p name.
+/// \return true if the name has been added or was in the set already. false if out of memory.
+bool AddExcludedName(struct ExcludeSet* set, const char* name, size_t length)
+{
+	assert(set != NULL);
+	assert(name != NULL);
+
+
+	if (IsExcludedName(set, name, length))
+		return true;
+
+	return InsertSlot(set, EXCLUDE_NAME_PARENT, name, length) != NULL;
+}
+
+/// Excludes a path together with everything below it. Empty and "." components are ignored, as the walk never produces them.
+/// \param set The set.
+/// \param path The path. Absolute paths only match below absolute roots, relative paths only below relative ones.
+/// \return true if the prefix has been added. false if out of memory.
+bool AddExcludedPrefix(struct ExcludeSet* set, const char* path)
+{
+	assert(set != NULL);
+	assert(path != NULL);
+
+
+	int node = EXCLUDE_ROOT;
+	const char* component = path;
+	size_t length = (path[0] == '/') ? 1 : strcspn(path, "/");
+
+	while (true)
+	{
+		if ((length > 0) && !((length == 1) && (component[0] == '.')))
+		{
+			int child = FindExcludeChild(set, node, component, length);
+
+			if (child == EXCLUDE_NONE)
+			{
+				struct ExcludeSlot* slot = InsertSlot(set, node, component, length);
+
+				// The node is added after the slot, so that a failure leaves no edge to a missing node
+				if ((slot == NULL) || ((child = AddNode(set)) == EXCLUDE_NONE))
+					return false;
+
+				slot->node = child;
+			}
+
+			node = child;
+		}
+
+		component += length;
+
+		if (*component == '\0')
+			break;
+
+		if (*component == '/')
+			component++;
+
+		length = strcspn(component, "/");
+	}
+
+	set->terminal[node] = true;
+
+	return true;
+}
+
+/// Determines whether a name is excluded.
+/// \param set The set.
+/// \param name The name of a file.
+/// \param length The number of characters in \p name.
+/// \return true if all files with the name are excluded. Otherwise, false.
+bool IsExcludedName(const struct ExcludeSet* set, const char* name, size_t length)
+{
+	assert(set != NULL);
+	assert(name != NULL);
+
+
+	return FindSlot(set, EXCLUDE_NAME_PARENT, name, length, HashExcludeKey(EXCLUDE_NAME_PARENT, name, length))->parent != EXCLUDE_NONE;
+}
+
+/// Gets the trie node of a file from the node of its directory.
+/// \param set The set.
+/// \param node The node of the directory, or EXCLUDE_ROOT for the first component of a relative path.
+/// \param name The name of the file, or EXCLUDE_ABSOLUTE for the start of an absolute path.
+/// \param length The number of characters in \p name.
+/// \return The node of the file. EXCLUDE_NONE if no excluded prefix continues with the name.
+int FindExcludeChild(const struct ExcludeSet* set, int node, const char* name, size_t length)
+{
+	assert(set != NULL);
+	assert(name != NULL);
+
+
+	if (node == EXCLUDE_NONE)
+		return EXCLUDE_NONE;
+
+	const struct ExcludeSlot* slot = FindSlot(set, node, name, length, HashExcludeKey(node, name, length));
+
+	return (slot->parent != EXCLUDE_NONE) ? slot->node : EXCLUDE_NONE;
+}
+
+/// Determines whether the path of a trie node is excluded.
+/// \param set The set.
+/// \param node The node, as returned by FindExcludeChild().
+/// \return true if the path and everything below it is excluded. Otherwise, false.
+bool IsExcludedPrefix(const struct ExcludeSet* set, int node)
+{
+	assert(set != NULL);
+
+
+	return (node != EXCLUDE_NONE) && set->terminal[node];
+}
+
+/// Determines whether any prefixes have been added, so that the walk can skip the lookups otherwise.
+/// \param set The set.
+/// \return true if there are prefixes. Otherwise, false.
+bool HasExcludedPrefixes(const struct ExcludeSet* set)
+{
+	assert(set != NULL);
+
+
+	return set->nodeCount > 1;
+}
+
+/// Frees a set. No walk may use it anymore.
+/// \param set The set to free. May be NULL.
+void FreeExcludeSet(struct ExcludeSet* set)
+{
+	if (set == NULL)
+		return;
+
+	free(set->slots);
+	free(set->strings);
+	free(set->terminal);
+	free(set);
+}
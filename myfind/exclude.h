@@ -0,0 +1,34 @@
+/// \file exclude.h
+/// Sets of excluded file names and path prefixes, whose cost per entry does not grow with their size.
+
+
+
+#ifndef EXCLUDE_H
+#define EXCLUDE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+
+/// The node of the prefix trie for the empty path, which relative prefixes start at.
+#define EXCLUDE_ROOT 0
+
+/// Stands for a path below which no excluded prefix continues.
+#define EXCLUDE_NONE -1
+
+/// The component that absolute prefixes start with. No file name can contain a slash.
+#define EXCLUDE_ABSOLUTE "/"
+
+struct ExcludeSet;
+
+struct ExcludeSet* CreateExcludeSet(void);
+bool AddExcludedName(struct ExcludeSet* set, const char* name, size_t length);
+bool AddExcludedPrefix(struct ExcludeSet* set, const char* path);
+bool IsExcludedName(const struct ExcludeSet* set, const char* name, size_t length);
+int FindExcludeChild(const struct ExcludeSet* set, int node, const char* name, size_t length);
+bool IsExcludedPrefix(const struct ExcludeSet* set, int node);
+bool HasExcludedPrefixes(const struct ExcludeSet* set);
+void FreeExcludeSet(struct ExcludeSet* set);
+
+#endif
@@ -0,0 +1,89 @@
+/// \file fold.c
+/// Case folding of names and paths for "-iname", "-ipath" and "-iregex".
+///
+/// Almost all file names are ASCII, where folding is a matter of setting one bit
+/// of the uppercase letters. On processors with SSE2, FoldAscii() folds 16 bytes
+/// at once and notes on the way whether any byte is outside of ASCII, so that the
+/// caller can leave those names to the locale-aware fnmatch(FNM_CASEFOLD).
+/// The remainder, which is all of most names, is folded 8 bytes at a time
+/// within a 64-bit integer.
+
+
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fold.h"
+
+
+
+/// Converts the uppercase ASCII letters of a string to lowercase and copies all other bytes.
+/// \param source The string to fold.
+/// \param length The number of bytes in \p source.
+/// \param destination Receives the \p length folded bytes. May be the same as \p source.
+/// \return true if all bytes are ASCII, so that the folded string is its complete lowercase form. false if there are other bytes, whose case depends on the locale.
+bool FoldAscii(const char* source, size_t length, char* destination)
+{
+	assert((source != NULL) || (length == 0));
+	assert((destination != NULL) || (length == 0));
+
+
+	size_t i = 0;
+	bool ascii = true;
+
+#ifdef __SSE2__
+	const __m128i beforeA = _mm_set1_epi8('A' - 1);
+	const __m128i afterZ = _mm_set1_epi8('Z' + 1);
+	const __m128i caseBit = _mm_set1_epi8(0x20);
+	__m128i highBits = _mm_setzero_si128();
+
+	for (; i + 16 <= length; i += 16)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i*) (source + i));
+
+		// The comparisons are signed, so bytes outside of ASCII are never taken for letters
+		__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(block, beforeA), _mm_cmplt_epi8(block, afterZ));
+
+		_mm_storeu_si128((__m128i*) (destination + i), _mm_or_si128(block, _mm_and_si128(upper, caseBit)));
+		highBits = _mm_or_si128(highBits, block);
+	}
+
+	ascii = (_mm_movemask_epi8(highBits) == 0);
+#endif
+
+	const uint64_t highBit = 0x8080808080808080ull;
+	uint64_t highWords = 0;
+
+	for (; i + 8 <= length; i += 8)
+	{
+		uint64_t block;
+
+		memcpy(&block, source + i, 8);
+
+		// Adding to the lower 7 bits of each byte sets its high bit if the byte is at least 'A' or greater than 'Z', respectively
+		uint64_t low = block & ~highBit;
+		uint64_t upper = (low + 0x3F3F3F3F3F3F3F3Full) & ~(low + 0x2525252525252525ull) & ~block & highBit;
+
+		highWords |= block;
+		block |= upper >> 2;
+		memcpy(destination + i, &block, 8);
+	}
+
+	ascii = ascii && ((highWords & highBit) == 0);
+
+	// Fold the remaining bytes one at a time
+	for (; i < length; i++)
+	{
+		unsigned char c = (unsigned char) source[i];
+
+		ascii = ascii && (c < 0x80);
+		destination[i] = (char) (((c >= 'A') && (c <= 'Z')) ? (c | 0x20) : c);
+	}
+
+	return ascii;
+}
@@ -0,0 +1,16 @@
+/// \file fold.h
+/// Case folding of names and paths for "-iname", "-ipath" and "-iregex".
+
+
+
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+
+bool FoldAscii(const char* source, size_t length, char* destination);
+
+#endif
@@ -0,0 +1,135 @@
+/// \file fstype.c
+/// Determines the type of the file system a path is on, to choose how to walk it.
+///
+/// statfs() reports the type as the magic number of the file system's driver.
+/// Only the types whose walk differs from that of a local disk need to be known;
+/// The others are named for the diagnostics only. Unknown types are treated as
+/// local, which is the right choice for the disk file systems not listed here.
+
+
+
+#include <stddef.h>
+#include <assert.h>
+#include <sys/vfs.h>
+
+#include "fstype.h"
+
+
+
+/// A file system type known by its magic number.
+struct KnownFileSystem
+{
+	/// The magic number reported by statfs().
+	unsigned long magic;
+
+	/// The name of the file system.
+	const char* name;
+
+	/// The kind of the file system.
+	enum FileSystemClass fileSystemClass;
+};
+
+/// The file system types known to QueryFileSystem(), see linux/magic.h.
+static const struct KnownFileSystem KnownFileSystems[] =
+{
+	{ 0xEF53, "ext4", FileSystemLocal },
+	{ 0x58465342, "xfs", FileSystemLocal },
+	{ 0x9123683E, "btrfs", FileSystemLocal },
+	{ 0x2FC12FC1, "zfs", FileSystemLocal },
+	{ 0xF2F52010, "f2fs", FileSystemLocal },
+	{ 0x01021994, "tmpfs", FileSystemLocal },
+	{ 0x858458F6, "ramfs", FileSystemLocal },
+	{ 0x794C7630, "overlay", FileSystemLocal },
+	{ 0x4D44, "vfat", FileSystemLocal },
+	{ 0x2011BAB0, "exfat", FileSystemLocal },
+	{ 0x5346544E, "ntfs", FileSystemLocal },
+	{ 0x9660, "iso9660", FileSystemLocal },
+	{ 0x73717368, "squashfs", FileSystemLocal },
+	{ 0x6969, "nfs", FileSystemNetwork },
+	{ 0xFF534D42, "cifs", FileSystemNetwork },
+	{ 0xFE534D42, "smb2", FileSystemNetwork },
+	{ 0x517B, "smb", FileSystemNetwork },
+	{ 0x65735546, "fuse", FileSystemNetwork },
+	{ 0x00C36400, "ceph", FileSystemNetwork },
+	{ 0x01021997, "9p", FileSystemNetwork },
+	{ 0x5346414F, "afs", FileSystemNetwork },
+	{ 0x0BD00BD0, "lustre", FileSystemNetwork },
+	{ 0x01161970, "gfs2", FileSystemNetwork },
+	{ 0x7461636F, "ocfs2", FileSystemNetwork },
+	{ 0x9FA0, "proc", FileSystemPseudo },
+	{ 0x62656572, "sysfs", FileSystemPseudo },
+	{ 0x1CD1, "devpts", FileSystemPseudo },
+	{ 0x27E0EB, "cgroup", FileSystemPseudo },
+	{ 0x63677270, "cgroup2", FileSystemPseudo },
+	{ 0x64626720, "debugfs", FileSystemPseudo },
+	{ 0x74726163, "tracefs", FileSystemPseudo },
+	{ 0x73636673, "securityfs", FileSystemPseudo },
+	{ 0xCAFE4A11, "bpf", FileSystemPseudo },
+	{ 0x62656570, "configfs", FileSystemPseudo },
+	{ 0x6165676C, "pstore", FileSystemPseudo },
+};
+
+
+
+/// Determines the type of the file system a path is on.
+/// \param path The path of a file or directory on the file system.
+/// \param type Receives the type. If statfs() fails, the class is FileSystemUnknown.
+/// \return true if statfs() has succeeded. Otherwise, false.
+bool QueryFileSystem(const char* path, struct FileSystemType* type)
+{
+	assert(path != NULL);
+	assert(type != NULL);
+
+
+	struct statfs information;
+
+	if (statfs(path, &information) == -1)
+	{
+		type->magic = 0;
+		type->name = "unknown";
+		type->fileSystemClass = FileSystemUnknown;
+
+		return false;
+	}
+
+	// The magic number is a signed long on some architectures
+	type->magic = (unsigned long) information.f_type & 0xFFFFFFFFul;
+	type->name = "unknown";
+	type->fileSystemClass = FileSystemLocal;
+
+	for (size_t i = 0; i < sizeof(KnownFileSystems) / sizeof(KnownFileSystems[0]); i++)
+	{
+		if (KnownFileSystems[i].magic == type->magic)
+		{
+			type->name = KnownFileSystems[i].name;
+			type->fileSystemClass = KnownFileSystems[i].fileSystemClass;
+
+			break;
+		}
+	}
+
+	return true;
+}
+
+/// Gets a name for a kind of file system, as used in the diagnostics.
+/// \param fileSystemClass The kind of file system.
+/// \return The name, e.g. "network".
+const char* GetFileSystemClassName(enum FileSystemClass fileSystemClass)
+{
+	switch (fileSystemClass)
+	{
+	case FileSystemLocal:
+		return "local";
+
+	case FileSystemNetwork:
+		return "network";
+
+	case FileSystemPseudo:
+		return "pseudo";
+
+	case FileSystemUnknown:
+		break;
+	}
+
+	return "unknown";
+}
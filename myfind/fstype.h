@@ -0,0 +1,45 @@
+/// \file fstype.h
+/// Determines the type of the file system a path is on, to choose how to walk it.
+
+
+
+#ifndef FSTYPE_H
+#define FSTYPE_H
+
+#include <stdbool.h>
+
+
+
+/// The kinds of file systems that call for different ways of walking them.
+enum FileSystemClass
+{
+	/// A file system on a local disk or in memory. The calls are cheap, so a single thread keeps up.
+	FileSystemLocal,
+
+	/// A file system whose calls go to a server or a user space daemon. The calls have a high latency, so many of them should be in flight.
+	FileSystemNetwork,
+
+	/// A file system generated by the kernel, e.g. /proc. The calls are cheap and the files are small.
+	FileSystemPseudo,
+
+	/// The type could not be determined.
+	FileSystemUnknown,
+};
+
+/// The type of a file system as determined by QueryFileSystem().
+struct FileSystemType
+{
+	/// The magic number reported by statfs(). Zero if statfs() has failed.
+	unsigned long magic;
+
+	/// The name of the file system, e.g. "ext4". "unknown" if the magic number is not known.
+	const char* name;
+
+	/// The kind of the file system.
+	enum FileSystemClass fileSystemClass;
+};
+
+bool QueryFileSystem(const char* path, struct FileSystemType* type);
+const char* GetFileSystemClassName(enum FileSystemClass fileSystemClass);
+
+#endif
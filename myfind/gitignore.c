@@ -0,0 +1,437 @@
+/// \file gitignore.c
+/// The rules of .gitignore files, so that a walk can skip the files git ignores.
+///
+/// Each .gitignore file is parsed once, when the walk enters its directory, into
+/// rules that know how they are matched: Plain names are compared directly, "*.ext"
+/// patterns by their suffix, and only the other patterns run through WildMatch(),
+/// which implements the glob dialect of git including "**". The walk keeps the
+/// rules of each directory on its stack, so that the rules of the parent
+/// directories apply below them and are dropped when the walk leaves them.
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "gitignore.h"
+
+
+
+/// The ways a rule's pattern can be matched, from the cheapest to the most general one.
+enum IgnorePatternKind
+{
+	/// The pattern does not contain any special characters and only matches itself.
+	IgnorePatternLiteral,
+	/// The pattern is an asterisk followed by a literal, which only has to be compared with the end of the name.
+	IgnorePatternSuffix,
+	/// Any other pattern, which is matched with WildMatch().
+	IgnorePatternGlob,
+};
+
+/// A single line of a .gitignore file.
+struct IgnoreRule
+{
+	/// The pattern, without "!", a leading slash and a trailing slash. For suffix patterns, the asterisk is skipped.
+	const char* pattern;
+
+	/// The number of characters in \p pattern.
+	size_t length;
+
+	/// How \p pattern is matched.
+	enum IgnorePatternKind kind;
+
+	/// Indicates whether the rule re-includes what it matches, as written with a leading "!".
+	bool negate;
+
+	/// Indicates whether the rule only matches directories, as written with a trailing slash.
+	bool directoryOnly;
+
+	/// Indicates whether the pattern is matched against the path relative to the .gitignore file instead of the name, as it contains a slash.
+	bool anchored;
+};
+
+/// The compiled rules of a single .gitignore file.
+struct IgnoreRules
+{
+	/// The rules in the order of the file. The last matching one decides.
+	struct IgnoreRule* rules;
+
+	/// The number of entries in \p rules.
+	size_t ruleCount;
+
+	/// The content of the file, modified in place to hold the patterns of \p rules.
+	char* text;
+};
+
+
+
+/// Matches a string against a glob pattern as git does: "*" and "?" do not match a slash, while "**" as a whole component matches any number of directories.
+/// \param start The start of the whole pattern, to recognize "**" at its beginning.
+/// \param pattern The rest of the pattern to match.
+/// \param string The rest of the string to match.
+/// \return true if the string matches the pattern. Otherwise, false.
+static bool WildMatch(const char* start, const char* pattern, const char* string)
+{
+	while (*pattern != '\0')
+	{
+		switch (*pattern)
+		{
+		case '*':
+		{
+			bool componentStart = (pattern == start) || (pattern[-1] == '/');
+
+			if ((pattern[1] == '*') && componentStart && ((pattern[2] == '/') || (pattern[2] == '\0')))
+			{
+				// A trailing "/**" matches everything inside the directory
+				if (pattern[2] == '\0')
+					return true;
+
+				// "**/" matches zero or more directories
+				for (const char* rest = string; rest != NULL; rest = strchr(rest, '/'))
+				{
+					if (rest != string)
+						rest++;
+
+					if (WildMatch(start, pattern + 3, rest))
+						return true;
+				}
+
+				return false;
+			}
+
+			// Any other run of asterisks matches within a single component
+			while (*pattern == '*')
+				pattern++;
+
+			for (const char* rest = string; ; rest++)
+			{
+				if (WildMatch(start, pattern, rest))
+					return true;
+
+				if ((*rest == '\0') || (*rest == '/'))
+					return false;
+			}
+		}
+
+		case '?':
+			if ((*string == '\0') || (*string == '/'))
+				return false;
+
+			pattern++;
+			string++;
+			break;
+
+		case '[':
+		{
+			// Find the end of the bracket expression; A closing bracket right at the start is a member
+			const char* end = pattern + 1;
+
+			if ((*end == '!') || (*end == '^'))
+				end++;
+
+			if (*end == ']')
+				end++;
+
+			while ((*end != '\0') && (*end != ']'))
+				end++;
+
+			if (*end == '\0')
+			{
+				// Without a closing bracket, the bracket is an ordinary character
+				if (*string != '[')
+					return false;
+
+				pattern++;
+				string++;
+				break;
+			}
+
+			if ((*string == '\0') || (*string == '/'))
+				return false;
+
+			// The members, ranges and classes are left to fnmatch(), one character at a time
+			size_t length = (size_t) (end - pattern) + 1;
+			char bracket[length + 1];
+			char character[2] = { *string, '\0' };
+
+			memcpy(bracket, pattern, length);
+			bracket[length] = '\0';
+
+			if (fnmatch(bracket, character, 0) != 0)
+				return false;
+
+			pattern = end + 1;
+			string++;
+			break;
+		}
+
+		case '\\':
+			// The escaped character is compared literally
+			if (pattern[1] != '\0')
+				pattern++;
+
+			// Fall through
+
+		default:
+			if (*pattern != *string)
+				return false;
+
+			pattern++;
+			string++;
+			break;
+		}
+	}
+
+	return *string == '\0';
+}
+
+/// Parses a line of a .gitignore file into a rule.
+/// \param line The line, without the line break. It is modified to hold the rule's pattern.
+/// \param rule Receives the rule.
+/// \return true if the line is a rule. false if it is empty or a comment.
+static bool ParseIgnoreRule(char* line, struct IgnoreRule* rule)
+{
+	size_t length = strlen(line);
+
+	if (line[0] == '#')
+		return false;
+
+	// Trailing spaces are removed unless they are escaped with a backslash
+	while ((length > 0) && (line[length - 1] == ' ') && !((length > 1) && (line[length - 2] == '\\')))
+		line[--length] = '\0';
+
+	memset(rule, 0, sizeof(struct IgnoreRule));
+
+	if (line[0] == '!')
+	{
+		rule->negate = true;
+		line++;
+		length--;
+	}
+	else if ((line[0] == '\\') && ((line[1] == '!') || (line[1] == '#')))
+	{
+		// An escaped "!" or "#" is an ordinary first character
+		line++;
+		length--;
+	}
+
+	if ((length > 0) && (line[length - 1] == '/'))
+	{
+		rule->directoryOnly = true;
+		line[--length] = '\0';
+	}
+
+	// A slash at the start or in the middle anchors the pattern at the directory of the .gitignore file
+	if (strchr(line, '/') != NULL)
+	{
+		rule->anchored = true;
+
+		if (line[0] == '/')
+		{
+			line++;
+			length--;
+		}
+	}
+
+	if (length == 0)
+		return false;
+
+	if (strpbrk(line, "*?[\\") == NULL)
+	{
+		rule->kind = IgnorePatternLiteral;
+	}
+	else if (!rule->anchored && (line[0] == '*') && (strpbrk(line + 1, "*?[\\") == NULL))
+	{
+		rule->kind = IgnorePatternSuffix;
+		line++;
+		length--;
+	}
+	else
+	{
+		rule->kind = IgnorePatternGlob;
+	}
+
+	rule->pattern = line;
+	rule->length = length;
+
+	return true;
+}
+
+/// Reads and compiles a .gitignore file.
+/// \param path The path of the file.
+/// \param errors The stream to report a failure to read the file to. May be NULL.
+/// \return The rules, which need to be released with FreeIgnoreRules(). NULL if the file does not contain any rules or cannot be read.
+struct IgnoreRules* LoadIgnoreRules(const char* path, FILE* errors)
+{
+	assert(path != NULL);
+
+
+	FILE* file = fopen(path, "r");
+
+	if (file == NULL)
+	{
+		if (errors != NULL)
+			fprintf(errors, "Opening \"%s\" has failed with error code %d: %s\n", path, errno, strerror(errno));
+
+		return NULL;
+	}
+
+	// Read the whole file, so that the patterns can stay where they are
+	char* text = NULL;
+	size_t size = 0;
+	size_t capacity = 0;
+	bool failed = false;
+
+	while (!failed)
+	{
+		if (size + 1 >= capacity)
+		{
+			capacity = (capacity > 0) ? capacity * 2 : 4096;
+
+			char* larger = realloc(text, capacity);
+
+			if (larger == NULL)
+			{
+				// Out of memory
+				exit(-1);
+			}
+
+			text = larger;
+		}
+
+		size_t count = fread(text + size, 1, capacity - size - 1, file);
+
+		size += count;
+
+		if (count == 0)
+		{
+			failed = ferror(file);
+			break;
+		}
+	}
+
+	fclose(file);
+
+	if (failed)
+	{
+		if (errors != NULL)
+			fprintf(errors, "Reading \"%s\" has failed.\n", path);
+
+		free(text);
+
+		return NULL;
+	}
+
+	text[size] = '\0';
+
+	// There cannot be more rules than line breaks plus one
+	size_t lineCount = 1;
+
+	for (size_t i = 0; i < size; i++)
+		lineCount += (text[i] == '\n');
+
+	struct IgnoreRules* rules = calloc(1, sizeof(struct IgnoreRules));
+
+	if (rules != NULL)
+		rules->rules = malloc(lineCount * sizeof(struct IgnoreRule));
+
+	if ((rules == NULL) || (rules->rules == NULL))
+	{
+		// Out of memory
+		exit(-1);
+	}
+
+	rules->text = text;
+
+	for (char* line = text; line != NULL; )
+	{
+		char* next = strchr(line, '\n');
+
+		if (next != NULL)
+			*next++ = '\0';
+
+		// Files written on Windows end their lines with a carriage return as well
+		size_t length = strlen(line);
+
+		if ((length > 0) && (line[length - 1] == '\r'))
+			line[length - 1] = '\0';
+
+		if (ParseIgnoreRule(line, &rules->rules[rules->ruleCount]))
+			rules->ruleCount++;
+
+		line = next;
+	}
+
+	if (rules->ruleCount == 0)
+	{
+		FreeIgnoreRules(rules);
+
+		return NULL;
+	}
+
+	return rules;
+}
+
+/// Matches a file against the rules of a .gitignore file.
+/// \param rules The rules.
+/// \param relativePath The path of the file relative to the directory of the .gitignore file.
+/// \param name The name of the file, the last component of \p relativePath.
+/// \param nameLength The number of characters in \p name.
+/// \param isDirectory Indicates whether the file is a directory.
+/// \return Whether the last matching rule ignores or re-includes the file. IgnoreNone if no rule matches.
+enum IgnoreMatch MatchIgnoreRules(const struct IgnoreRules* rules, const char* relativePath, const char* name, size_t nameLength, bool isDirectory)
+{
+	assert(rules != NULL);
+	assert(relativePath != NULL);
+	assert(name != NULL);
+
+
+	// The last matching rule wins, so search from the end
+	for (size_t i = rules->ruleCount; i > 0; i--)
+	{
+		const struct IgnoreRule* rule = &rules->rules[i - 1];
+		bool matches;
+
+		if (rule->directoryOnly && !isDirectory)
+			continue;
+
+		switch (rule->kind)
+		{
+		case IgnorePatternLiteral:
+			matches = rule->anchored
+				? (strcmp(relativePath, rule->pattern) == 0)
+				: ((nameLength == rule->length) && (memcmp(name, rule->pattern, nameLength) == 0));
+			break;
+
+		case IgnorePatternSuffix:
+			matches = (nameLength >= rule->length) && (memcmp(name + nameLength - rule->length, rule->pattern, rule->length) == 0);
+			break;
+
+		default:
+			matches = rule->anchored
+				? WildMatch(rule->pattern, rule->pattern, relativePath)
+				: WildMatch(rule->pattern, rule->pattern, name);
+			break;
+		}
+
+		if (matches)
+			return rule->negate ? IgnoreInclude : IgnoreExclude;
+	}
+
+	return IgnoreNone;
+}
+
+/// Frees the rules of a .gitignore file.
+/// \param rules The rules to free. May be NULL.
+void FreeIgnoreRules(struct IgnoreRules* rules)
+{
+	if (rules == NULL)
+		return;
+
+	free(rules->rules);
+	free(rules->text);
+	free(rules);
+}
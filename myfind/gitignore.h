@@ -0,0 +1,34 @@
+/// \file gitignore.h
+/// The rules of .gitignore files, so that a walk can skip the files git ignores.
+
+
+
+#ifndef GITIGNORE_H
+#define GITIGNORE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+
+/// The results of matching a path against the rules of a .gitignore file.
+enum IgnoreMatch
+{
+	/// No rule matches the path; The rules of the parent directories decide.
+	IgnoreNone,
+
+	/// The last matching rule ignores the path.
+	IgnoreExclude,
+
+	/// The last matching rule is negated with "!" and re-includes the path.
+	IgnoreInclude,
+};
+
+struct IgnoreRules;
+
+struct IgnoreRules* LoadIgnoreRules(const char* path, FILE* errors);
+enum IgnoreMatch MatchIgnoreRules(const struct IgnoreRules* rules, const char* relativePath, const char* name, size_t nameLength, bool isDirectory);
+void FreeIgnoreRules(struct IgnoreRules* rules);
+
+#endif
@@ -0,0 +1,281 @@
+/// \file guard.c
+/// Runs file system calls that might block forever, e.g. on a stale network mount, on a helper thread with a timeout.
+///
+/// A thread blocked in the kernel cannot be interrupted, so a call that does not
+/// return in time is abandoned: Its helper thread keeps the request and frees it
+/// once the call returns, if ever, while a new helper takes over the next calls.
+/// The caller therefore only ever waits for the timeout, and the number of stuck
+/// helpers is limited, so that a dead server does not exhaust the threads.
+
+
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "guard.h"
+#include "stats.h"
+
+
+
+/// A helper thread that performs one call at a time.
+struct GuardHelper
+{
+	/// Protects all other members and is used with \p requested and \p finished.
+	pthread_mutex_t lock;
+
+	/// Signalled when a request has been handed to the helper or the helper should exit.
+	pthread_cond_t requested;
+
+	/// Signalled when the helper has performed the requested call.
+	pthread_cond_t finished;
+
+	/// The function performing the requested call. NULL while no call is pending.
+	GuardedWork work;
+
+	/// The function freeing \p request if the call is abandoned.
+	GuardedRelease release;
+
+	/// The request to pass to \p work.
+	void* request;
+
+	/// Indicates whether the requested call has returned.
+	bool done;
+
+	/// Indicates whether the caller has given up waiting, in which case the helper frees the request and itself.
+	bool abandoned;
+
+	/// Indicates whether the helper should exit.
+	bool stopping;
+
+	/// The helper thread.
+	pthread_t thread;
+};
+
+/// The helpers available to a caller.
+struct CallGuard
+{
+	/// The time to wait for each call.
+	unsigned long long timeoutMilliseconds;
+
+	/// The helper performing the next call. NULL if a new one needs to be started.
+	struct GuardHelper* helper;
+
+	/// The number of helpers that have been abandoned in a call.
+	unsigned int abandonedHelpers;
+};
+
+
+
+/// Frees the synchronization objects and the memory of a helper.
+/// \param helper The helper to free.
+static void FreeGuardHelper(struct GuardHelper* helper)
+{
+	pthread_cond_destroy(&helper->requested);
+	pthread_cond_destroy(&helper->finished);
+	pthread_mutex_destroy(&helper->lock);
+	free(helper);
+}
+
+/// Performs the requested calls until the helper is stopped or abandoned.
+/// \param argument A pointer to the struct GuardHelper to run.
+/// \return Always NULL.
+static void* RunGuardHelper(void* argument)
+{
+	struct GuardHelper* helper = argument;
+
+	pthread_mutex_lock(&helper->lock);
+
+	while (true)
+	{
+		while (!helper->stopping && (helper->work == NULL))
+			pthread_cond_wait(&helper->requested, &helper->lock);
+
+		if (helper->stopping)
+			break;
+
+		GuardedWork work = helper->work;
+
+		pthread_mutex_unlock(&helper->lock);
+		work(helper->request);
+		pthread_mutex_lock(&helper->lock);
+
+		// Wait for the next request
+		helper->work = NULL;
+		helper->done = true;
+
+		if (helper->abandoned)
+		{
+			// Nobody waits for the result anymore; The caller has moved on to another helper
+			pthread_mutex_unlock(&helper->lock);
+
+			helper->release(helper->request);
+			FreeGuardHelper(helper);
+			MergeThreadStats();
+
+			return NULL;
+		}
+
+		pthread_cond_signal(&helper->finished);
+	}
+
+	pthread_mutex_unlock(&helper->lock);
+
+	MergeThreadStats();
+
+	return NULL;
+}
+
+/// Starts a new helper thread.
+/// \return The new helper. NULL if the thread could not be started.
+static struct GuardHelper* StartGuardHelper()
+{
+	struct GuardHelper* helper = calloc(1, sizeof(struct GuardHelper));
+
+	if (helper == NULL)
+		return NULL;
+
+	pthread_condattr_t attributes;
+
+	// The timeouts are measured on the monotonic clock, so that changes of the system time do not matter
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(&helper->finished, &attributes);
+	pthread_condattr_destroy(&attributes);
+
+	pthread_cond_init(&helper->requested, NULL);
+	pthread_mutex_init(&helper->lock, NULL);
+
+	if (pthread_create(&helper->thread, NULL, RunGuardHelper, helper) != 0)
+	{
+		FreeGuardHelper(helper);
+
+		return NULL;
+	}
+
+	return helper;
+}
+
+/// Creates a guard with a first helper thread.
+/// \param timeoutMilliseconds The time to wait for each call.
+/// \return The new guard, which needs to be freed with FreeCallGuard(). NULL if the helper thread could not be started.
+struct CallGuard* CreateCallGuard(unsigned long long timeoutMilliseconds)
+{
+	assert(timeoutMilliseconds > 0);
+
+
+	struct CallGuard* guard = calloc(1, sizeof(struct CallGuard));
+
+	if (guard == NULL)
+		return NULL;
+
+	guard->timeoutMilliseconds = timeoutMilliseconds;
+	guard->helper = StartGuardHelper();
+
+	if (guard->helper == NULL)
+	{
+		free(guard);
+
+		return NULL;
+	}
+
+	return guard;
+}
+
+/// Performs a call on a helper thread and waits for it up to the timeout of the guard.
+/// \param guard The guard whose helpers to use.
+/// \param work The function performing the call.
+/// \param release The function freeing \p request if the call does not return in time.
+/// \param request The request passed to \p work.
+/// \return true if the call has returned in time; The caller keeps \p request. false if it has not or could not be made; The guard then frees \p request with \p release.
+bool RunGuardedCall(struct CallGuard* guard, GuardedWork work, GuardedRelease release, void* request)
+{
+	assert(guard != NULL);
+	assert(work != NULL);
+	assert(release != NULL);
+
+
+	// Replace the helper that has been abandoned last, unless too many of them are stuck already
+	if ((guard->helper == NULL) && (guard->abandonedHelpers < GUARD_MAX_ABANDONED_HELPERS))
+		guard->helper = StartGuardHelper();
+
+	struct GuardHelper* helper = guard->helper;
+
+	if (helper == NULL)
+	{
+		release(request);
+
+		return false;
+	}
+
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	deadline.tv_sec += guard->timeoutMilliseconds / 1000;
+	deadline.tv_nsec += (guard->timeoutMilliseconds % 1000) * 1000000L;
+
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&helper->lock);
+
+	helper->work = work;
+	helper->release = release;
+	helper->request = request;
+	helper->done = false;
+
+	pthread_cond_signal(&helper->requested);
+
+	while (!helper->done && (pthread_cond_timedwait(&helper->finished, &helper->lock, &deadline) == 0))
+		;
+
+	if (helper->done)
+	{
+		pthread_mutex_unlock(&helper->lock);
+
+		return true;
+	}
+
+	// Leave the request to the helper, which frees it and itself once the call returns
+	pthread_t thread = helper->thread;
+
+	helper->abandoned = true;
+	pthread_mutex_unlock(&helper->lock);
+
+	pthread_detach(thread);
+
+	guard->helper = NULL;
+	guard->abandonedHelpers++;
+
+	return false;
+}
+
+/// Stops the current helper thread and frees the guard. Abandoned helpers are left to finish their calls.
+/// \param guard The guard to free. May be NULL.
+void FreeCallGuard(struct CallGuard* guard)
+{
+	if (guard == NULL)
+		return;
+
+	struct GuardHelper* helper = guard->helper;
+
+	if (helper != NULL)
+	{
+		pthread_mutex_lock(&helper->lock);
+		helper->stopping = true;
+		pthread_cond_signal(&helper->requested);
+		pthread_mutex_unlock(&helper->lock);
+
+		pthread_join(helper->thread, NULL);
+
+		FreeGuardHelper(helper);
+	}
+
+	free(guard);
+}
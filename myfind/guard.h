@@ -0,0 +1,30 @@
+/// \file guard.h
+/// Runs file system calls that might block forever, e.g. on a stale network mount, on a helper thread with a timeout.
+
+
+
+#ifndef GUARD_H
+#define GUARD_H
+
+#include <stdbool.h>
+
+
+
+/// The maximum number of helper threads that may be stuck in a call at the same time. Once reached, further calls fail immediately.
+#define GUARD_MAX_ABANDONED_HELPERS 32
+
+/// The function performing the call, on a helper thread.
+/// \param request The request passed to RunGuardedCall(), which receives the results of the call.
+typedef void (*GuardedWork)(void* request);
+
+/// The function freeing a request whose call has timed out, once the call has returned after all.
+/// \param request The request passed to RunGuardedCall().
+typedef void (*GuardedRelease)(void* request);
+
+struct CallGuard;
+
+struct CallGuard* CreateCallGuard(unsigned long long timeoutMilliseconds);
+bool RunGuardedCall(struct CallGuard* guard, GuardedWork work, GuardedRelease release, void* request);
+void FreeCallGuard(struct CallGuard* guard);
+
+#endif
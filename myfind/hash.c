@@ -0,0 +1,400 @@
+/// \file hash.c
+/// Hash functions used to compare and fingerprint file contents.
+///
+/// Hash64() implements the XXH64 algorithm, a fast non-cryptographic hash that
+/// processes 32 bytes per iteration in four independent lanes. The SHA-256
+/// functions implement FIPS 180-4 for cases where a cryptographic digest is
+/// required.
+
+
+
+#include <string.h>
+#include <assert.h>
+
+#include "hash.h"
+
+
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+
+/// The SHA-256 round constants.
+static const uint32_t Sha256RoundConstants[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+
+
+/// Rotates the provided value to the left.
+static inline uint64_t RotateLeft64(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+/// Reads an unaligned little endian 64 bit value.
+static inline uint64_t Read64(const unsigned char* p)
+{
+	uint64_t value;
+
+	memcpy(&value, p, sizeof(value));
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	value = __builtin_bswap64(value);
+#endif
+
+	return value;
+}
+
+/// Reads an unaligned little endian 32 bit value.
+static inline uint32_t Read32(const unsigned char* p)
+{
+	uint32_t value;
+
+	memcpy(&value, p, sizeof(value));
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	value = __builtin_bswap32(value);
+#endif
+
+	return value;
+}
+
+/// Mixes a single 8 byte lane into an accumulator.
+static inline uint64_t Round64(uint64_t accumulator, uint64_t input)
+{
+	accumulator += input * PRIME64_2;
+	accumulator = RotateLeft64(accumulator, 31);
+
+	return accumulator * PRIME64_1;
+}
+
+/// Folds an accumulator into the intermediate hash value.
+static inline uint64_t MergeRound64(uint64_t hash, uint64_t accumulator)
+{
+	hash ^= Round64(0, accumulator);
+
+	return hash * PRIME64_1 + PRIME64_4;
+}
+
+/// Processes a single 32 byte stripe.
+static inline void ProcessStripe(uint64_t accumulators[4], const unsigned char* p)
+{
+	accumulators[0] = Round64(accumulators[0], Read64(p));
+	accumulators[1] = Round64(accumulators[1], Read64(p + 8));
+	accumulators[2] = Round64(accumulators[2], Read64(p + 16));
+	accumulators[3] = Round64(accumulators[3], Read64(p + 24));
+}
+
+
+/// Starts an incremental hash computation.
+/// \param state The state to initialize.
+/// \param seed The seed to start with. Different seeds produce unrelated hash values.
+void Hash64Init(struct Hash64State* state, uint64_t seed)
+{
+	assert(state != NULL);
+
+
+	state->accumulators[0] = seed + PRIME64_1 + PRIME64_2;
+	state->accumulators[1] = seed + PRIME64_2;
+	state->accumulators[2] = seed;
+	state->accumulators[3] = seed - PRIME64_1;
+	state->seed = seed;
+	state->totalLength = 0;
+	state->pendingLength = 0;
+}
+
+/// Adds data to an incremental hash computation.
+/// \param state The state of the computation.
+/// \param data The data to hash.
+/// \param length The number of bytes in \p data.
+void Hash64Update(struct Hash64State* state, const void* data, size_t length)
+{
+	assert(state != NULL);
+	assert((data != NULL) || (length == 0));
+
+
+	const unsigned char* p = data;
+	const unsigned char* end = p + length;
+
+	state->totalLength += length;
+
+	// Complete a previously started stripe first
+	if (state->pendingLength > 0)
+	{
+		size_t missing = 32 - state->pendingLength;
+
+		if (length < missing)
+		{
+			memcpy(state->pending + state->pendingLength, p, length);
+			state->pendingLength += length;
+
+			return;
+		}
+
+		memcpy(state->pending + state->pendingLength, p, missing);
+		ProcessStripe(state->accumulators, state->pending);
+
+		p += missing;
+		state->pendingLength = 0;
+	}
+
+	// Process all complete stripes directly from the input
+	while (end - p >= 32)
+	{
+		ProcessStripe(state->accumulators, p);
+		p += 32;
+	}
+
+	// Keep the remainder for the next call
+	memcpy(state->pending, p, end - p);
+	state->pendingLength = end - p;
+}
+
+/// Finishes an incremental hash computation.
+/// \param state The state of the computation. It must not be updated afterwards.
+/// \return The hash value of all data passed to Hash64Update().
+uint64_t Hash64Final(struct Hash64State* state)
+{
+	assert(state != NULL);
+
+
+	uint64_t hash;
+
+	if (state->totalLength >= 32)
+	{
+		uint64_t* v = state->accumulators;
+
+		hash = RotateLeft64(v[0], 1) + RotateLeft64(v[1], 7) + RotateLeft64(v[2], 12) + RotateLeft64(v[3], 18);
+		hash = MergeRound64(hash, v[0]);
+		hash = MergeRound64(hash, v[1]);
+		hash = MergeRound64(hash, v[2]);
+		hash = MergeRound64(hash, v[3]);
+	}
+	else
+	{
+		hash = state->seed + PRIME64_5;
+	}
+
+	hash += state->totalLength;
+
+	// Mix in the bytes that did not fill a complete stripe
+	const unsigned char* p = state->pending;
+	const unsigned char* end = p + state->pendingLength;
+
+	while (end - p >= 8)
+	{
+		hash ^= Round64(0, Read64(p));
+		hash = RotateLeft64(hash, 27) * PRIME64_1 + PRIME64_4;
+		p += 8;
+	}
+
+	if (end - p >= 4)
+	{
+		hash ^= (uint64_t) Read32(p) * PRIME64_1;
+		hash = RotateLeft64(hash, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+
+	while (p < end)
+	{
+		hash ^= (*p) * PRIME64_5;
+		hash = RotateLeft64(hash, 11) * PRIME64_1;
+		p++;
+	}
+
+	// Avalanche the bits of the final value
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+/// Computes the 64 bit hash value of a contiguous block of data.
+/// \param data The data to hash.
+/// \param length The number of bytes in \p data.
+/// \param seed The seed to start with.
+/// \return The hash value of the data.
+uint64_t Hash64(const void* data, size_t length, uint64_t seed)
+{
+	struct Hash64State state;
+
+	Hash64Init(&state, seed);
+	Hash64Update(&state, data, length);
+
+	return Hash64Final(&state);
+}
+
+
+
+/// Rotates the provided value to the right.
+static inline uint32_t RotateRight32(uint32_t value, int bits)
+{
+	return (value >> bits) | (value << (32 - bits));
+}
+
+/// Processes a single 64 byte block of a SHA-256 computation.
+static void ProcessSha256Block(uint32_t words[8], const unsigned char* p)
+{
+	uint32_t schedule[64];
+
+	for (int i = 0; i < 16; i++)
+	{
+		schedule[i] = ((uint32_t) p[i * 4] << 24) | ((uint32_t) p[i * 4 + 1] << 16) |
+			((uint32_t) p[i * 4 + 2] << 8) | (uint32_t) p[i * 4 + 3];
+	}
+
+	for (int i = 16; i < 64; i++)
+	{
+		uint32_t s0 = RotateRight32(schedule[i - 15], 7) ^ RotateRight32(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+		uint32_t s1 = RotateRight32(schedule[i - 2], 17) ^ RotateRight32(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+
+		schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+	}
+
+	uint32_t a = words[0], b = words[1], c = words[2], d = words[3];
+	uint32_t e = words[4], f = words[5], g = words[6], h = words[7];
+
+	for (int i = 0; i < 64; i++)
+	{
+		uint32_t s1 = RotateRight32(e, 6) ^ RotateRight32(e, 11) ^ RotateRight32(e, 25);
+		uint32_t choice = (e & f) ^ (~e & g);
+		uint32_t t1 = h + s1 + choice + Sha256RoundConstants[i] + schedule[i];
+		uint32_t s0 = RotateRight32(a, 2) ^ RotateRight32(a, 13) ^ RotateRight32(a, 22);
+		uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+		uint32_t t2 = s0 + majority;
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	words[0] += a;
+	words[1] += b;
+	words[2] += c;
+	words[3] += d;
+	words[4] += e;
+	words[5] += f;
+	words[6] += g;
+	words[7] += h;
+}
+
+/// Starts an incremental SHA-256 computation.
+/// \param state The state to initialize.
+void Sha256Init(struct Sha256State* state)
+{
+	assert(state != NULL);
+
+
+	static const uint32_t initialWords[8] =
+	{
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+
+	memcpy(state->words, initialWords, sizeof(initialWords));
+	state->totalLength = 0;
+	state->pendingLength = 0;
+}
+
+/// Adds data to an incremental SHA-256 computation.
+/// \param state The state of the computation.
+/// \param data The data to hash.
+/// \param length The number of bytes in \p data.
+void Sha256Update(struct Sha256State* state, const void* data, size_t length)
+{
+	assert(state != NULL);
+	assert((data != NULL) || (length == 0));
+
+
+	const unsigned char* p = data;
+	const unsigned char* end = p + length;
+
+	state->totalLength += length;
+
+	// Complete a previously started block first
+	if (state->pendingLength > 0)
+	{
+		size_t missing = 64 - state->pendingLength;
+
+		if (length < missing)
+		{
+			memcpy(state->pending + state->pendingLength, p, length);
+			state->pendingLength += length;
+
+			return;
+		}
+
+		memcpy(state->pending + state->pendingLength, p, missing);
+		ProcessSha256Block(state->words, state->pending);
+
+		p += missing;
+		state->pendingLength = 0;
+	}
+
+	// Process all complete blocks directly from the input
+	while (end - p >= 64)
+	{
+		ProcessSha256Block(state->words, p);
+		p += 64;
+	}
+
+	// Keep the remainder for the next call
+	memcpy(state->pending, p, end - p);
+	state->pendingLength = end - p;
+}
+
+/// Finishes an incremental SHA-256 computation.
+/// \param state The state of the computation. It must not be updated afterwards.
+/// \param digest The array in which to store the digest of all data passed to Sha256Update().
+void Sha256Final(struct Sha256State* state, unsigned char digest[SHA256_DIGEST_SIZE])
+{
+	assert(state != NULL);
+	assert(digest != NULL);
+
+
+	uint64_t bitLength = state->totalLength * 8;
+
+	// Append the terminating 1 bit and pad with zeros up to the length field
+	state->pending[state->pendingLength++] = 0x80;
+
+	if (state->pendingLength > 56)
+	{
+		memset(state->pending + state->pendingLength, 0, 64 - state->pendingLength);
+		ProcessSha256Block(state->words, state->pending);
+		state->pendingLength = 0;
+	}
+
+	memset(state->pending + state->pendingLength, 0, 56 - state->pendingLength);
+
+	for (int i = 0; i < 8; i++)
+		state->pending[56 + i] = (unsigned char) (bitLength >> (56 - i * 8));
+
+	ProcessSha256Block(state->words, state->pending);
+
+	for (int i = 0; i < 8; i++)
+	{
+		digest[i * 4] = (unsigned char) (state->words[i] >> 24);
+		digest[i * 4 + 1] = (unsigned char) (state->words[i] >> 16);
+		digest[i * 4 + 2] = (unsigned char) (state->words[i] >> 8);
+		digest[i * 4 + 3] = (unsigned char) state->words[i];
+	}
+}
@@ -0,0 +1,61 @@
+/// \file hash.h
+/// Hash functions used to compare and fingerprint file contents.
+
+
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+/// The state of an incremental 64 bit hash computation. The result is identical to hashing all data at once with Hash64().
+struct Hash64State
+{
+	/// The four accumulators processing interleaved 8 byte lanes of each 32 byte stripe.
+	uint64_t accumulators[4];
+
+	/// The seed the computation was started with.
+	uint64_t seed;
+
+	/// The total number of bytes hashed so far.
+	uint64_t totalLength;
+
+	/// The bytes of an incomplete stripe that have not been processed yet.
+	unsigned char pending[32];
+
+	/// The number of valid bytes in \p pending.
+	size_t pendingLength;
+};
+
+/// The number of bytes in a SHA-256 digest.
+#define SHA256_DIGEST_SIZE 32
+
+/// The state of an incremental SHA-256 computation.
+struct Sha256State
+{
+	/// The eight 32 bit words of the intermediate hash value.
+	uint32_t words[8];
+
+	/// The total number of bytes hashed so far.
+	uint64_t totalLength;
+
+	/// The bytes of an incomplete 64 byte block that have not been processed yet.
+	unsigned char pending[64];
+
+	/// The number of valid bytes in \p pending.
+	size_t pendingLength;
+};
+
+void Hash64Init(struct Hash64State* state, uint64_t seed);
+void Hash64Update(struct Hash64State* state, const void* data, size_t length);
+uint64_t Hash64Final(struct Hash64State* state);
+uint64_t Hash64(const void* data, size_t length, uint64_t seed);
+
+void Sha256Init(struct Sha256State* state);
+void Sha256Update(struct Sha256State* state, const void* data, size_t length);
+void Sha256Final(struct Sha256State* state, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+#endif
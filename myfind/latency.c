@@ -0,0 +1,269 @@
+/// \file latency.c
+/// Per-directory latency measurements, reported with "-D latency".
+///
+/// The histogram records small values exactly and larger values in
+/// logarithmic buckets that are each split into LATENCY_SUB_BUCKETS linear
+/// sub-buckets, so that recording is a few bit operations and the memory use
+/// is fixed regardless of the range of values.
+
+
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+#include "latency.h"
+
+
+
+/// Determines the histogram bucket for the provided value.
+static size_t GetLatencyBucket(uint64_t value)
+{
+	if (value < LATENCY_LINEAR_BUCKETS)
+		return (size_t) value;
+
+	// Shift the value so that its most significant bit lands on the highest sub-bucket bit
+	int shift = 63 - __builtin_clzll(value) - 6;
+
+	return LATENCY_LINEAR_BUCKETS + (shift - 1) * LATENCY_SUB_BUCKETS + ((value >> shift) - LATENCY_SUB_BUCKETS);
+}
+
+/// Determines the smallest value that is recorded in the provided histogram bucket.
+static uint64_t GetLatencyBucketValue(size_t bucket)
+{
+	if (bucket < LATENCY_LINEAR_BUCKETS)
+		return bucket;
+
+	size_t offset = bucket - LATENCY_LINEAR_BUCKETS;
+	int shift = (int) (offset / LATENCY_SUB_BUCKETS) + 1;
+
+	return (uint64_t) (LATENCY_SUB_BUCKETS + offset % LATENCY_SUB_BUCKETS) << shift;
+}
+
+/// Adds a value to a histogram.
+/// \param histogram The histogram to update.
+/// \param value The value to record.
+void RecordLatency(struct LatencyHistogram* histogram, uint64_t value)
+{
+	assert(histogram != NULL);
+
+
+	histogram->counts[GetLatencyBucket(value)]++;
+	histogram->count++;
+	histogram->total += value;
+
+	if (value > histogram->maximum)
+		histogram->maximum = value;
+}
+
+/// Determines the value below which the specified percentage of the recorded values lie.
+/// \param histogram The histogram to evaluate.
+/// \param percentile The percentage of values, between 0 and 100.
+/// \return The lower bound of the bucket containing the percentile, or zero if no values were recorded.
+uint64_t GetLatencyPercentile(struct LatencyHistogram* histogram, double percentile)
+{
+	assert(histogram != NULL);
+
+
+	if (histogram->count == 0)
+		return 0;
+
+	// The rank of the value to find, counting from one
+	unsigned long long rank = (unsigned long long) (percentile / 100.0 * histogram->count + 0.5);
+
+	if (rank < 1)
+		rank = 1;
+
+	unsigned long long seen = 0;
+
+	for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		seen += histogram->counts[i];
+
+		if (seen >= rank)
+			return GetLatencyBucketValue(i);
+	}
+
+	return histogram->maximum;
+}
+
+/// Creates an empty latency report.
+/// \param slowestCapacity The number of slowest directories to keep.
+/// \return The created report, which needs to be released with FreeLatencyReport(), or NULL if the memory could not be allocated.
+struct LatencyReport* CreateLatencyReport(size_t slowestCapacity)
+{
+	struct LatencyReport* report = calloc(1, sizeof(struct LatencyReport));
+
+	if (report == NULL)
+		return NULL;
+
+	report->slowestCapacity = slowestCapacity;
+	report->slowest = calloc(slowestCapacity + 1, sizeof(struct SlowDirectory));
+
+	if (report->slowest == NULL)
+	{
+		free(report);
+
+		return NULL;
+	}
+
+	return report;
+}
+
+/// Frees the provided latency report.
+/// \param report The report to free. May be NULL.
+void FreeLatencyReport(struct LatencyReport* report)
+{
+	if (report == NULL)
+		return;
+
+	for (size_t i = 0; i < report->slowestCount; i++)
+		free(report->slowest[i].path);
+
+	free(report->slowest);
+	free(report);
+}
+
+/// Restores the heap order of the slowest directories after the root has been replaced.
+static void SiftDownSlowest(struct LatencyReport* report)
+{
+	struct SlowDirectory* heap = report->slowest;
+	size_t i = 0;
+
+	while (true)
+	{
+		size_t smallest = i;
+		size_t left = i * 2 + 1;
+		size_t right = i * 2 + 2;
+
+		if ((left < report->slowestCount) && (heap[left].totalNanoseconds < heap[smallest].totalNanoseconds))
+			smallest = left;
+
+		if ((right < report->slowestCount) && (heap[right].totalNanoseconds < heap[smallest].totalNanoseconds))
+			smallest = right;
+
+		if (smallest == i)
+			break;
+
+		struct SlowDirectory swap = heap[i];
+		heap[i] = heap[smallest];
+		heap[smallest] = swap;
+
+		i = smallest;
+	}
+}
+
+/// Records the time spent on a single directory.
+/// \param report The report to update.
+/// \param path The path of the directory. It is only copied if the directory is among the slowest ones.
+/// \param timing The time spent on the directory.
+void RecordDirectoryTiming(struct LatencyReport* report, char* path, struct DirectoryTiming* timing)
+{
+	assert(report != NULL);
+	assert(path != NULL);
+	assert(timing != NULL);
+
+
+	uint64_t total = timing->openNanoseconds + timing->readNanoseconds + timing->statNanoseconds;
+
+	RecordLatency(&report->directories, total);
+
+	if (report->slowestCapacity == 0)
+		return;
+
+	// Once the heap is full, only directories slower than the fastest kept one get in
+	if ((report->slowestCount == report->slowestCapacity) && (total <= report->slowest[0].totalNanoseconds))
+		return;
+
+	char* pathCopy = strdup(path);
+
+	if (pathCopy == NULL)
+		return;
+
+	struct SlowDirectory* heap = report->slowest;
+
+	if (report->slowestCount < report->slowestCapacity)
+	{
+		// Insert at the bottom and sift up
+		size_t i = report->slowestCount++;
+
+		while ((i > 0) && (heap[(i - 1) / 2].totalNanoseconds > total))
+		{
+			heap[i] = heap[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+
+		heap[i].path = pathCopy;
+		heap[i].timing = *timing;
+		heap[i].totalNanoseconds = total;
+	}
+	else
+	{
+		// Replace the fastest kept directory
+		free(heap[0].path);
+
+		heap[0].path = pathCopy;
+		heap[0].timing = *timing;
+		heap[0].totalNanoseconds = total;
+
+		SiftDownSlowest(report);
+	}
+}
+
+/// Orders slow directories by descending total time. Used with qsort().
+static int CompareSlowDirectories(const void* a, const void* b)
+{
+	const struct SlowDirectory* directoryA = a;
+	const struct SlowDirectory* directoryB = b;
+
+	return (directoryA->totalNanoseconds < directoryB->totalNanoseconds) - (directoryA->totalNanoseconds > directoryB->totalNanoseconds);
+}
+
+/// Prints the latency distribution and the slowest directories.
+/// \param report The report to print. The list of slowest directories is reordered.
+/// \param stream The stream to print to.
+void PrintLatencyReport(struct LatencyReport* report, FILE* stream)
+{
+	assert(report != NULL);
+	assert(stream != NULL);
+
+
+	struct LatencyHistogram* histogram = &report->directories;
+
+	fprintf(stream, "myfind directory latency (opendir + readdir + lstat of entries):\n");
+	fprintf(stream, "  directories            %llu\n", histogram->count);
+	fprintf(stream, "  total                  %.3f ms\n", histogram->total / 1e6);
+
+	if (histogram->count > 0)
+	{
+		fprintf(stream, "  mean                   %.3f ms\n", (double) histogram->total / histogram->count / 1e6);
+		fprintf(stream, "  p50                    %.3f ms\n", GetLatencyPercentile(histogram, 50.0) / 1e6);
+		fprintf(stream, "  p90                    %.3f ms\n", GetLatencyPercentile(histogram, 90.0) / 1e6);
+		fprintf(stream, "  p99                    %.3f ms\n", GetLatencyPercentile(histogram, 99.0) / 1e6);
+		fprintf(stream, "  p99.9                  %.3f ms\n", GetLatencyPercentile(histogram, 99.9) / 1e6);
+		fprintf(stream, "  max                    %.3f ms\n", histogram->maximum / 1e6);
+	}
+
+	if (report->slowestCount == 0)
+		return;
+
+	// The heap property is no longer needed; Sort for printing
+	qsort(report->slowest, report->slowestCount, sizeof(struct SlowDirectory), CompareSlowDirectories);
+
+	fprintf(stream, "slowest directories:\n");
+	fprintf(stream, "  %10s %10s %10s %10s %10s  %s\n", "total ms", "open ms", "read ms", "stat ms", "entries", "path");
+
+	for (size_t i = 0; i < report->slowestCount; i++)
+	{
+		struct SlowDirectory* directory = &report->slowest[i];
+
+		fprintf(stream, "  %10.3f %10.3f %10.3f %10.3f %10zu  %s\n",
+			directory->totalNanoseconds / 1e6,
+			directory->timing.openNanoseconds / 1e6,
+			directory->timing.readNanoseconds / 1e6,
+			directory->timing.statNanoseconds / 1e6,
+			directory->timing.entryCount,
+			directory->path);
+	}
+}
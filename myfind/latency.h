@@ -0,0 +1,108 @@
+/// \file latency.h
+/// Per-directory latency measurements, reported with "-D latency".
+
+
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+
+
+/// The number of values recorded exactly before the histogram switches to logarithmic buckets.
+#define LATENCY_LINEAR_BUCKETS 128
+
+/// The number of buckets per power of two above LATENCY_LINEAR_BUCKETS. Limits the relative error of any recorded value to 1/64.
+#define LATENCY_SUB_BUCKETS 64
+
+/// The total number of buckets, sufficient for any 64 bit value.
+#define LATENCY_BUCKETS (LATENCY_LINEAR_BUCKETS + 57 * LATENCY_SUB_BUCKETS)
+
+/// The number of slowest directories listed if no other number was specified.
+#define LATENCY_DEFAULT_SLOWEST 10
+
+/// A histogram with a bounded relative error, in the style of HdrHistogram.
+struct LatencyHistogram
+{
+	/// The number of recorded values per bucket.
+	unsigned long long counts[LATENCY_BUCKETS];
+
+	/// The total number of recorded values.
+	unsigned long long count;
+
+	/// The sum of all recorded values.
+	unsigned long long total;
+
+	/// The largest recorded value.
+	unsigned long long maximum;
+};
+
+/// The time spent on the file system calls needed to process a single directory.
+struct DirectoryTiming
+{
+	/// The nanoseconds spent in opendir().
+	uint64_t openNanoseconds;
+
+	/// The nanoseconds spent in readdir() and closedir().
+	uint64_t readNanoseconds;
+
+	/// The nanoseconds spent in lstat() for the entries of the directory.
+	uint64_t statNanoseconds;
+
+	/// The number of entries in the directory.
+	size_t entryCount;
+};
+
+/// A directory whose processing took particularly long.
+struct SlowDirectory
+{
+	/// The path of the directory.
+	char* path;
+
+	/// The time spent on the directory.
+	struct DirectoryTiming timing;
+
+	/// The sum of all times in \p timing.
+	uint64_t totalNanoseconds;
+};
+
+/// The latency measurements of all directories.
+struct LatencyReport
+{
+	/// The distribution of the total time spent per directory.
+	struct LatencyHistogram directories;
+
+	/// A min-heap of the slowest directories, ordered by their total time.
+	struct SlowDirectory* slowest;
+
+	/// The number of used elements in \p slowest.
+	size_t slowestCount;
+
+	/// The maximum number of directories kept in \p slowest.
+	size_t slowestCapacity;
+};
+
+/// Gets the current value of the monotonic clock.
+/// \return The current time in nanoseconds.
+static inline uint64_t GetMonotonicNanoseconds()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+void RecordLatency(struct LatencyHistogram* histogram, uint64_t value);
+uint64_t GetLatencyPercentile(struct LatencyHistogram* histogram, double percentile);
+
+struct LatencyReport* CreateLatencyReport(size_t slowestCapacity);
+void FreeLatencyReport(struct LatencyReport* report);
+void RecordDirectoryTiming(struct LatencyReport* report, char* path, struct DirectoryTiming* timing);
+void PrintLatencyReport(struct LatencyReport* report, FILE* stream);
+
+#endif
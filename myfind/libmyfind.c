@@ -0,0 +1,4084 @@
+/// \file libmyfind.c
+/// The directory walk of myfind as a library: Iterates over the files below a set of roots that match a query.
+///
+/// The walk keeps an explicit stack of directories instead of recursing, so that it
+/// can be suspended after every matching file and resumed by the next call. As
+/// before, all entries of a directory are read and the directory is closed before
+/// descending, so that deep trees do not run into the open file limit. Paths are
+/// built in a single buffer that only grows with the depth of the tree.
+///
+/// Queries are compiled once into an immutable list of predicates, so that a
+/// service can run the same query against many roots, also concurrently, without
+/// parsing the expression or resolving user and group names again.
+///
+/// The lstat() calls of a huge directory dominate the walk. With stat threads,
+/// the entries of a large directory are split into fixed-size chunks once it has
+/// been read, and any idle thread claims the next chunk, so that the work stays
+/// balanced however the entries are distributed over the directories.
+
+
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+#include <errno.h>
+#include <libgen.h>
+#include <pwd.h>
+#include <grp.h>
+#include <assert.h>
+#include <dirent.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/sysmacros.h>
+
+#include "libmyfind.h"
+#include "stats.h"
+#include "latency.h"
+#include "perf.h"
+#include "progress.h"
+#include "guard.h"
+#include "fstype.h"
+#include "dfa.h"
+#include "fold.h"
+#include "exclude.h"
+#include "gitignore.h"
+
+
+
+/// The initial size of the path buffer of an iterator.
+#define FIND_INITIAL_PATH_SIZE 4096
+
+/// The initial number of directory levels for which an iterator allocates state.
+#define FIND_INITIAL_DEPTH 16
+
+/// The size of the buffer first tried for the user and group database lookups of "-nouser" and "-nogroup".
+#define FIND_NSS_BUFFER_SIZE 1024
+
+/// The number of entries of a large directory that are tested as one chunk, see find_set_stat_threads(). Directories with more entries are split.
+#define FIND_CHUNK_ENTRIES 1024
+
+/// The number of chunks per stat thread whose results may be kept ahead of the walk.
+#define FIND_CHUNKS_PER_THREAD 4
+
+/// Contains flags indicating the file types to be printed in the application's output.
+enum FileTypes
+{
+	/// No filtering by file type.
+	None = 0,
+
+	/// Block special files should be printed.
+	BlockSpecialFile = 1 << 0,
+	/// Character special files should be printed.
+	CharacterSpecialFile = 1 << 1,
+	/// Directories should be printed.
+	Directory = 1 << 2,
+	/// Named pipes should be printed.
+	NamedPipe = 1 << 3,
+	/// Regular files should be printed.
+	RegularFile = 1 << 4,
+	/// Symbolic links should be printed.
+	SymbolicLink = 1 << 5,
+	/// Sockets should be printed.
+	Socket = 1 << 6,
+};
+
+/// The kinds of tests a query can apply to a file.
+enum FindPredicateKind
+{
+	/// The file is of one of the types in \p fileTypes.
+	FindPredicateType,
+	/// The file belongs to the user with the ID \p id.
+	FindPredicateUser,
+	/// The file does not belong to any known user.
+	FindPredicateNoUser,
+	/// The file belongs to the group with the ID \p id.
+	FindPredicateGroup,
+	/// The file does not belong to any known group.
+	FindPredicateNoGroup,
+	/// The name of the file matches \p pattern, in any case if \p ignoreCase is set.
+	FindPredicateName,
+	/// The whole path of the file matches \p pattern, in any case if \p ignoreCase is set.
+	FindPredicatePath,
+	/// The whole path of the file matches the regular expression \p regex.
+	FindPredicateRegex,
+	/// The inode number of the file compares to \p number as specified by \p comparison.
+	FindPredicateInode,
+	/// The file is on the device \p device. Created for "-samefile", together with a FindPredicateInode for the file's inode number.
+	FindPredicateDevice,
+	/// The number of hard links of the file compares to \p number as specified by \p comparison.
+	FindPredicateLinks,
+};
+
+/// The ways numeric tests compare a property of a file with their number, written as "+n", "-n" and "n".
+enum FindComparison
+{
+	/// The property equals the number.
+	FindEqual,
+	/// The property is less than the number.
+	FindLess,
+	/// The property is greater than the number.
+	FindGreater,
+};
+
+/// The ways a pattern can be matched, from the cheapest to the most general one.
+enum FindPatternKind
+{
+	/// The pattern does not contain any special characters and only matches itself.
+	FindPatternLiteral,
+	/// The pattern is an asterisk followed by a literal, which only has to be compared with the end of the string.
+	FindPatternSuffix,
+	/// Any other pattern, which is matched with fnmatch().
+	FindPatternGlob,
+};
+
+/// The description of a predicate as it is written on the command line.
+struct FindPredicateSyntax
+{
+	/// The name of the predicate, including the leading dash.
+	const char* name;
+
+	/// The number of arguments following the name.
+	int arguments;
+
+	/// The test applied by the predicate.
+	enum FindPredicateKind kind;
+
+	/// The relative cost of the test. Cheaper tests are applied first, so that most files are rejected cheaply.
+	int cost;
+
+	/// The STATX_* fields of the file information the test needs.
+	unsigned int statFields;
+
+	/// Indicates whether patterns and regular expressions match letters in any case.
+	bool ignoreCase;
+};
+
+/// The predicates known to find_compile().
+static const struct FindPredicateSyntax FindPredicates[] =
+{
+	{ "-type", 1, FindPredicateType, 0, STATX_TYPE, false },
+	{ "-user", 1, FindPredicateUser, 0, STATX_UID, false },
+	{ "-group", 1, FindPredicateGroup, 0, STATX_GID, false },
+	{ "-name", 1, FindPredicateName, 1, 0, false },
+	{ "-iname", 1, FindPredicateName, 1, 0, true },
+	{ "-path", 1, FindPredicatePath, 2, 0, false },
+	{ "-ipath", 1, FindPredicatePath, 2, 0, true },
+	{ "-nouser", 0, FindPredicateNoUser, 3, STATX_UID, false },
+	{ "-nogroup", 0, FindPredicateNoGroup, 3, STATX_GID, false },
+	{ "-regex", 1, FindPredicateRegex, 2, 0, false },
+	{ "-iregex", 1, FindPredicateRegex, 2, 0, true },
+	{ "-inum", 1, FindPredicateInode, 0, 0, false },
+	{ "-samefile", 1, FindPredicateDevice, 0, STATX_INO, false },
+	{ "-links", 1, FindPredicateLinks, 0, STATX_NLINK, false },
+};
+
+/// A single compiled test of a query.
+struct FindPredicate
+{
+	/// The test to apply.
+	enum FindPredicateKind kind;
+
+	/// The relative cost of the test, copied from its syntax.
+	int cost;
+
+	/// Indicates whether the test needs the file information from lstat(). The other tests are applied before it is read, so that most files they reject are never stat'ed.
+	bool needsStat;
+
+	/// The file types to accept. Only valid for FindPredicateType.
+	enum FileTypes fileTypes;
+
+	/// The user or group ID to accept. Only valid for FindPredicateUser and FindPredicateGroup.
+	unsigned int id;
+
+	/// The pattern to match, owned by the predicate. Folded to lowercase if \p foldString is set. Only valid for FindPredicateName and FindPredicatePath.
+	char* pattern;
+
+	/// The part of \p pattern compared by literal and suffix patterns. For suffix patterns, the leading asterisk is skipped.
+	const char* literal;
+
+	/// The number of characters in \p literal.
+	size_t patternLength;
+
+	/// How \p pattern is matched.
+	enum FindPatternKind patternKind;
+
+	/// The flags passed to fnmatch() for glob patterns.
+	int patternFlags;
+
+	/// Indicates whether the name or path is folded to lowercase before it is compared with \p pattern, for "-iname" and "-ipath".
+	bool foldString;
+
+	/// The compiled regular expression, owned by the predicate. Only valid for FindPredicateRegex.
+	struct RegexProgram* regex;
+
+	/// The index of the matcher of \p regex in the match cache of each thread. Only valid for FindPredicateRegex.
+	size_t regexIndex;
+
+	/// How the property of the file is compared with \p number. Only valid for FindPredicateInode and FindPredicateLinks.
+	enum FindComparison comparison;
+
+	/// The inode number or number of links to compare with. Only valid for FindPredicateInode and FindPredicateLinks.
+	unsigned long long number;
+
+	/// The device to accept. Only valid for FindPredicateDevice.
+	dev_t device;
+};
+
+/// A compiled query. It is never modified after find_compile() returns, so that any number of walks can use it concurrently.
+struct FindQuery
+{
+	/// The predicates that all have to be fulfilled: Those that do not need the file information first, then the others, each ordered by their cost.
+	struct FindPredicate* predicates;
+
+	/// The number of entries in \p predicates.
+	size_t predicateCount;
+
+	/// The time at which the query was compiled, against which relative times are evaluated in every execution.
+	time_t referenceTime;
+
+	/// The STATX_* fields of the file information needed by the predicates.
+	unsigned int statFields;
+
+	/// The number of predicates with a regular expression.
+	size_t regexCount;
+};
+
+/// The state a thread keeps between the files it tests: The results of the last user and group lookups for "-nouser" and "-nogroup" and the DFAs of the regular expressions. Each thread testing files has its own.
+struct FindMatchCache
+{
+	/// Indicates whether \p userID and \p userExists are valid.
+	bool hasUser;
+
+	/// The ID of the user looked up last.
+	uid_t userID;
+
+	/// Indicates whether the user with the ID \p userID exists.
+	bool userExists;
+
+	/// Indicates whether \p groupID and \p groupExists are valid.
+	bool hasGroup;
+
+	/// The ID of the group looked up last.
+	gid_t groupID;
+
+	/// Indicates whether the group with the ID \p groupID exists.
+	bool groupExists;
+
+	/// The matchers of the regular expressions of the query, by their \p regexIndex. NULL until the first regular expression is matched.
+	struct RegexMatcher** regexMatchers;
+
+	/// The number of entries in \p regexMatchers.
+	size_t regexMatcherCount;
+
+	/// The lowercase form of the name or path being matched by "-iname" or "-ipath".
+	char* folded;
+
+	/// The number of bytes allocated for \p folded.
+	size_t foldedCapacity;
+};
+
+/// Files excluded from a walk together with everything below them, see find_load_exclusions(). Never modified while walks use them, so that any number of walks can share them.
+struct FindExclusions
+{
+	/// The excluded names and path prefixes.
+	struct ExcludeSet* set;
+
+	/// The excluded glob patterns: FindPredicateName for patterns matched against names, FindPredicatePath for patterns containing a slash.
+	struct FindPredicate* globs;
+
+	/// The number of entries in \p globs.
+	size_t globCount;
+
+	/// The number of entries allocated for \p globs.
+	size_t globCapacity;
+
+	/// Indicates whether any of \p globs is matched against whole paths, which then have to be built for every entry.
+	bool hasPathGlobs;
+};
+
+/// A name read from a directory.
+struct FindName
+{
+	/// The offset of the name in the \p names buffer of the directory.
+	size_t offset;
+
+	/// The type of the file as reported by readdir(). DT_UNKNOWN if the file system does not report types.
+	unsigned char type;
+
+	/// The inode number of the file as reported by readdir(), with which "-inum" and "-samefile" are decided without calling lstat().
+	ino_t inode;
+};
+
+/// A directory on the stack of an iterator, whose entries are being visited.
+struct FindDirectory
+{
+	/// The names of all entries, each followed by a terminator.
+	char* names;
+
+	/// The number of bytes used in \p names.
+	size_t namesSize;
+
+	/// The number of bytes allocated for \p names.
+	size_t namesCapacity;
+
+	/// The entries read from the directory, in the order returned by readdir().
+	struct FindName* entries;
+
+	/// The number of entries in \p entries.
+	size_t entryCount;
+
+	/// The number of entries allocated for \p entries.
+	size_t entryCapacity;
+
+	/// The index of the next entry to visit.
+	size_t nextEntry;
+
+	/// The index of the first entry not yet considered for reading ahead, see find_set_prefetch().
+	size_t prefetchEntry;
+
+	/// The number of characters of the directory's path in the path buffer of the iterator.
+	size_t pathLength;
+
+	/// The time spent on the file system calls for this directory, if requested.
+	struct DirectoryTiming timing;
+
+	/// The chunks of the entries if the directory is large enough to have them tested by the stat threads, see find_set_stat_threads(). Allocated on first use and reused afterwards.
+	struct FindChunkedDirectory* chunked;
+
+	/// Indicates whether the subdirectories may be read ahead, as chosen for the directory's file system.
+	bool readAhead;
+
+	/// Indicates whether the entries may be tested by the stat threads, as chosen for the directory's file system.
+	bool useStatThreads;
+
+	/// The node of the directory's path in the prefix trie of the exclusions. EXCLUDE_NONE if no excluded prefix continues below it.
+	int excludeNode;
+
+	/// The compiled rules of the directory's .gitignore file, see find_set_gitignore(). NULL if it has none. Freed when the directory is popped.
+	struct IgnoreRules* ignoreRules;
+
+	/// The position on the stack, counted from one, of the nearest parent directory with .gitignore rules. Zero if no parent has any.
+	size_t ignoreParent;
+};
+
+/// An lstat() call performed on a helper thread, see find_set_call_timeout().
+struct FindStatRequest
+{
+	/// The path of the file, owned by the request.
+	char* path;
+
+	/// The number of bytes allocated for \p path.
+	size_t pathCapacity;
+
+	/// The STATX_* fields to ask the file system for.
+	unsigned int fields;
+
+	/// The AT_STATX_* flags of the call.
+	int flags;
+
+	/// Receives the information of the file.
+	struct stat info;
+
+	/// The result of lstat().
+	int result;
+
+	/// The error code of lstat() if \p result is -1.
+	int error;
+};
+
+/// A statfs() call determining the type of a file system, performed on a helper thread, see find_set_call_timeout().
+struct FindFileSystemRequest
+{
+	/// The path of a directory on the file system, owned by the request.
+	char* path;
+
+	/// The number of bytes allocated for \p path.
+	size_t pathCapacity;
+
+	/// Receives the type of the file system.
+	struct FileSystemType type;
+};
+
+/// The reading of a whole directory performed on a helper thread, see find_set_call_timeout().
+struct FindReadRequest
+{
+	/// The path of the directory, owned by the request.
+	char* path;
+
+	/// The number of bytes allocated for \p path.
+	size_t pathCapacity;
+
+	/// Receives the entries of the directory. Its buffers are exchanged with those of the directory on the stack, so that the entries need not be copied.
+	struct FindDirectory directory;
+
+	/// Indicates whether the directory could be opened.
+	bool opened;
+
+	/// The call that has failed, e.g. "Reading", as used in the error message. NULL if all calls have succeeded.
+	const char* failedCall;
+
+	/// The error code of \p failedCall.
+	int error;
+
+	/// The number of entries returned by readdir(), including "." and "..".
+	unsigned long long entriesRead;
+};
+
+/// The states of a slot of the prefetch thread.
+enum FindPrefetchState
+{
+	/// The slot is not in use.
+	FindPrefetchFree,
+
+	/// The directory waits to be read by the prefetch thread.
+	FindPrefetchQueued,
+
+	/// The directory is being read by the prefetch thread.
+	FindPrefetchReading,
+
+	/// The directory has been read and waits for the walk to reach it.
+	FindPrefetchDone,
+};
+
+/// A directory read ahead of the walk, see find_set_prefetch().
+struct FindPrefetchSlot
+{
+	/// The state of the slot. The prefetch thread only changes queued slots; The walk owns free and finished slots.
+	enum FindPrefetchState state;
+
+	/// The order in which the slot has been queued. The oldest queued slot is read first.
+	unsigned long long sequence;
+
+	/// The path and the entries of the directory. Allocated on first use and reused afterwards.
+	struct FindReadRequest* request;
+};
+
+/// A thread that reads the upcoming directories of a walk ahead of it.
+struct FindPrefetcher
+{
+	/// Protects the states of the slots and \p stopping.
+	pthread_mutex_t lock;
+
+	/// Signalled when a directory has been queued or the thread should exit.
+	pthread_cond_t queued;
+
+	/// Signalled when the thread has finished reading a directory.
+	pthread_cond_t finished;
+
+	/// Indicates whether the thread should exit.
+	bool stopping;
+
+	/// The prefetch thread.
+	pthread_t thread;
+
+	/// The directories being read ahead.
+	struct FindPrefetchSlot* slots;
+
+	/// The number of elements in \p slots.
+	size_t slotCount;
+
+	/// The sequence number of the next queued slot.
+	unsigned long long nextSequence;
+};
+
+/// The outcome of lstat() and of the query for an entry of a chunked directory.
+struct FindChunkResult
+{
+	/// The information of the file as returned by lstat().
+	struct stat info;
+
+	/// The error code of lstat(). Zero if the call has succeeded.
+	int error;
+
+	/// Indicates whether the file matches the query.
+	bool matches;
+};
+
+/// The states of a chunk of a large directory.
+enum FindChunkState
+{
+	/// The slot does not hold a chunk.
+	FindChunkFree,
+
+	/// The entries of the chunk are being tested by a thread.
+	FindChunkClaimed,
+
+	/// The entries of the chunk have been tested and wait for the walk to reach them.
+	FindChunkDone,
+};
+
+/// A slot holding the results of one chunk of a large directory.
+struct FindChunkSlot
+{
+	/// The state of the slot. The thread that has claimed the chunk owns the results until the slot is done.
+	enum FindChunkState state;
+
+	/// The index of the chunk in the directory.
+	size_t chunk;
+
+	/// The results of the entries of the chunk, FIND_CHUNK_ENTRIES of them.
+	struct FindChunkResult* results;
+
+	/// The time spent on the lstat() calls of the chunk, if measured.
+	uint64_t statNanoseconds;
+};
+
+/// A large directory whose entries are tested in chunks, which any stat thread and the walk itself can claim.
+struct FindChunkedDirectory
+{
+	/// The path of the directory, owned by the chunked directory, as the walk overwrites its own path buffer.
+	char* path;
+
+	/// The number of bytes allocated for \p path.
+	size_t pathCapacity;
+
+	/// The number of characters in \p path.
+	size_t pathLength;
+
+	/// The names of the entries, owned by the directory on the stack of the walk.
+	const char* names;
+
+	/// The entries of the directory, owned by the directory on the stack of the walk.
+	const struct FindName* entries;
+
+	/// The number of entries in \p entries.
+	size_t entryCount;
+
+	/// The number of chunks the entries are split into.
+	size_t chunkCount;
+
+	/// The index of the next chunk that has not been claimed by any thread.
+	size_t nextChunk;
+
+	/// The index of the chunk the walk is visiting. The results of up to \p slotCount chunks from here on may be kept.
+	size_t firstChunk;
+
+	/// The results of the chunks being tested or waiting for the walk. Chunk n uses slot n modulo \p slotCount.
+	struct FindChunkSlot* slots;
+
+	/// The number of elements in \p slots.
+	size_t slotCount;
+
+	/// Indicates whether the time spent on the lstat() calls is measured.
+	bool timed;
+
+	/// The STATX_* fields to ask the file system for.
+	unsigned int statFields;
+
+	/// The AT_STATX_* flags of the calls.
+	int statFlags;
+
+	/// Indicates whether the directory is on the list of its pool.
+	bool active;
+
+	/// The next directory on the list of the pool.
+	struct FindChunkedDirectory* next;
+};
+
+/// The state a thread needs to test the entries of a chunk.
+struct FindChunkScratch
+{
+	/// The path of the entry being tested.
+	char* path;
+
+	/// The number of bytes allocated for \p path.
+	size_t pathCapacity;
+
+	/// The lookup results and regular expression matchers of the thread.
+	struct FindMatchCache cache;
+};
+
+/// A stat thread of a chunk pool.
+struct FindChunkWorker
+{
+	/// The thread.
+	pthread_t thread;
+
+	/// The pool the thread belongs to.
+	struct FindChunkPool* pool;
+
+	/// The number of chunks tested by the thread.
+	unsigned long long chunks;
+
+	/// The number of entries tested by the thread.
+	unsigned long long entries;
+};
+
+/// The threads testing the entries of large directories in chunks, see find_set_stat_threads().
+struct FindChunkPool
+{
+	/// Protects the states of the slots, the chunk indexes of the directories, the list of directories and \p stopping.
+	pthread_mutex_t lock;
+
+	/// Signalled when a chunk can be claimed or the threads should exit.
+	pthread_cond_t queued;
+
+	/// Signalled when a thread has finished testing a chunk.
+	pthread_cond_t finished;
+
+	/// Indicates whether the threads should exit.
+	bool stopping;
+
+	/// The query the entries are tested against.
+	const struct FindQuery* query;
+
+	/// The chunked directories on the stack of the walk, the deepest one first, as the walk needs its chunks first.
+	struct FindChunkedDirectory* directories;
+
+	/// The stat threads.
+	struct FindChunkWorker* workers;
+
+	/// The number of started threads in \p workers.
+	unsigned int threadCount;
+
+	/// The number of slots of each chunked directory.
+	size_t slotCount;
+
+	/// The number of directories that have been split into chunks.
+	unsigned long long directoryCount;
+
+	/// The number of chunks tested by the walk itself.
+	unsigned long long walkChunks;
+
+	/// The number of entries tested by the walk itself.
+	unsigned long long walkEntries;
+
+	/// The scratch state of the walk for the chunks it tests itself.
+	struct FindChunkScratch walkScratch;
+};
+
+/// A file system the walk has entered and the way it is walked, see find_set_strategy().
+struct FindFileSystem
+{
+	/// The device ID of the file system.
+	dev_t device;
+
+	/// The type of the file system.
+	struct FileSystemType type;
+
+	/// Indicates whether the subdirectories of its directories are read ahead.
+	bool readAhead;
+
+	/// Indicates whether the entries of its large directories are tested by the stat threads.
+	bool useStatThreads;
+
+	/// Indicates whether the file system has not answered in time when its type was queried. Its directories are skipped together with everything below them.
+	bool unresponsive;
+};
+
+/// The state of a walk over the files below a set of roots.
+struct FindIterator
+{
+	/// The criteria by which the returned files are selected. Shared with other walks; Only the iterator's own members may be modified.
+	const struct FindQuery* query;
+
+	/// The paths to start the walk at. The last element of the array is NULL.
+	char* const* roots;
+
+	/// The index of the next root to visit.
+	size_t nextRoot;
+
+	/// The path of the current entry. The directories on the stack use its leading part.
+	char* path;
+
+	/// The number of bytes allocated for \p path.
+	size_t pathCapacity;
+
+	/// The stack of directories whose entries are being visited. The state of popped directories is kept to reuse its allocations.
+	struct FindDirectory* directories;
+
+	/// The number of directories on the stack.
+	size_t depth;
+
+	/// The number of directories allocated for \p directories.
+	size_t directoryCapacity;
+
+	/// Indicates whether the entry visited last is a directory to be read before visiting any other entry.
+	bool descend;
+
+	/// Indicates whether the walk has been cancelled with find_cancel(), possibly by another thread.
+	atomic_bool cancelled;
+
+	/// A copy of the current root, from which the name of the root is taken.
+	char* rootName;
+
+	/// The entry returned to the caller.
+	struct FindEntry entry;
+
+	/// The diagnostics to collect.
+	struct FindDiagnostics diagnostics;
+
+	/// The counters of \p diagnostics.progress, cached to keep their increments cheap. NULL if no progress is reported.
+	struct ProgressCounters* progressCounters;
+
+	/// The lookup results and regular expression matchers of the walk itself.
+	struct FindMatchCache cache;
+
+	/// The helper threads performing the file system calls with a timeout. NULL if the calls are made directly.
+	struct CallGuard* guard;
+
+	/// The request reused for the next guarded lstat() call. NULL if none is allocated.
+	struct FindStatRequest* statRequest;
+
+	/// The request reused for the next guarded directory read. NULL if none is allocated.
+	struct FindReadRequest* readRequest;
+
+	/// The thread reading the upcoming directories ahead of the walk. NULL if directories are only read when the walk reaches them.
+	struct FindPrefetcher* prefetcher;
+
+	/// The threads testing the entries of large directories. NULL if all entries are tested by the walk one after the other.
+	struct FindChunkPool* chunkPool;
+
+	/// The STATX_* fields to ask the file system for, see find_set_stat_fields().
+	unsigned int statFields;
+
+	/// The AT_STATX_* flags of the calls, see find_set_stat_fields().
+	int statFlags;
+
+	/// How the helper threads are chosen for each file system.
+	enum FindStrategy strategy;
+
+	/// Indicates whether the caller has started the prefetch thread with find_set_prefetch(), so that it is used on all file systems, whatever the strategy.
+	bool fixedPrefetch;
+
+	/// Indicates whether the caller has started the stat threads with find_set_stat_threads(), so that they are used on all file systems, whatever the strategy.
+	bool fixedStatThreads;
+
+	/// The file systems the walk has entered, in the order they were entered. Only used if the strategy is automatic or reported.
+	struct FindFileSystem* fileSystems;
+
+	/// The number of elements in \p fileSystems.
+	size_t fileSystemCount;
+
+	/// The number of elements allocated for \p fileSystems.
+	size_t fileSystemCapacity;
+
+	/// The files to skip together with everything below them. NULL if none are excluded.
+	const struct FindExclusions* exclusions;
+
+	/// The node of the current root's path in the prefix trie of \p exclusions.
+	int rootExcludeNode;
+
+	/// Indicates whether the files ignored by the .gitignore files of the walked directories are skipped, see find_set_gitignore().
+	bool respectGitignore;
+};
+
+
+
+/// Makes sure that the path buffer of an iterator can hold a path of the specified length.
+/// \param iterator The iterator whose path buffer to enlarge.
+/// \param length The number of characters of the path, without the terminator.
+static void ReservePath(struct FindIterator* iterator, size_t length)
+{
+	if (length < iterator->pathCapacity)
+		return;
+
+	size_t capacity = iterator->pathCapacity * 2;
+
+	while (capacity <= length)
+		capacity *= 2;
+
+	char* path = realloc(iterator->path, capacity);
+
+	ThreadStats.allocations++;
+
+	if (path == NULL)
+	{
+		// Out of memory
+		exit(-1);
+	}
+
+	iterator->path = path;
+	iterator->pathCapacity = capacity;
+}
+
+/// Adds a name read from a directory to the directory's entries.
+/// \param directory The directory the name was read from.
+/// \param name The name of the entry.
+/// \param type The type of the entry as reported by readdir().
+/// \param inode The inode number of the entry as reported by readdir().
+static void AddDirectoryEntry(struct FindDirectory* directory, const char* name, unsigned char type, ino_t inode)
+{
+	size_t length = strlen(name);
+
+	if (directory->namesSize + length + 1 > directory->namesCapacity)
+	{
+		size_t capacity = (directory->namesCapacity > 0) ? directory->namesCapacity * 2 : 1024;
+
+		while (capacity < directory->namesSize + length + 1)
+			capacity *= 2;
+
+		char* names = realloc(directory->names, capacity);
+
+		ThreadStats.allocations++;
+
+		if (names == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		directory->names = names;
+		directory->namesCapacity = capacity;
+	}
+
+	if (directory->entryCount == directory->entryCapacity)
+	{
+		size_t capacity = (directory->entryCapacity > 0) ? directory->entryCapacity * 2 : 64;
+		struct FindName* entries = realloc(directory->entries, capacity * sizeof(struct FindName));
+
+		ThreadStats.allocations++;
+
+		if (entries == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		directory->entries = entries;
+		directory->entryCapacity = capacity;
+	}
+
+	memcpy(directory->names + directory->namesSize, name, length + 1);
+
+	directory->entries[directory->entryCount].offset = directory->namesSize;
+	directory->entries[directory->entryCount].type = type;
+	directory->entries[directory->entryCount].inode = inode;
+	directory->entryCount++;
+
+	directory->namesSize += length + 1;
+}
+
+/// Parses the string that specifies the file types to be printed.
+/// \param fileTypeChars The array of characters representing the file types to be printed.
+/// \param fileTypes A pointer to the enumeration value in which to store the parsed information.
+/// \return true if all file type characters could be parsed successfully. Otherwise, false.
+static bool ParseFileTypes(char* fileTypeChars, enum FileTypes* fileTypes)
+{
+	assert(fileTypeChars != NULL);
+	assert(fileTypes != NULL);
+
+
+	// Assume no file type by default
+	*fileTypes = None;
+
+	// Loop through the individual characters in the string
+	for (size_t i = 0; i < strlen(fileTypeChars); i++)
+	{
+		switch (fileTypeChars[i])
+		{
+		case 'b':
+			*fileTypes |= BlockSpecialFile;
+			break;
+
+		case 'c':
+			*fileTypes |= CharacterSpecialFile;
+			break;
+
+		case 'd':
+			*fileTypes |= Directory;
+			break;
+
+		case 'p':
+			*fileTypes |= NamedPipe;
+			break;
+
+		case 'f':
+			*fileTypes |= RegularFile;
+			break;
+
+		case 'l':
+			*fileTypes |= SymbolicLink;
+			break;
+
+		case 's':
+			*fileTypes |= Socket;
+			break;
+
+		default:
+			// Invalid character
+			return false;
+		}
+	}
+
+	// All characters could be parsed successfully
+	return true;
+}
+
+
+/// Converts the provided string to an integer.
+/// \param s The string to convert to an integer.
+/// \param i A pointer to the integer value in which to store the converted string.
+/// \return true if the string could successfully be converted to an integer value. Otherwise, false.
+static bool ConvertToInteger(char* s, int* i)
+{
+	struct passwd *p;
+	struct passwd *pw;
+	unsigned int uid;
+	
+	pw = getpwnam(s);
+	
+	if (pw != NULL) 
+	{
+		return false;
+	}
+	else if (uid = strtol(s, &s, 10))
+	{
+		p = getpwuid(uid);
+			
+		if (p != NULL) 
+		{
+			*i = p->pw_uid;
+			return true;
+		}
+		
+		else
+		{
+			return false;
+		}
+	}
+	else
+	{
+		return false;
+	}
+		
+}
+
+/// Converts the provided string to an integer.
+/// \param s The string to convert to an integer.
+/// \param i A pointer to the integer value in which to store the converted string.
+/// \return true if the string could successfully be converted to an integer value. Otherwise, false.
+static bool ConvertToIntegerGroup(char* s, int* i)
+{
+	struct group *g;
+	struct group *gw;
+	unsigned int gid;
+
+	gw = getgrnam(s);
+
+	if (gw != NULL)
+	{
+		return false;
+	}
+	else if (gid = strtol(s, &s, 10))
+	{
+		g = getgrgid(gid);
+
+		if (g != NULL)
+		{
+			*i = g->gr_gid;
+			return true;
+		}
+
+		else
+		{
+			return false;
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+}
+
+/// Queries the user ID of the user with the specified name.
+/// \param userName The name of the user for which to get the ID.
+/// \param userID A pointer to the integer value in which to store the queries user ID.
+/// \return true if the user ID could be queried successfully. Otherwise, false.
+static bool QueryUserID(char* userName, int* userID)
+{
+	struct passwd *p;
+	p = getpwnam(userName);
+	
+	if (p != NULL)
+	{
+		*userID = p->pw_uid;
+		return true;
+	}
+	
+	else
+	{
+		return false;
+	}
+
+}
+/// Queries the group ID of the group with the specified name.
+/// \param groupName The name of the group for which to get the ID.
+/// \param gruopID A pointer to the integer value in which to store the queries group ID.
+/// \return true if the group ID could be queried successfully. Otherwise, false.
+static bool QueryGroupID(char* groupName, int* groupID)
+{
+	struct group *g;
+	g = getgrnam(groupName);
+
+	if (g != NULL)
+	{
+		*groupID = g->gr_gid;
+		return true;
+	}
+
+	else
+	{
+		return false;
+	}
+
+}
+
+/// Parses the argument of a numeric test like "-links 2", which may be preceded by "+" for "more than" or "-" for "less than".
+/// \param argument The argument to parse.
+/// \param comparison Receives how the property of a file is compared with the number.
+/// \param number Receives the number.
+/// \return true if the argument is a valid number. Otherwise, false.
+static bool ParseComparison(const char* argument, enum FindComparison* comparison, unsigned long long* number)
+{
+	*comparison = FindEqual;
+
+	if (*argument == '+')
+	{
+		*comparison = FindGreater;
+		argument++;
+	}
+	else if (*argument == '-')
+	{
+		*comparison = FindLess;
+		argument++;
+	}
+
+	// strtoull() would accept leading spaces and signs as well
+	if ((*argument < '0') || (*argument > '9'))
+		return false;
+
+	char* end;
+
+	errno = 0;
+	*number = strtoull(argument, &end, 10);
+
+	return (*end == '\0') && (errno == 0);
+}
+
+/// Looks up the syntax of a predicate.
+/// \param name The name of the predicate, including the leading dash.
+/// \return The syntax of the predicate, or NULL if there is no predicate with that name.
+static const struct FindPredicateSyntax* LookUpPredicate(const char* name)
+{
+	for (size_t i = 0; i < sizeof(FindPredicates) / sizeof(FindPredicates[0]); i++)
+	{
+		if (strcmp(FindPredicates[i].name, name) == 0)
+			return &FindPredicates[i];
+	}
+
+	return NULL;
+}
+
+/// Stores a copy of a pattern in a predicate together with the cheapest way to match it.
+/// \param predicate The predicate to store the pattern in.
+/// \param pattern The pattern as specified by the user.
+/// \param ignoreCase Indicates whether letters match in any case.
+/// \return true if the pattern could be copied. false if out of memory.
+static bool CompilePattern(struct FindPredicate* predicate, const char* pattern, bool ignoreCase)
+{
+	predicate->pattern = strdup(pattern);
+
+	if (predicate->pattern == NULL)
+		return false;
+
+	predicate->literal = predicate->pattern;
+	predicate->patternFlags = 0;
+	predicate->foldString = false;
+
+	if (ignoreCase)
+	{
+		// Fold the pattern once, so that the folded strings can be compared like any other. Bracket expressions could
+		// contain ranges like "[A-z]", whose meaning changes when folded; Those patterns are left to fnmatch() entirely.
+		predicate->foldString = FoldAscii(pattern, strlen(pattern), predicate->pattern) && (strchr(pattern, '[') == NULL);
+
+		if (!predicate->foldString)
+		{
+			strcpy(predicate->pattern, pattern);
+			predicate->patternFlags = FNM_CASEFOLD;
+			predicate->patternKind = FindPatternGlob;
+
+			return true;
+		}
+	}
+
+	if (strpbrk(pattern, "*?[\\") == NULL)
+	{
+		// A pattern without any special characters can only match itself
+		predicate->patternKind = FindPatternLiteral;
+	}
+	else if ((pattern[0] == '*') && (strpbrk(pattern + 1, "*?[\\") == NULL))
+	{
+		// A single leading asterisk followed by a literal is a suffix comparison
+		predicate->patternKind = FindPatternSuffix;
+		predicate->literal++;
+	}
+	else
+	{
+		predicate->patternKind = FindPatternGlob;
+	}
+
+	predicate->patternLength = strlen(predicate->literal);
+
+	return true;
+}
+
+/// Determines whether a string matches the pattern of a predicate, like fnmatch() without any flags.
+/// \param predicate The predicate containing the pattern.
+/// \param string The string to match.
+/// \param length The number of characters in \p string.
+/// \return true if the string matches the pattern. Otherwise, false.
+static bool MatchesPattern(const struct FindPredicate* predicate, const char* string, size_t length)
+{
+	switch (predicate->patternKind)
+	{
+	case FindPatternLiteral:
+		return (length == predicate->patternLength) && (memcmp(string, predicate->literal, length) == 0);
+
+	case FindPatternSuffix:
+		// Without FNM_PERIOD, the asterisk matches a leading period as well
+		return (length >= predicate->patternLength) && (memcmp(string + length - predicate->patternLength, predicate->literal, predicate->patternLength) == 0);
+
+	default:
+		return fnmatch(predicate->pattern, string, predicate->patternFlags) == 0;
+	}
+}
+
+/// Determines whether a string matches the pattern of a predicate, folding the string first for "-iname" and "-ipath".
+/// \param predicate The predicate containing the pattern.
+/// \param cache The match cache of the calling thread, which holds the folded string.
+/// \param string The string to match.
+/// \param length The number of characters in \p string.
+/// \return true if the string matches the pattern. Otherwise, false.
+static bool MatchesFoldedPattern(const struct FindPredicate* predicate, struct FindMatchCache* cache, const char* string, size_t length)
+{
+	if (!predicate->foldString)
+		return MatchesPattern(predicate, string, length);
+
+	if (length >= cache->foldedCapacity)
+	{
+		size_t capacity = (cache->foldedCapacity > 0) ? cache->foldedCapacity : FIND_INITIAL_PATH_SIZE;
+
+		while (capacity <= length)
+			capacity *= 2;
+
+		char* folded = realloc(cache->folded, capacity);
+
+		if (folded == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		cache->folded = folded;
+		cache->foldedCapacity = capacity;
+	}
+
+	if (!FoldAscii(string, length, cache->folded))
+	{
+		// The case of other characters depends on the locale, which only fnmatch() knows; The pattern itself is ASCII
+		return fnmatch(predicate->pattern, string, FNM_CASEFOLD) == 0;
+	}
+
+	cache->folded[length] = '\0';
+
+	return MatchesPattern(predicate, cache->folded, length);
+}
+
+/// Determines whether a user with the specified ID exists. The result of the last lookup is cached, as most files in a tree belong to the same few users.
+/// \param cache The cache of the calling thread.
+/// \param userID The ID of the user.
+/// \return true if the user exists. Otherwise, false.
+static bool UserExists(struct FindMatchCache* cache, uid_t userID)
+{
+	if (cache->hasUser && (cache->userID == userID))
+		return cache->userExists;
+
+	struct passwd user;
+	struct passwd* result = NULL;
+	size_t bufferSize = FIND_NSS_BUFFER_SIZE;
+	char* buffer = NULL;
+	int error;
+
+	// Unlike getpwuid(), the reentrant variant can be used by concurrent walks
+	do
+	{
+		free(buffer);
+		buffer = malloc(bufferSize);
+
+		if (buffer == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		error = getpwuid_r(userID, &user, buffer, bufferSize, &result);
+		bufferSize *= 2;
+	} while (error == ERANGE);
+
+	free(buffer);
+
+	cache->hasUser = true;
+	cache->userID = userID;
+	cache->userExists = (result != NULL);
+
+	return cache->userExists;
+}
+
+/// Determines whether a group with the specified ID exists. The result of the last lookup is cached, as most files in a tree belong to the same few groups.
+/// \param cache The cache of the calling thread.
+/// \param groupID The ID of the group.
+/// \return true if the group exists. Otherwise, false.
+static bool GroupExists(struct FindMatchCache* cache, gid_t groupID)
+{
+	if (cache->hasGroup && (cache->groupID == groupID))
+		return cache->groupExists;
+
+	struct group group;
+	struct group* result = NULL;
+	size_t bufferSize = FIND_NSS_BUFFER_SIZE;
+	char* buffer = NULL;
+	int error;
+
+	// Groups with many members need a larger buffer; Retry until it fits
+	do
+	{
+		free(buffer);
+		buffer = malloc(bufferSize);
+
+		if (buffer == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		error = getgrgid_r(groupID, &group, buffer, bufferSize, &result);
+		bufferSize *= 2;
+	} while (error == ERANGE);
+
+	free(buffer);
+
+	cache->hasGroup = true;
+	cache->groupID = groupID;
+	cache->groupExists = (result != NULL);
+
+	return cache->groupExists;
+}
+
+/// Gets the matcher of the calling thread for the regular expression of a predicate, creating it on first use.
+/// \param cache The match cache of the calling thread.
+/// \param predicate The predicate with the regular expression.
+/// \return The matcher.
+static struct RegexMatcher* GetRegexMatcher(struct FindMatchCache* cache, const struct FindPredicate* predicate)
+{
+	if (predicate->regexIndex >= cache->regexMatcherCount)
+	{
+		struct RegexMatcher** matchers = realloc(cache->regexMatchers, (predicate->regexIndex + 1) * sizeof(struct RegexMatcher*));
+
+		if (matchers == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		for (size_t i = cache->regexMatcherCount; i <= predicate->regexIndex; i++)
+			matchers[i] = NULL;
+
+		cache->regexMatchers = matchers;
+		cache->regexMatcherCount = predicate->regexIndex + 1;
+	}
+
+	// The DFA states are built while matching, so each thread needs its own
+	if (cache->regexMatchers[predicate->regexIndex] == NULL)
+	{
+		cache->regexMatchers[predicate->regexIndex] = CreateRegexMatcher(predicate->regex);
+
+		if (cache->regexMatchers[predicate->regexIndex] == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+	}
+
+	return cache->regexMatchers[predicate->regexIndex];
+}
+
+/// Frees the regular expression matchers and the folding buffer of a match cache.
+/// \param cache The match cache.
+static void FreeMatchCache(struct FindMatchCache* cache)
+{
+	for (size_t i = 0; i < cache->regexMatcherCount; i++)
+		FreeRegexMatcher(cache->regexMatchers[i]);
+
+	free(cache->regexMatchers);
+	cache->regexMatchers = NULL;
+	cache->regexMatcherCount = 0;
+
+	free(cache->folded);
+	cache->folded = NULL;
+	cache->foldedCapacity = 0;
+}
+
+/// Compares a property of a file with the number of a numeric test.
+/// \param predicate The numeric test.
+/// \param value The property of the file.
+/// \return true if the property compares to the number as the test specifies. Otherwise, false.
+static bool CompareNumber(const struct FindPredicate* predicate, unsigned long long value)
+{
+	switch (predicate->comparison)
+	{
+	case FindLess:
+		return value < predicate->number;
+
+	case FindGreater:
+		return value > predicate->number;
+
+	default:
+		return value == predicate->number;
+	}
+}
+
+/// Determines whether a file fulfills a single predicate.
+/// \param predicate The predicate to apply.
+/// \param cache The match cache of the calling thread.
+/// \param entry The file to check.
+/// \return true if the file fulfills the predicate. Otherwise, false.
+static bool MatchesPredicate(const struct FindPredicate* predicate, struct FindMatchCache* cache, const struct FindEntry* entry)
+{
+	const struct stat* fileInformation = &entry->info;
+
+	switch (predicate->kind)
+	{
+	case FindPredicateType:
+		return
+			(S_ISBLK(fileInformation->st_mode) && (predicate->fileTypes & BlockSpecialFile)) ||
+			(S_ISCHR(fileInformation->st_mode) && (predicate->fileTypes & CharacterSpecialFile)) ||
+			(S_ISDIR(fileInformation->st_mode) && (predicate->fileTypes & Directory)) ||
+			(S_ISFIFO(fileInformation->st_mode) && (predicate->fileTypes & NamedPipe)) ||
+			(S_ISREG(fileInformation->st_mode) && (predicate->fileTypes & RegularFile)) ||
+			(S_ISLNK(fileInformation->st_mode) && (predicate->fileTypes & SymbolicLink)) ||
+			(S_ISSOCK(fileInformation->st_mode) && (predicate->fileTypes & Socket));
+
+	case FindPredicateUser:
+		return (unsigned int) fileInformation->st_uid == predicate->id;
+
+	case FindPredicateNoUser:
+		return !UserExists(cache, fileInformation->st_uid);
+
+	case FindPredicateGroup:
+		return (unsigned int) fileInformation->st_gid == predicate->id;
+
+	case FindPredicateNoGroup:
+		return !GroupExists(cache, fileInformation->st_gid);
+
+	case FindPredicateName:
+		return MatchesFoldedPattern(predicate, cache, entry->name, strlen(entry->name));
+
+	case FindPredicatePath:
+		return MatchesFoldedPattern(predicate, cache, entry->path, entry->pathLength);
+
+	case FindPredicateRegex:
+		return MatchRegex(GetRegexMatcher(cache, predicate), entry->path, entry->pathLength);
+
+	case FindPredicateInode:
+		return CompareNumber(predicate, fileInformation->st_ino);
+
+	case FindPredicateDevice:
+		return fileInformation->st_dev == predicate->device;
+
+	case FindPredicateLinks:
+		return CompareNumber(predicate, fileInformation->st_nlink);
+	}
+
+	return false;
+}
+
+/// Determines whether a file matches a query.
+/// \param query The query to apply.
+/// \param cache The match cache of the calling thread.
+/// \param entry The file to check.
+/// \return true if the file fulfills all predicates of the query. Otherwise, false.
+static bool MatchesQuery(const struct FindQuery* query, struct FindMatchCache* cache, const struct FindEntry* entry)
+{
+	for (size_t i = 0; i < query->predicateCount; i++)
+	{
+		if (!MatchesPredicate(&query->predicates[i], cache, entry))
+			return false;
+	}
+
+	return true;
+}
+
+/// Applies the predicates of a query that do not need the file information, before lstat() is called.
+/// The inode tests are applied separately, as the inode number from the directory entry is only final if the file is not stat'ed:
+/// At mount points, readdir() reports the inode of the directory below the mount rather than the one lstat() returns.
+/// \param query The query to apply.
+/// \param cache The match cache of the calling thread.
+/// \param entry The file to check. Only the path, the name and the inode number in \p info need to be valid.
+/// \param inodeTests true to apply the inode tests only. false to apply the other predicates only.
+/// \return true if the file fulfills these predicates. false if it cannot match the query.
+static bool MatchesQueryBeforeStat(const struct FindQuery* query, struct FindMatchCache* cache, const struct FindEntry* entry, bool inodeTests)
+{
+	for (size_t i = 0; (i < query->predicateCount) && !query->predicates[i].needsStat; i++)
+	{
+		const struct FindPredicate* predicate = &query->predicates[i];
+
+		if (((predicate->kind == FindPredicateInode) == inodeTests) && !MatchesPredicate(predicate, cache, entry))
+			return false;
+	}
+
+	return true;
+}
+
+/// Applies the predicates of a query that need the file information, after lstat() has been called for a file that MatchesQueryBeforeStat() has not excluded.
+/// The inode tests are applied again, to the inode number returned by lstat().
+/// \param query The query to apply.
+/// \param cache The match cache of the calling thread.
+/// \param entry The file to check.
+/// \return true if the file fulfills these predicates. Otherwise, false.
+static bool MatchesQueryAfterStat(const struct FindQuery* query, struct FindMatchCache* cache, const struct FindEntry* entry)
+{
+	for (size_t i = 0; i < query->predicateCount; i++)
+	{
+		const struct FindPredicate* predicate = &query->predicates[i];
+
+		if ((predicate->needsStat || (predicate->kind == FindPredicateInode)) && !MatchesPredicate(predicate, cache, entry))
+			return false;
+	}
+
+	return true;
+}
+
+/// Determines whether the lstat() call for an entry can be skipped, because the predicates that do not need the file information have rejected it.
+/// Directories are always stat'ed, as the walk needs their device to descend into them.
+/// \param name The entry as read from its directory.
+/// \param info Receives the file type and inode number from the directory entry if the call can be skipped.
+/// \return true if the call can be skipped. Otherwise, false.
+static bool SkipStat(const struct FindName* name, struct stat* info)
+{
+	if ((name->type == DT_UNKNOWN) || (name->type == DT_DIR))
+		return false;
+
+	memset(info, 0, sizeof(*info));
+
+	info->st_mode = DTTOIF(name->type);
+	info->st_ino = name->inode;
+
+	ThreadStats.statsSkipped++;
+
+	return true;
+}
+
+/// Copies a path into the buffer of a request, growing the buffer as needed.
+/// \param path The buffer of the request.
+/// \param capacity The number of bytes allocated for \p path.
+/// \param directory The path to copy, or the path of the directory containing \p name.
+/// \param directoryLength The number of characters of \p directory to copy.
+/// \param name The name to append to \p directory, taking care of duplicated slashes. NULL to copy \p directory only.
+static void SetRequestPath(char** path, size_t* capacity, const char* directory, size_t directoryLength, const char* name)
+{
+	bool needsSeparator = (name != NULL) && (directoryLength > 0) && (directory[directoryLength - 1] != '/');
+	size_t nameLength = (name != NULL) ? strlen(name) : 0;
+	size_t length = directoryLength + needsSeparator + nameLength;
+
+	if (length >= *capacity)
+	{
+		size_t newCapacity = (*capacity > 0) ? *capacity : FIND_INITIAL_PATH_SIZE;
+
+		while (newCapacity <= length)
+			newCapacity *= 2;
+
+		char* newPath = realloc(*path, newCapacity);
+
+		ThreadStats.allocations++;
+
+		if (newPath == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		*path = newPath;
+		*capacity = newCapacity;
+	}
+
+	memcpy(*path, directory, directoryLength);
+
+	if (needsSeparator)
+		(*path)[directoryLength] = '/';
+
+	memcpy(*path + directoryLength + needsSeparator, (name != NULL) ? name : "", nameLength + 1);
+}
+
+/// Reads the information of a file without following symbolic links like lstat(), but only asks the file system for the specified fields.
+/// On network file systems, every field that is not needed can save the revalidation of the file's attributes with the server.
+/// \param path The path of the file.
+/// \param fields The STATX_* fields needed. The file type is always included.
+/// \param flags Additional AT_STATX_* flags, e.g. AT_STATX_DONT_SYNC to accept cached attributes.
+/// \param info Receives the information of the file. The members the file system has not returned are zero, except for st_dev, st_rdev and st_blksize.
+/// \return Zero on success. -1 if the call has failed, with errno set.
+static int StatFile(const char* path, unsigned int fields, int flags, struct stat* info)
+{
+	struct statx extended;
+
+	if (statx(AT_FDCWD, path, AT_SYMLINK_NOFOLLOW | flags, fields | STATX_TYPE, &extended) == -1)
+	{
+		// Kernels before 4.11 do not have statx(); Fetch everything as before
+		if (errno == ENOSYS)
+			return lstat(path, info);
+
+		return -1;
+	}
+
+	unsigned int mask = extended.stx_mask;
+
+	memset(info, 0, sizeof(*info));
+
+	info->st_dev = makedev(extended.stx_dev_major, extended.stx_dev_minor);
+	info->st_rdev = makedev(extended.stx_rdev_major, extended.stx_rdev_minor);
+	info->st_blksize = extended.stx_blksize;
+
+	// The permission bits and the type share st_mode, but are requested separately
+	if (mask & STATX_TYPE)
+		info->st_mode |= extended.stx_mode & S_IFMT;
+
+	if (mask & STATX_MODE)
+		info->st_mode |= extended.stx_mode & ~S_IFMT;
+
+	if (mask & STATX_INO)
+		info->st_ino = extended.stx_ino;
+
+	if (mask & STATX_NLINK)
+		info->st_nlink = extended.stx_nlink;
+
+	if (mask & STATX_UID)
+		info->st_uid = extended.stx_uid;
+
+	if (mask & STATX_GID)
+		info->st_gid = extended.stx_gid;
+
+	if (mask & STATX_SIZE)
+		info->st_size = extended.stx_size;
+
+	if (mask & STATX_BLOCKS)
+		info->st_blocks = extended.stx_blocks;
+
+	if (mask & STATX_ATIME)
+	{
+		info->st_atim.tv_sec = extended.stx_atime.tv_sec;
+		info->st_atim.tv_nsec = extended.stx_atime.tv_nsec;
+	}
+
+	if (mask & STATX_MTIME)
+	{
+		info->st_mtim.tv_sec = extended.stx_mtime.tv_sec;
+		info->st_mtim.tv_nsec = extended.stx_mtime.tv_nsec;
+	}
+
+	if (mask & STATX_CTIME)
+	{
+		info->st_ctim.tv_sec = extended.stx_ctime.tv_sec;
+		info->st_ctim.tv_nsec = extended.stx_ctime.tv_nsec;
+	}
+
+	return 0;
+}
+
+/// Performs the lstat() call of a request. Runs on a helper thread.
+/// \param argument The struct FindStatRequest to perform.
+static void PerformStatRequest(void* argument)
+{
+	struct FindStatRequest* request = argument;
+
+	request->result = StatFile(request->path, request->fields, request->flags, &request->info);
+	request->error = errno;
+}
+
+/// Frees a request for an lstat() call.
+/// \param argument The struct FindStatRequest to free. May be NULL.
+static void ReleaseStatRequest(void* argument)
+{
+	struct FindStatRequest* request = argument;
+
+	if (request == NULL)
+		return;
+
+	free(request->path);
+	free(request);
+}
+
+/// Determines the type of the file system of a request. Runs on a helper thread.
+/// \param argument The struct FindFileSystemRequest to perform.
+static void PerformFileSystemRequest(void* argument)
+{
+	struct FindFileSystemRequest* request = argument;
+
+	QueryFileSystem(request->path, &request->type);
+}
+
+/// Frees a request for the type of a file system.
+/// \param argument The struct FindFileSystemRequest to free. May be NULL.
+static void ReleaseFileSystemRequest(void* argument)
+{
+	struct FindFileSystemRequest* request = argument;
+
+	if (request == NULL)
+		return;
+
+	free(request->path);
+	free(request);
+}
+
+/// Reads all entries of the directory of a request. Runs on a helper thread, so nothing but the request may be used.
+/// \param argument The struct FindReadRequest to perform.
+static void PerformReadRequest(void* argument)
+{
+	struct FindReadRequest* request = argument;
+	DIR* pDir = opendir(request->path);
+
+	if (pDir == NULL)
+	{
+		request->failedCall = "Opening";
+		request->error = errno;
+
+		return;
+	}
+
+	request->opened = true;
+
+	struct dirent* directoryInfo;
+
+	while (true)
+	{
+		// Reset error for the subsequent library call
+		errno = 0;
+
+		directoryInfo = readdir(pDir);
+
+		if (directoryInfo == NULL)
+		{
+			// If no error value is set, it indicates that the end of the directory stream has been reached
+			if (errno != 0)
+			{
+				request->failedCall = "Reading";
+				request->error = errno;
+			}
+
+			break;
+		}
+
+		request->entriesRead++;
+
+		// Ignore the directory entries that represent the current and the parent directory
+		if ((strcmp(directoryInfo->d_name, ".") == 0) || (strcmp(directoryInfo->d_name, "..") == 0))
+			continue;
+
+		AddDirectoryEntry(&request->directory, directoryInfo->d_name, directoryInfo->d_type, directoryInfo->d_ino);
+	}
+
+	if (closedir(pDir) == -1)
+	{
+		request->failedCall = "Closing";
+		request->error = errno;
+
+		// Skip the entries, as without the helper thread
+		request->directory.entryCount = 0;
+	}
+}
+
+/// Frees a request for reading a directory, including the entry buffers it holds.
+/// \param argument The struct FindReadRequest to free. May be NULL.
+static void ReleaseReadRequest(void* argument)
+{
+	struct FindReadRequest* request = argument;
+
+	if (request == NULL)
+		return;
+
+	free(request->directory.names);
+	free(request->directory.entries);
+	free(request->path);
+	free(request);
+}
+
+/// Exchanges the entries, including their buffers, of two directories.
+/// \param a The first directory.
+/// \param b The second directory.
+static void SwapDirectoryEntries(struct FindDirectory* a, struct FindDirectory* b)
+{
+	struct FindDirectory copy = *a;
+
+	a->names = b->names;
+	a->namesSize = b->namesSize;
+	a->namesCapacity = b->namesCapacity;
+	a->entries = b->entries;
+	a->entryCount = b->entryCount;
+	a->entryCapacity = b->entryCapacity;
+
+	b->names = copy.names;
+	b->namesSize = copy.namesSize;
+	b->namesCapacity = copy.namesCapacity;
+	b->entries = copy.entries;
+	b->entryCount = copy.entryCount;
+	b->entryCapacity = copy.entryCapacity;
+}
+
+/// Reads the queued directories of a prefetcher, oldest first, until it is stopped. Runs on the prefetch thread.
+/// \param argument The struct FindPrefetcher to serve.
+/// \return Always NULL.
+static void* RunPrefetcher(void* argument)
+{
+	struct FindPrefetcher* prefetcher = argument;
+
+	pthread_mutex_lock(&prefetcher->lock);
+
+	while (!prefetcher->stopping)
+	{
+		struct FindPrefetchSlot* next = NULL;
+
+		for (size_t i = 0; i < prefetcher->slotCount; i++)
+		{
+			struct FindPrefetchSlot* slot = &prefetcher->slots[i];
+
+			if ((slot->state == FindPrefetchQueued) && ((next == NULL) || (slot->sequence < next->sequence)))
+				next = slot;
+		}
+
+		if (next == NULL)
+		{
+			pthread_cond_wait(&prefetcher->queued, &prefetcher->lock);
+
+			continue;
+		}
+
+		next->state = FindPrefetchReading;
+
+		pthread_mutex_unlock(&prefetcher->lock);
+		PerformReadRequest(next->request);
+		pthread_mutex_lock(&prefetcher->lock);
+
+		next->state = FindPrefetchDone;
+		pthread_cond_broadcast(&prefetcher->finished);
+	}
+
+	pthread_mutex_unlock(&prefetcher->lock);
+
+	MergeThreadStats();
+
+	return NULL;
+}
+
+/// Queues the subdirectories the walk is going to enter next on the free slots of its prefetcher.
+/// \param iterator The iterator whose upcoming directories to read ahead.
+static void RefillPrefetcher(struct FindIterator* iterator)
+{
+	struct FindPrefetcher* prefetcher = iterator->prefetcher;
+	size_t slotIndex = 0;
+	bool queued = false;
+
+	pthread_mutex_lock(&prefetcher->lock);
+
+	// The topmost directory is finished first, so its subdirectories are entered first
+	for (size_t i = iterator->depth; i > 0; i--)
+	{
+		struct FindDirectory* directory = &iterator->directories[i - 1];
+
+		// The entries the walk has passed are of no use any more
+		if (directory->prefetchEntry < directory->nextEntry)
+			directory->prefetchEntry = directory->nextEntry;
+
+		// Neither are the subdirectories on a file system that is not worth reading ahead
+		if (!directory->readAhead)
+			continue;
+
+		while (directory->prefetchEntry < directory->entryCount)
+		{
+			struct FindName* name = &directory->entries[directory->prefetchEntry];
+
+			// Without the type from readdir(), the walk reads the directories itself once lstat() has told them apart
+			if (name->type != DT_DIR)
+			{
+				directory->prefetchEntry++;
+
+				continue;
+			}
+
+			while ((slotIndex < prefetcher->slotCount) && (prefetcher->slots[slotIndex].state != FindPrefetchFree))
+				slotIndex++;
+
+			if (slotIndex == prefetcher->slotCount)
+				break;
+
+			struct FindPrefetchSlot* slot = &prefetcher->slots[slotIndex];
+			struct FindReadRequest* request = slot->request;
+
+			if (request == NULL)
+			{
+				request = calloc(1, sizeof(struct FindReadRequest));
+
+				ThreadStats.allocations++;
+
+				if (request == NULL)
+				{
+					// Out of memory
+					exit(-1);
+				}
+
+				slot->request = request;
+			}
+
+			// The directories on the stack share the leading part of the path buffer
+			SetRequestPath(&request->path, &request->pathCapacity, iterator->path, directory->pathLength, directory->names + name->offset);
+
+			request->opened = false;
+			request->failedCall = NULL;
+			request->entriesRead = 0;
+			request->directory.namesSize = 0;
+			request->directory.entryCount = 0;
+
+			slot->state = FindPrefetchQueued;
+			slot->sequence = prefetcher->nextSequence++;
+			queued = true;
+
+			directory->prefetchEntry++;
+		}
+
+		if (slotIndex == prefetcher->slotCount)
+			break;
+	}
+
+	if (queued)
+		pthread_cond_signal(&prefetcher->queued);
+
+	pthread_mutex_unlock(&prefetcher->lock);
+}
+
+/// Frees the slots of the directories below a directory the walk has left, e.g. because a subdirectory has turned out not to be one after all.
+/// \param iterator The iterator whose prefetcher to clean up.
+/// \param pathLength The number of characters of the directory's path in the path buffer of the iterator.
+static void DiscardPrefetched(struct FindIterator* iterator, size_t pathLength)
+{
+	struct FindPrefetcher* prefetcher = iterator->prefetcher;
+	bool needsSeparator = (pathLength > 0) && (iterator->path[pathLength - 1] != '/');
+
+	pthread_mutex_lock(&prefetcher->lock);
+
+	for (size_t i = 0; i < prefetcher->slotCount; i++)
+	{
+		struct FindPrefetchSlot* slot = &prefetcher->slots[i];
+
+		if (slot->state == FindPrefetchFree)
+			continue;
+
+		const char* path = slot->request->path;
+
+		if ((strncmp(path, iterator->path, pathLength) != 0) || (needsSeparator && (path[pathLength] != '/')))
+			continue;
+
+		// The prefetch thread owns the slot until it has finished reading
+		while (slot->state == FindPrefetchReading)
+			pthread_cond_wait(&prefetcher->finished, &prefetcher->lock);
+
+		slot->state = FindPrefetchFree;
+	}
+
+	pthread_mutex_unlock(&prefetcher->lock);
+}
+
+/// Creates a prefetcher and starts its thread.
+/// \param directories The number of directories to read ahead at most.
+/// \return The prefetcher, which needs to be released with FreePrefetcher(). NULL if the thread could not be started.
+static struct FindPrefetcher* StartPrefetcher(unsigned int directories)
+{
+	struct FindPrefetcher* prefetcher = calloc(1, sizeof(struct FindPrefetcher));
+
+	if (prefetcher == NULL)
+		return NULL;
+
+	prefetcher->slots = calloc(directories, sizeof(struct FindPrefetchSlot));
+	prefetcher->slotCount = directories;
+
+	if (prefetcher->slots == NULL)
+	{
+		free(prefetcher);
+
+		return NULL;
+	}
+
+	pthread_mutex_init(&prefetcher->lock, NULL);
+	pthread_cond_init(&prefetcher->queued, NULL);
+	pthread_cond_init(&prefetcher->finished, NULL);
+
+	if (pthread_create(&prefetcher->thread, NULL, RunPrefetcher, prefetcher) != 0)
+	{
+		pthread_cond_destroy(&prefetcher->queued);
+		pthread_cond_destroy(&prefetcher->finished);
+		pthread_mutex_destroy(&prefetcher->lock);
+		free(prefetcher->slots);
+		free(prefetcher);
+
+		return NULL;
+	}
+
+	return prefetcher;
+}
+
+/// Stops the prefetch thread and frees a prefetcher.
+/// \param prefetcher The prefetcher to free. May be NULL.
+static void FreePrefetcher(struct FindPrefetcher* prefetcher)
+{
+	if (prefetcher == NULL)
+		return;
+
+	pthread_mutex_lock(&prefetcher->lock);
+	prefetcher->stopping = true;
+	pthread_cond_signal(&prefetcher->queued);
+	pthread_mutex_unlock(&prefetcher->lock);
+
+	pthread_join(prefetcher->thread, NULL);
+
+	for (size_t i = 0; i < prefetcher->slotCount; i++)
+		ReleaseReadRequest(prefetcher->slots[i].request);
+
+	pthread_cond_destroy(&prefetcher->queued);
+	pthread_cond_destroy(&prefetcher->finished);
+	pthread_mutex_destroy(&prefetcher->lock);
+	free(prefetcher->slots);
+	free(prefetcher);
+}
+
+/// Tests the entries of a chunk of a large directory: Calls lstat() on each of them and applies the query. Runs on a stat thread or on the walk.
+/// \param pool The pool the directory belongs to.
+/// \param directory The chunked directory.
+/// \param slot The slot of the claimed chunk, which receives the results.
+/// \param scratch The scratch state of the calling thread.
+static void TestChunk(struct FindChunkPool* pool, struct FindChunkedDirectory* directory, struct FindChunkSlot* slot, struct FindChunkScratch* scratch)
+{
+	size_t first = slot->chunk * FIND_CHUNK_ENTRIES;
+	size_t last = (first + FIND_CHUNK_ENTRIES < directory->entryCount) ? first + FIND_CHUNK_ENTRIES : directory->entryCount;
+	uint64_t startTime = directory->timed ? GetMonotonicNanoseconds() : 0;
+
+	for (size_t i = first; i < last; i++)
+	{
+		const struct FindName* name = &directory->entries[i];
+		const char* fileName = directory->names + name->offset;
+		struct FindChunkResult* result = &slot->results[i - first];
+
+		SetRequestPath(&scratch->path, &scratch->pathCapacity, directory->path, directory->pathLength, fileName);
+
+		struct FindEntry entry;
+
+		entry.path = scratch->path;
+		entry.pathLength = strlen(scratch->path);
+		entry.name = scratch->path + entry.pathLength - strlen(fileName);
+		entry.info.st_ino = name->inode;
+
+		bool inodeMatches = MatchesQueryBeforeStat(pool->query, &scratch->cache, &entry, true);
+		bool candidate = inodeMatches && MatchesQueryBeforeStat(pool->query, &scratch->cache, &entry, false);
+
+		if (!candidate && SkipStat(name, &result->info))
+		{
+			result->error = 0;
+			result->matches = false;
+
+			continue;
+		}
+
+		ThreadStats.statCalls++;
+
+		if (StatFile(entry.path, directory->statFields, directory->statFlags, &entry.info) == -1)
+		{
+			result->error = errno;
+			result->matches = false;
+
+			continue;
+		}
+
+		result->info = entry.info;
+		result->error = 0;
+		result->matches = (inodeMatches ? candidate : MatchesQueryBeforeStat(pool->query, &scratch->cache, &entry, false)) &&
+			MatchesQueryAfterStat(pool->query, &scratch->cache, &entry);
+	}
+
+	slot->statNanoseconds = directory->timed ? GetMonotonicNanoseconds() - startTime : 0;
+}
+
+/// Finds the next chunk that can be claimed and claims it. Must be called with the lock of the pool held.
+/// \param pool The pool whose directories to search.
+/// \param directory Receives the directory of the claimed chunk.
+/// \return The slot of the claimed chunk. NULL if no chunk can be claimed.
+static struct FindChunkSlot* ClaimChunk(struct FindChunkPool* pool, struct FindChunkedDirectory** directory)
+{
+	for (struct FindChunkedDirectory* candidate = pool->directories; candidate != NULL; candidate = candidate->next)
+	{
+		// Only as many chunks as there are slots may be kept ahead of the walk
+		if ((candidate->nextChunk == candidate->chunkCount) || (candidate->nextChunk >= candidate->firstChunk + candidate->slotCount))
+			continue;
+
+		struct FindChunkSlot* slot = &candidate->slots[candidate->nextChunk % candidate->slotCount];
+
+		slot->state = FindChunkClaimed;
+		slot->chunk = candidate->nextChunk++;
+
+		*directory = candidate;
+
+		return slot;
+	}
+
+	return NULL;
+}
+
+/// Tests the chunks of the large directories of a pool until it is stopped. Runs on a stat thread.
+/// \param argument The struct FindChunkWorker to run.
+/// \return Always NULL.
+static void* RunChunkWorker(void* argument)
+{
+	struct FindChunkWorker* worker = argument;
+	struct FindChunkPool* pool = worker->pool;
+	struct FindChunkScratch scratch;
+
+	memset(&scratch, 0, sizeof(scratch));
+
+	pthread_mutex_lock(&pool->lock);
+
+	while (!pool->stopping)
+	{
+		struct FindChunkedDirectory* directory = NULL;
+		struct FindChunkSlot* slot = ClaimChunk(pool, &directory);
+
+		if (slot == NULL)
+		{
+			pthread_cond_wait(&pool->queued, &pool->lock);
+
+			continue;
+		}
+
+		pthread_mutex_unlock(&pool->lock);
+		TestChunk(pool, directory, slot, &scratch);
+		pthread_mutex_lock(&pool->lock);
+
+		slot->state = FindChunkDone;
+		worker->chunks++;
+		worker->entries += (slot->chunk + 1 < directory->chunkCount) ? FIND_CHUNK_ENTRIES : directory->entryCount - slot->chunk * FIND_CHUNK_ENTRIES;
+		pthread_cond_broadcast(&pool->finished);
+	}
+
+	pthread_mutex_unlock(&pool->lock);
+
+	free(scratch.path);
+	FreeMatchCache(&scratch.cache);
+
+	MergeThreadStats();
+
+	return NULL;
+}
+
+/// Splits the entries of the topmost directory on the stack of an iterator into chunks for the stat threads, if the directory is large enough.
+/// \param iterator The iterator that has just read the directory. Its path buffer still holds the directory's path.
+/// \param directory The directory on top of the stack.
+static void StartChunkedDirectory(struct FindIterator* iterator, struct FindDirectory* directory)
+{
+	struct FindChunkPool* pool = iterator->chunkPool;
+
+	// Smaller directories are not worth handing over
+	if (directory->entryCount <= FIND_CHUNK_ENTRIES)
+		return;
+
+	struct FindChunkedDirectory* chunked = directory->chunked;
+
+	if (chunked == NULL)
+	{
+		chunked = calloc(1, sizeof(struct FindChunkedDirectory));
+
+		ThreadStats.allocations++;
+
+		if (chunked == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		chunked->slotCount = pool->slotCount;
+		chunked->slots = calloc(chunked->slotCount, sizeof(struct FindChunkSlot));
+
+		if (chunked->slots == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		for (size_t i = 0; i < chunked->slotCount; i++)
+		{
+			chunked->slots[i].results = malloc(FIND_CHUNK_ENTRIES * sizeof(struct FindChunkResult));
+
+			if (chunked->slots[i].results == NULL)
+			{
+				// Out of memory
+				exit(-1);
+			}
+		}
+
+		directory->chunked = chunked;
+	}
+
+	SetRequestPath(&chunked->path, &chunked->pathCapacity, iterator->path, directory->pathLength, NULL);
+
+	chunked->pathLength = directory->pathLength;
+	chunked->names = directory->names;
+	chunked->entries = directory->entries;
+	chunked->entryCount = directory->entryCount;
+	chunked->chunkCount = (directory->entryCount + FIND_CHUNK_ENTRIES - 1) / FIND_CHUNK_ENTRIES;
+	chunked->nextChunk = 0;
+	chunked->firstChunk = 0;
+	chunked->timed = (iterator->diagnostics.latency != NULL);
+	chunked->statFields = iterator->statFields;
+	chunked->statFlags = iterator->statFlags;
+
+	pthread_mutex_lock(&pool->lock);
+
+	// The walk reaches the entries of the deepest directory first
+	chunked->active = true;
+	chunked->next = pool->directories;
+	pool->directories = chunked;
+	pool->directoryCount++;
+
+	pthread_cond_broadcast(&pool->queued);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/// Gets the result of an entry of a chunked directory, testing its chunk on the walk if no stat thread has claimed it yet.
+/// \param iterator The iterator visiting the entry.
+/// \param directory The chunked directory on top of the stack.
+/// \param index The index of the entry. The entries must be requested in order.
+/// \return The result of the entry, which remains valid until the walk continues with the next chunk.
+static const struct FindChunkResult* TakeChunkResult(struct FindIterator* iterator, struct FindDirectory* directory, size_t index)
+{
+	struct FindChunkPool* pool = iterator->chunkPool;
+	struct FindChunkedDirectory* chunked = directory->chunked;
+	size_t chunk = index / FIND_CHUNK_ENTRIES;
+	struct FindChunkSlot* slot = &chunked->slots[chunk % chunked->slotCount];
+
+	if (index % FIND_CHUNK_ENTRIES != 0)
+		return &slot->results[index % FIND_CHUNK_ENTRIES];
+
+	struct PerfCounters* perf = iterator->diagnostics.perf;
+
+	if (perf != NULL)
+		BeginPerfPhase(perf);
+
+	pthread_mutex_lock(&pool->lock);
+
+	// The results of the previous chunk are of no use any more; Its slot can take another chunk
+	if (chunk > 0)
+	{
+		chunked->slots[(chunk - 1) % chunked->slotCount].state = FindChunkFree;
+		chunked->firstChunk = chunk;
+
+		pthread_cond_broadcast(&pool->queued);
+	}
+
+	if (chunked->nextChunk == chunk)
+	{
+		// All stat threads are busy; Rather than waiting, test the chunk right away
+		slot->state = FindChunkClaimed;
+		slot->chunk = chunked->nextChunk++;
+
+		pthread_mutex_unlock(&pool->lock);
+		TestChunk(pool, chunked, slot, &pool->walkScratch);
+		pthread_mutex_lock(&pool->lock);
+
+		slot->state = FindChunkDone;
+		pool->walkChunks++;
+		pool->walkEntries += (chunk + 1 < chunked->chunkCount) ? FIND_CHUNK_ENTRIES : chunked->entryCount - chunk * FIND_CHUNK_ENTRIES;
+	}
+
+	while (slot->state != FindChunkDone)
+		pthread_cond_wait(&pool->finished, &pool->lock);
+
+	pthread_mutex_unlock(&pool->lock);
+
+	if (perf != NULL)
+		EndPerfPhase(perf, PerfPhaseStat);
+
+	// The time of the lstat() calls is accounted to the directory, wherever they were made
+	directory->timing.statNanoseconds += slot->statNanoseconds;
+
+	return &slot->results[0];
+}
+
+/// Takes a chunked directory the walk is leaving off the list of its pool, waiting for the chunks still being tested.
+/// \param iterator The iterator leaving the directory.
+/// \param chunked The chunked directory.
+static void EndChunkedDirectory(struct FindIterator* iterator, struct FindChunkedDirectory* chunked)
+{
+	struct FindChunkPool* pool = iterator->chunkPool;
+
+	pthread_mutex_lock(&pool->lock);
+
+	for (struct FindChunkedDirectory** link = &pool->directories; *link != NULL; link = &(*link)->next)
+	{
+		if (*link == chunked)
+		{
+			*link = chunked->next;
+
+			break;
+		}
+	}
+
+	// The threads testing a chunk own its slot until they have finished
+	for (size_t i = 0; i < chunked->slotCount; i++)
+	{
+		while (chunked->slots[i].state == FindChunkClaimed)
+			pthread_cond_wait(&pool->finished, &pool->lock);
+
+		chunked->slots[i].state = FindChunkFree;
+	}
+
+	chunked->active = false;
+
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/// Frees the chunks of a directory.
+/// \param chunked The chunked directory to free. May be NULL.
+static void FreeChunkedDirectory(struct FindChunkedDirectory* chunked)
+{
+	if (chunked == NULL)
+		return;
+
+	for (size_t i = 0; i < chunked->slotCount; i++)
+		free(chunked->slots[i].results);
+
+	free(chunked->slots);
+	free(chunked->path);
+	free(chunked);
+}
+
+/// Stops the stat threads, records the work done by each of them and frees a chunk pool.
+/// \param pool The pool to free. May be NULL.
+static void FreeChunkPool(struct FindChunkPool* pool)
+{
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stopping = true;
+	pthread_cond_broadcast(&pool->queued);
+	pthread_mutex_unlock(&pool->lock);
+
+	unsigned long long chunks[STATS_MAX_CHUNK_THREADS];
+	unsigned long long entries[STATS_MAX_CHUNK_THREADS];
+	unsigned int threadCount = 0;
+
+	chunks[threadCount] = pool->walkChunks;
+	entries[threadCount++] = pool->walkEntries;
+
+	for (unsigned int i = 0; i < pool->threadCount; i++)
+	{
+		pthread_join(pool->workers[i].thread, NULL);
+
+		if (threadCount < STATS_MAX_CHUNK_THREADS)
+		{
+			chunks[threadCount] = pool->workers[i].chunks;
+			entries[threadCount++] = pool->workers[i].entries;
+		}
+	}
+
+	if (pool->threadCount > 0)
+		RecordChunkWork(pool->directoryCount, threadCount, chunks, entries);
+
+	pthread_cond_destroy(&pool->queued);
+	pthread_cond_destroy(&pool->finished);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->walkScratch.path);
+	FreeMatchCache(&pool->walkScratch.cache);
+	free(pool->workers);
+	free(pool);
+}
+
+/// Creates a chunk pool and starts its stat threads.
+/// \param query The query the entries are tested against.
+/// \param threads The number of stat threads besides the walk.
+/// \return The pool, which needs to be released with FreeChunkPool(). NULL if not even a single thread could be started.
+static struct FindChunkPool* StartChunkPool(const struct FindQuery* query, unsigned int threads)
+{
+	struct FindChunkPool* pool = calloc(1, sizeof(struct FindChunkPool));
+
+	if (pool == NULL)
+		return NULL;
+
+	pool->workers = calloc(threads, sizeof(struct FindChunkWorker));
+	pool->query = query;
+
+	// Keep a few chunks per thread ahead of the walk, including one for the walk itself
+	pool->slotCount = (size_t) (threads + 1) * FIND_CHUNKS_PER_THREAD;
+
+	if (pool->workers == NULL)
+	{
+		free(pool);
+
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->queued, NULL);
+	pthread_cond_init(&pool->finished, NULL);
+
+	for (unsigned int i = 0; i < threads; i++)
+	{
+		pool->workers[i].pool = pool;
+
+		if (pthread_create(&pool->workers[i].thread, NULL, RunChunkWorker, &pool->workers[i]) != 0)
+			break;
+
+		pool->threadCount++;
+	}
+
+	// Without any thread, the walk would still test all chunks itself; Report the failure instead
+	if (pool->threadCount == 0)
+	{
+		FreeChunkPool(pool);
+
+		return NULL;
+	}
+
+	return pool;
+}
+
+/// Calls lstat() on a helper thread and gives up once the timeout of the call guard has passed.
+/// \param iterator The iterator whose call guard to use.
+/// \param path The path of the file.
+/// \param fields The STATX_* fields needed.
+/// \param info Receives the information of the file.
+/// \param error Receives the error code if the call has failed; ETIMEDOUT if it has not returned in time.
+/// \return The result of lstat(), or -1 if the call has not returned in time.
+static int StatFileGuarded(struct FindIterator* iterator, const char* path, unsigned int fields, struct stat* info, int* error)
+{
+	struct FindStatRequest* request = iterator->statRequest;
+
+	if (request == NULL)
+	{
+		request = calloc(1, sizeof(struct FindStatRequest));
+
+		ThreadStats.allocations++;
+
+		if (request == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+	}
+
+	SetRequestPath(&request->path, &request->pathCapacity, path, strlen(path), NULL);
+
+	request->fields = fields;
+	request->flags = iterator->statFlags;
+
+	if (!RunGuardedCall(iterator->guard, PerformStatRequest, ReleaseStatRequest, request))
+	{
+		// The request now belongs to the helper that is stuck in the call
+		iterator->statRequest = NULL;
+
+		ThreadStats.callsTimedOut++;
+
+		*error = ETIMEDOUT;
+
+		return -1;
+	}
+
+	iterator->statRequest = request;
+
+	*info = request->info;
+	*error = request->error;
+
+	return request->result;
+}
+
+/// Reads the information of the file whose path is in the entry of an iterator and determines whether it matches the query.
+/// \param iterator The iterator whose entry to complete.
+/// \param name The entry of the file as read from its directory. NULL for the roots.
+/// \param timing The timing of the directory containing the file, to which the lstat() call is accounted. NULL if not measured.
+/// \return true if the file matches the query. Otherwise, false.
+static bool VisitFile(struct FindIterator* iterator, const struct FindName* name, struct DirectoryTiming* timing)
+{
+	struct FindEntry* entry = &iterator->entry;
+	struct PerfCounters* perf = iterator->diagnostics.perf;
+	bool inodeMatches = true;
+	bool candidate = true;
+
+	// The predicates that do not need the file information are decided from the directory entry
+	if (name != NULL)
+	{
+		entry->info.st_ino = name->inode;
+
+		if (perf != NULL)
+			BeginPerfPhase(perf);
+
+		inodeMatches = MatchesQueryBeforeStat(iterator->query, &iterator->cache, entry, true);
+		candidate = inodeMatches && MatchesQueryBeforeStat(iterator->query, &iterator->cache, entry, false);
+
+		if (perf != NULL)
+			EndPerfPhase(perf, PerfPhaseFilter);
+
+		if (!candidate && SkipStat(name, &entry->info))
+		{
+			iterator->descend = false;
+
+			return false;
+		}
+	}
+
+	uint64_t startTime = (timing != NULL) ? GetMonotonicNanoseconds() : 0;
+
+	if (perf != NULL)
+		BeginPerfPhase(perf);
+
+	int result;
+	int error;
+
+	// Read the file information without following symbolic links
+	if (iterator->guard == NULL)
+	{
+		result = StatFile(entry->path, iterator->statFields, iterator->statFlags, &entry->info);
+		error = errno;
+	}
+	else
+	{
+		// A file that does not answer in time, e.g. on a stale mount, is skipped together with everything below it
+		result = StatFileGuarded(iterator, entry->path, iterator->statFields, &entry->info, &error);
+	}
+
+	ThreadStats.statCalls++;
+
+	if (perf != NULL)
+		EndPerfPhase(perf, PerfPhaseStat);
+
+	if (timing != NULL)
+		timing->statNanoseconds += GetMonotonicNanoseconds() - startTime;
+
+	if (result == -1)
+	{
+		if (iterator->diagnostics.errors != NULL)
+			fprintf(iterator->diagnostics.errors, "Reading information of file \"%s\" has failed with error code %d: %s\n", entry->path, error, strerror(error));
+
+		return false;
+	}
+
+	if (entry->type == DT_UNKNOWN)
+		entry->type = IFTODT(entry->info.st_mode);
+
+	// Continue the search in subdirectories if the "file" is actually a directory
+	iterator->descend = S_ISDIR(entry->info.st_mode);
+
+	if (perf != NULL)
+		BeginPerfPhase(perf);
+
+	// A file rejected by its inode number from the directory entry may still match with the one from lstat(); The other tests stand
+	bool matches = (name != NULL)
+		? ((inodeMatches ? candidate : MatchesQueryBeforeStat(iterator->query, &iterator->cache, entry, false)) && MatchesQueryAfterStat(iterator->query, &iterator->cache, entry))
+		: MatchesQuery(iterator->query, &iterator->cache, entry);
+
+	if (perf != NULL)
+		EndPerfPhase(perf, PerfPhaseFilter);
+
+	return matches;
+}
+
+/// Removes the topmost directory from the stack of an iterator.
+/// \param iterator The iterator whose directory to remove.
+static void PopDirectory(struct FindIterator* iterator)
+{
+	assert(iterator->depth > 0);
+
+
+	struct FindDirectory* directory = &iterator->directories[iterator->depth - 1];
+
+	if (iterator->diagnostics.latency != NULL)
+	{
+		// Cut the path of the last entry off the directory's path
+		iterator->path[directory->pathLength] = '\0';
+
+		RecordDirectoryTiming(iterator->diagnostics.latency, iterator->path, &directory->timing);
+	}
+
+	if (iterator->prefetcher != NULL)
+		DiscardPrefetched(iterator, directory->pathLength);
+
+	if ((directory->chunked != NULL) && directory->chunked->active)
+		EndChunkedDirectory(iterator, directory->chunked);
+
+	// The rules only apply below the directory
+	FreeIgnoreRules(directory->ignoreRules);
+	directory->ignoreRules = NULL;
+
+	iterator->depth--;
+}
+
+/// Takes the entries read by a request over into the topmost directory on the stack of an iterator and reports the outcome.
+/// \param iterator The iterator whose current entry is the directory that has been read.
+/// \param directory The directory on top of the stack, which receives the entries. Its previous buffers are handed to \p request for reuse.
+/// \param request The completed request.
+static void FinishReadRequest(struct FindIterator* iterator, struct FindDirectory* directory, struct FindReadRequest* request)
+{
+	struct FindDiagnostics* diagnostics = &iterator->diagnostics;
+
+	SwapDirectoryEntries(directory, &request->directory);
+
+	directory->timing.entryCount = directory->entryCount;
+
+	ThreadStats.entriesRead += request->entriesRead;
+
+	if ((request->failedCall != NULL) && (diagnostics->errors != NULL))
+		fprintf(diagnostics->errors, "%s directory \"%s\" has failed with error code %d: %s\n", request->failedCall, iterator->path, request->error, strerror(request->error));
+
+	if (!request->opened)
+	{
+		PopDirectory(iterator);
+
+		return;
+	}
+
+	ThreadStats.directoriesOpened++;
+
+	if (diagnostics->progress != NULL)
+	{
+		CountProgress(&iterator->progressCounters->directories);
+		atomic_fetch_add_explicit(&iterator->progressCounters->entries, request->entriesRead, memory_order_relaxed);
+		SetProgressPath(diagnostics->progress, iterator->path);
+	}
+}
+
+/// Takes the entries of the topmost directory on the stack of an iterator from its prefetcher, if the directory has been read ahead.
+/// \param iterator The iterator whose current entry is the directory to read.
+/// \param directory The directory on top of the stack, which receives the entries.
+/// \param startTime The time at which reading the directory has started, if measured.
+/// \return true if the entries have been taken over. false if the directory needs to be read directly.
+static bool TakePrefetchedDirectory(struct FindIterator* iterator, struct FindDirectory* directory, uint64_t startTime)
+{
+	struct FindPrefetcher* prefetcher = iterator->prefetcher;
+	struct FindPrefetchSlot* slot = NULL;
+
+	pthread_mutex_lock(&prefetcher->lock);
+
+	for (size_t i = 0; (i < prefetcher->slotCount) && (slot == NULL); i++)
+	{
+		if ((prefetcher->slots[i].state != FindPrefetchFree) && (strcmp(prefetcher->slots[i].request->path, iterator->path) == 0))
+			slot = &prefetcher->slots[i];
+	}
+
+	if (slot == NULL)
+	{
+		pthread_mutex_unlock(&prefetcher->lock);
+
+		return false;
+	}
+
+	while (slot->state == FindPrefetchReading)
+		pthread_cond_wait(&prefetcher->finished, &prefetcher->lock);
+
+	// A directory still waiting behind others is read directly rather than waiting for them
+	bool done = (slot->state == FindPrefetchDone);
+
+	slot->state = FindPrefetchFree;
+
+	pthread_mutex_unlock(&prefetcher->lock);
+
+	if (!done)
+		return false;
+
+	struct FindDiagnostics* diagnostics = &iterator->diagnostics;
+
+	// Only the time spent waiting for the prefetch thread is accounted to the directory
+	if (diagnostics->latency != NULL)
+		directory->timing.readNanoseconds = GetMonotonicNanoseconds() - startTime;
+
+	if (diagnostics->perf != NULL)
+		EndPerfPhase(diagnostics->perf, PerfPhaseReaddir);
+
+	// The free slot is only reused by the walk itself, so its request can be used without the lock
+	FinishReadRequest(iterator, directory, slot->request);
+
+	return true;
+}
+
+/// Reads all entries of a directory on a helper thread and gives up once the timeout of the call guard has passed.
+/// \param iterator The iterator whose current entry is the directory to read.
+/// \param directory The directory on top of the stack, which receives the entries.
+/// \param startTime The time at which reading the directory has started, if measured.
+static void ReadDirectoryGuarded(struct FindIterator* iterator, struct FindDirectory* directory, uint64_t startTime)
+{
+	struct FindDiagnostics* diagnostics = &iterator->diagnostics;
+	struct FindReadRequest* request = iterator->readRequest;
+
+	if (request == NULL)
+	{
+		request = calloc(1, sizeof(struct FindReadRequest));
+
+		ThreadStats.allocations++;
+
+		if (request == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+	}
+
+	SetRequestPath(&request->path, &request->pathCapacity, iterator->path, directory->pathLength, NULL);
+
+	request->opened = false;
+	request->failedCall = NULL;
+	request->entriesRead = 0;
+
+	// Let the helper fill the buffers of the directory, so that they can be handed back without copying
+	SwapDirectoryEntries(directory, &request->directory);
+
+	directory->namesSize = 0;
+	directory->entryCount = 0;
+	request->directory.namesSize = 0;
+	request->directory.entryCount = 0;
+
+	bool completed = RunGuardedCall(iterator->guard, PerformReadRequest, ReleaseReadRequest, request);
+
+	if (diagnostics->latency != NULL)
+		directory->timing.readNanoseconds = GetMonotonicNanoseconds() - startTime;
+
+	if (diagnostics->perf != NULL)
+		EndPerfPhase(diagnostics->perf, PerfPhaseReaddir);
+
+	if (!completed)
+	{
+		// The request and the buffers it holds now belong to the helper that is stuck in the call
+		iterator->readRequest = NULL;
+
+		ThreadStats.callsTimedOut++;
+
+		if (diagnostics->errors != NULL)
+			fprintf(diagnostics->errors, "Reading directory \"%s\" has failed with error code %d: %s\n", iterator->path, ETIMEDOUT, strerror(ETIMEDOUT));
+
+		// A directory that does not answer in time is worth reporting as one of the slowest
+		PopDirectory(iterator);
+
+		return;
+	}
+
+	iterator->readRequest = request;
+
+	FinishReadRequest(iterator, directory, request);
+}
+
+/// Reads all entries of the directory visited last and pushes it onto the stack of an iterator.
+/// \param iterator The iterator whose current entry is the directory to read.
+static void ReadDirectory(struct FindIterator* iterator)
+{
+	if (iterator->depth == iterator->directoryCapacity)
+	{
+		size_t capacity = iterator->directoryCapacity * 2;
+		struct FindDirectory* directories = realloc(iterator->directories, capacity * sizeof(struct FindDirectory));
+
+		ThreadStats.allocations++;
+
+		if (directories == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		memset(directories + iterator->directoryCapacity, 0, (capacity - iterator->directoryCapacity) * sizeof(struct FindDirectory));
+
+		iterator->directories = directories;
+		iterator->directoryCapacity = capacity;
+	}
+
+	// Reuse the allocations of a directory that has been popped before
+	struct FindDirectory* directory = &iterator->directories[iterator->depth++];
+
+	directory->namesSize = 0;
+	directory->entryCount = 0;
+	directory->nextEntry = 0;
+	directory->prefetchEntry = 0;
+	directory->pathLength = iterator->entry.pathLength;
+	memset(&directory->timing, 0, sizeof(directory->timing));
+
+	char* directoryPath = iterator->path;
+	struct FindDiagnostics* diagnostics = &iterator->diagnostics;
+
+	if (diagnostics->perf != NULL)
+		BeginPerfPhase(diagnostics->perf);
+
+	uint64_t startTime = (diagnostics->latency != NULL) ? GetMonotonicNanoseconds() : 0;
+
+	if (iterator->guard != NULL)
+	{
+		ReadDirectoryGuarded(iterator, directory, startTime);
+
+		return;
+	}
+
+	if ((iterator->prefetcher != NULL) && TakePrefetchedDirectory(iterator, directory, startTime))
+		return;
+
+	// Open the specified directory
+	DIR* pDir = opendir(directoryPath);
+	int error = errno;
+
+	if (diagnostics->latency != NULL)
+	{
+		uint64_t now = GetMonotonicNanoseconds();
+
+		directory->timing.openNanoseconds = now - startTime;
+		startTime = now;
+	}
+
+	if (pDir == NULL)
+	{
+		if (diagnostics->errors != NULL)
+			fprintf(diagnostics->errors, "Opening directory \"%s\" has failed with error code %d: %s\n", directoryPath, error, strerror(error));
+
+		if (diagnostics->perf != NULL)
+			EndPerfPhase(diagnostics->perf, PerfPhaseReaddir);
+
+		// A slow failure, e.g. on an unreachable network file system, is worth reporting as well
+		PopDirectory(iterator);
+
+		return;
+	}
+
+	ThreadStats.directoriesOpened++;
+
+	if (diagnostics->progress != NULL)
+	{
+		CountProgress(&iterator->progressCounters->directories);
+		SetProgressPath(diagnostics->progress, directoryPath);
+	}
+
+	struct dirent* directoryInfo = NULL;
+
+	do
+	{
+		// Reset error for the subsequent library call
+		errno = 0;
+
+		// Read directory information
+		directoryInfo = readdir(pDir);
+
+		if (directoryInfo == NULL)
+		{
+			// If no error value is set, it indicates that the end of the directory stream has been reached
+			if ((errno != 0) && (diagnostics->errors != NULL))
+				fprintf(diagnostics->errors, "Reading directory \"%s\" has failed with error code %d: %s\n", directoryPath, errno, strerror(errno));
+
+			break;
+		}
+
+		ThreadStats.entriesRead++;
+
+		// Huge directories take a while to read; Do not finish them once the walk has been cancelled
+		if (atomic_load_explicit(&iterator->cancelled, memory_order_relaxed))
+			break;
+
+		if (iterator->progressCounters != NULL)
+			CountProgress(&iterator->progressCounters->entries);
+
+		// Ignore the directory entries that represent the current and the parent directory
+		if ((strcmp(directoryInfo->d_name, ".") == 0) || (strcmp(directoryInfo->d_name, "..") == 0))
+			continue;
+
+		AddDirectoryEntry(directory, directoryInfo->d_name, directoryInfo->d_type, directoryInfo->d_ino);
+	} while (directoryInfo != NULL);
+
+	directory->timing.entryCount = directory->entryCount;
+
+	// Close the directory
+	int result = closedir(pDir);
+
+	error = errno;
+
+	if (diagnostics->latency != NULL)
+		directory->timing.readNanoseconds = GetMonotonicNanoseconds() - startTime;
+
+	if (diagnostics->perf != NULL)
+		EndPerfPhase(diagnostics->perf, PerfPhaseReaddir);
+
+	if (result == -1)
+	{
+		if (diagnostics->errors != NULL)
+			fprintf(diagnostics->errors, "Closing directory \"%s\" has failed with error code %d: %s\n", directoryPath, error, strerror(error));
+
+		// Skip the entries, as before
+		directory->entryCount = 0;
+	}
+}
+
+/// Determines how the file system of the directory visited last is walked. The type of each file system is determined once, when the walk enters it first.
+/// With the automatic strategy, the helper threads the caller has not started are only used on file systems with a high latency per call, and started there.
+/// \param iterator The iterator whose current entry is the directory to be read.
+/// \return The file system of the directory.
+static const struct FindFileSystem* GetFileSystem(struct FindIterator* iterator)
+{
+	dev_t device = iterator->entry.info.st_dev;
+
+	// Most walks never leave the file system they started on
+	for (size_t i = iterator->fileSystemCount; i > 0; i--)
+	{
+		if (iterator->fileSystems[i - 1].device == device)
+			return &iterator->fileSystems[i - 1];
+	}
+
+	if (iterator->fileSystemCount == iterator->fileSystemCapacity)
+	{
+		size_t capacity = (iterator->fileSystemCapacity > 0) ? iterator->fileSystemCapacity * 2 : 4;
+		struct FindFileSystem* fileSystems = realloc(iterator->fileSystems, capacity * sizeof(struct FindFileSystem));
+
+		ThreadStats.allocations++;
+
+		if (fileSystems == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		iterator->fileSystems = fileSystems;
+		iterator->fileSystemCapacity = capacity;
+	}
+
+	struct FindFileSystem* fileSystem = &iterator->fileSystems[iterator->fileSystemCount++];
+
+	fileSystem->device = device;
+	fileSystem->unresponsive = false;
+
+	if (iterator->guard == NULL)
+	{
+		QueryFileSystem(iterator->path, &fileSystem->type);
+	}
+	else
+	{
+		// statfs() waits for an unresponsive server just like lstat(); A new request is made for each file system, as there are only a few
+		struct FindFileSystemRequest* request = calloc(1, sizeof(struct FindFileSystemRequest));
+
+		ThreadStats.allocations++;
+
+		if (request == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		SetRequestPath(&request->path, &request->pathCapacity, iterator->path, strlen(iterator->path), NULL);
+
+		if (RunGuardedCall(iterator->guard, PerformFileSystemRequest, ReleaseFileSystemRequest, request))
+		{
+			fileSystem->type = request->type;
+
+			ReleaseFileSystemRequest(request);
+		}
+		else
+		{
+			// The request now belongs to the helper that is stuck in the call
+			ThreadStats.callsTimedOut++;
+
+			fileSystem->type.magic = 0;
+			fileSystem->type.name = "unknown";
+			fileSystem->type.fileSystemClass = FileSystemUnknown;
+			fileSystem->unresponsive = true;
+		}
+	}
+
+	if ((iterator->strategy == FindStrategyAuto) && (fileSystem->type.fileSystemClass != FileSystemUnknown))
+	{
+		// Local and pseudo file systems answer faster than the threads could be handed the work; Only the helpers the caller has chosen are used there anyway
+		fileSystem->readAhead = iterator->fixedPrefetch || (fileSystem->type.fileSystemClass == FileSystemNetwork);
+		fileSystem->useStatThreads = iterator->fixedStatThreads || (fileSystem->type.fileSystemClass == FileSystemNetwork);
+
+		// The helper threads have no timeout; With one, unresponsive servers are handled by the call guard instead
+		if (iterator->guard == NULL)
+		{
+			if (fileSystem->readAhead && (iterator->prefetcher == NULL))
+				iterator->prefetcher = StartPrefetcher(FIND_AUTO_PREFETCH);
+
+			if (fileSystem->useStatThreads && (iterator->chunkPool == NULL))
+				iterator->chunkPool = StartChunkPool(iterator->query, FIND_AUTO_STAT_THREADS);
+		}
+	}
+	else
+	{
+		fileSystem->readAhead = true;
+		fileSystem->useStatThreads = true;
+	}
+
+	FILE* stream = iterator->diagnostics.strategy;
+
+	if (stream != NULL)
+	{
+		fprintf(stream, "File system of \"%s\" (device %u:%u): %s, %s;", iterator->path, major(device), minor(device), fileSystem->type.name, GetFileSystemClassName(fileSystem->type.fileSystemClass));
+
+		bool readsAhead = fileSystem->readAhead && (iterator->prefetcher != NULL);
+		bool testsInChunks = fileSystem->useStatThreads && (iterator->chunkPool != NULL);
+
+		if (readsAhead)
+			fprintf(stream, " read ahead %zu directories", iterator->prefetcher->slotCount);
+
+		if (testsInChunks)
+			fprintf(stream, "%s %u stat threads", readsAhead ? "," : "", iterator->chunkPool->threadCount);
+
+		if (fileSystem->unresponsive)
+			fprintf(stream, " not answering, skipped");
+		else if (!readsAhead && !testsInChunks)
+			fprintf(stream, " serial walk");
+
+		fprintf(stream, " (%s)\n", (iterator->strategy == FindStrategyAuto) ? "auto" : "fixed");
+	}
+
+	return fileSystem;
+}
+
+/// Appends a name to the path of a directory in the path buffer of an iterator, taking care of duplicated slashes.
+/// \param iterator The iterator whose path buffer to use.
+/// \param directoryLength The number of characters of the directory's path at the start of the buffer.
+/// \param fileName The name to append.
+/// \param nameLength The number of characters in \p fileName.
+/// \return The number of characters of the resulting path.
+static size_t AppendToPath(struct FindIterator* iterator, size_t directoryLength, const char* fileName, size_t nameLength)
+{
+	bool needsSeparator = (directoryLength > 0) && (iterator->path[directoryLength - 1] != '/');
+	size_t pathLength = directoryLength + needsSeparator + nameLength;
+
+	ReservePath(iterator, pathLength);
+
+	if (needsSeparator)
+		iterator->path[directoryLength] = '/';
+
+	memcpy(iterator->path + directoryLength + needsSeparator, fileName, nameLength + 1);
+
+	return pathLength;
+}
+
+/// Determines whether a file is excluded from the walk.
+/// \param exclusions The exclusions of the walk.
+/// \param node The trie node of the file, as returned by FindExcludeChild() for its directory.
+/// \param name The name of the file.
+/// \param nameLength The number of characters in \p name.
+/// \param path The path of the file. Only needed if \p exclusions has path globs.
+/// \param pathLength The number of characters in \p path.
+/// \return true if the file and everything below it is excluded. Otherwise, false.
+static bool IsExcludedFile(const struct FindExclusions* exclusions, int node, const char* name, size_t nameLength, const char* path, size_t pathLength)
+{
+	if (IsExcludedName(exclusions->set, name, nameLength) || IsExcludedPrefix(exclusions->set, node))
+		return true;
+
+	for (size_t i = 0; i < exclusions->globCount; i++)
+	{
+		const struct FindPredicate* glob = &exclusions->globs[i];
+
+		if ((glob->kind == FindPredicateName) ? MatchesPattern(glob, name, nameLength) : MatchesPattern(glob, path, pathLength))
+			return true;
+	}
+
+	return false;
+}
+
+/// Determines whether the file whose path is in the path buffer of an iterator is a directory, for entries whose type readdir() has not reported.
+/// Uses the call guard and the flags of the walk's own lstat() calls, but only asks for the type.
+/// \param iterator The iterator.
+/// \return true if the file is a directory. false if it is not, or if its type could not be read in time.
+static bool IsDirectoryPath(struct FindIterator* iterator)
+{
+	struct stat info;
+	int error;
+	int result = (iterator->guard == NULL)
+		? StatFile(iterator->path, STATX_TYPE, iterator->statFlags, &info)
+		: StatFileGuarded(iterator, iterator->path, STATX_TYPE, &info, &error);
+
+	ThreadStats.statCalls++;
+
+	return (result == 0) && S_ISDIR(info.st_mode);
+}
+
+/// Determines whether git ignores a file, according to the .gitignore files of its directory and the parent directories.
+/// \param iterator The iterator, whose path buffer holds the path of the file.
+/// \param directory The directory of the file, on top of the stack.
+/// \param name The entry of the file.
+/// \param fileName The name of the file.
+/// \param nameLength The number of characters in \p fileName.
+/// \return true if git ignores the file. Otherwise, false.
+static bool IsIgnoredFile(struct FindIterator* iterator, const struct FindDirectory* directory, const struct FindName* name, const char* fileName, size_t nameLength)
+{
+	// git keeps its own data in ".git", which is never part of the working tree
+	if (strcmp(fileName, ".git") == 0)
+		return true;
+
+	const struct FindDirectory* rulesDirectory = (directory->ignoreRules != NULL)
+		? directory
+		: ((directory->ignoreParent > 0) ? &iterator->directories[directory->ignoreParent - 1] : NULL);
+
+	if (rulesDirectory == NULL)
+		return false;
+
+	// Rules ending with a slash only match directories; Without the type from readdir(), look it up
+	bool isDirectory = (name->type != DT_UNKNOWN) ? (name->type == DT_DIR) : IsDirectoryPath(iterator);
+
+	// The rules of the deepest .gitignore file take precedence; A parent's rules only decide if none of them match
+	while (rulesDirectory != NULL)
+	{
+		const char* relativePath = iterator->path + rulesDirectory->pathLength;
+
+		if (*relativePath == '/')
+			relativePath++;
+
+		enum IgnoreMatch match = MatchIgnoreRules(rulesDirectory->ignoreRules, relativePath, fileName, nameLength, isDirectory);
+
+		if (match != IgnoreNone)
+			return match == IgnoreExclude;
+
+		rulesDirectory = (rulesDirectory->ignoreParent > 0) ? &iterator->directories[rulesDirectory->ignoreParent - 1] : NULL;
+	}
+
+	return false;
+}
+
+/// Compiles the .gitignore file of a directory that has just been read, if it has one.
+/// \param iterator The iterator.
+/// \param directory The directory on top of the stack.
+static void LoadDirectoryIgnoreRules(struct FindIterator* iterator, struct FindDirectory* directory)
+{
+	for (size_t i = 0; i < directory->entryCount; i++)
+	{
+		const char* fileName = directory->names + directory->entries[i].offset;
+
+		if (strcmp(fileName, ".gitignore") == 0)
+		{
+			AppendToPath(iterator, directory->pathLength, fileName, strlen(fileName));
+			directory->ignoreRules = LoadIgnoreRules(iterator->path, iterator->diagnostics.errors);
+			iterator->path[directory->pathLength] = '\0';
+
+			return;
+		}
+	}
+}
+
+/// Removes the excluded and ignored entries of a directory that has just been read, so that they are neither tested, read ahead nor descended into.
+/// \param iterator The iterator.
+/// \param directory The directory on top of the stack.
+static void FilterEntries(struct FindIterator* iterator, struct FindDirectory* directory)
+{
+	const struct FindExclusions* exclusions = iterator->exclusions;
+	bool hasPrefixes = (directory->excludeNode != EXCLUDE_NONE);
+
+	if (iterator->respectGitignore)
+		LoadDirectoryIgnoreRules(iterator, directory);
+
+	// The path is only built for the patterns that need it; VisitDirectoryEntry() builds it again anyway
+	bool hasIgnoreRules = (directory->ignoreRules != NULL) || (directory->ignoreParent > 0);
+	bool needsPath = ((exclusions != NULL) && exclusions->hasPathGlobs) || hasIgnoreRules;
+	size_t kept = 0;
+
+	for (size_t i = 0; i < directory->entryCount; i++)
+	{
+		const char* fileName = directory->names + directory->entries[i].offset;
+		size_t nameLength = strlen(fileName);
+		int node = hasPrefixes ? FindExcludeChild(exclusions->set, directory->excludeNode, fileName, nameLength) : EXCLUDE_NONE;
+		size_t pathLength = needsPath ? AppendToPath(iterator, directory->pathLength, fileName, nameLength) : 0;
+
+		if (((exclusions != NULL) && IsExcludedFile(exclusions, node, fileName, nameLength, iterator->path, pathLength)) ||
+			(iterator->respectGitignore && IsIgnoredFile(iterator, directory, &directory->entries[i], fileName, nameLength)))
+		{
+			ThreadStats.entriesExcluded++;
+
+			continue;
+		}
+
+		directory->entries[kept++] = directory->entries[i];
+	}
+
+	directory->entryCount = kept;
+	iterator->path[directory->pathLength] = '\0';
+}
+
+/// Looks up the trie node of a root by the components of its path.
+/// \param set The excluded prefixes.
+/// \param root The path of the root.
+/// \param excluded Set to true if the root is below an excluded prefix.
+/// \return The trie node of the root. EXCLUDE_NONE if no excluded prefix continues below it.
+static int FindRootExcludeNode(const struct ExcludeSet* set, const char* root, bool* excluded)
+{
+	int node = EXCLUDE_ROOT;
+
+	*excluded = false;
+
+	if (root[0] == '/')
+		node = FindExcludeChild(set, node, EXCLUDE_ABSOLUTE, strlen(EXCLUDE_ABSOLUTE));
+
+	while ((node != EXCLUDE_NONE) && (*root != '\0'))
+	{
+		size_t length = strcspn(root, "/");
+
+		// Empty and "." components do not change the path, as in AddExcludedPrefix()
+		if ((length > 0) && !((length == 1) && (root[0] == '.')))
+		{
+			node = FindExcludeChild(set, node, root, length);
+
+			if (IsExcludedPrefix(set, node))
+			{
+				*excluded = true;
+
+				return node;
+			}
+		}
+
+		root += length;
+
+		if (*root == '/')
+			root++;
+	}
+
+	// "." and "/" themselves may be excluded as well
+	*excluded = IsExcludedPrefix(set, node);
+
+	return node;
+}
+
+/// Completes the entry of an iterator with the result of its chunk, which has been tested by a stat thread or by the walk itself.
+/// \param iterator The iterator whose entry to complete.
+/// \param directory The chunked directory on top of the stack.
+/// \param index The index of the entry in the directory.
+/// \return true if the file matches the query. Otherwise, false.
+static bool VisitChunkedEntry(struct FindIterator* iterator, struct FindDirectory* directory, size_t index)
+{
+	struct FindEntry* entry = &iterator->entry;
+	const struct FindChunkResult* result = TakeChunkResult(iterator, directory, index);
+
+	if (result->error != 0)
+	{
+		if (iterator->diagnostics.errors != NULL)
+			fprintf(iterator->diagnostics.errors, "Reading information of file \"%s\" has failed with error code %d: %s\n", entry->path, result->error, strerror(result->error));
+
+		return false;
+	}
+
+	entry->info = result->info;
+
+	if (entry->type == DT_UNKNOWN)
+		entry->type = IFTODT(entry->info.st_mode);
+
+	iterator->descend = S_ISDIR(entry->info.st_mode);
+
+	return result->matches;
+}
+
+/// Visits the next entry of the topmost directory on the stack of an iterator.
+/// \param iterator The iterator whose entry to visit.
+/// \param directory The topmost directory on the stack.
+/// \return true if the entry matches the query. Otherwise, false.
+static bool VisitDirectoryEntry(struct FindIterator* iterator, struct FindDirectory* directory)
+{
+	struct FindName* name = &directory->entries[directory->nextEntry++];
+	char* fileName = directory->names + name->offset;
+	size_t nameLength = strlen(fileName);
+	size_t pathLength = AppendToPath(iterator, directory->pathLength, fileName, nameLength);
+
+	ThreadStats.pathBytes += pathLength + 1;
+
+	struct FindEntry* entry = &iterator->entry;
+
+	entry->path = iterator->path;
+	entry->pathLength = pathLength;
+	entry->name = iterator->path + pathLength - nameLength;
+	entry->type = name->type;
+	entry->depth = iterator->depth;
+
+	if ((directory->chunked != NULL) && directory->chunked->active)
+		return VisitChunkedEntry(iterator, directory, directory->nextEntry - 1);
+
+	return VisitFile(iterator, name, (iterator->diagnostics.latency != NULL) ? &directory->timing : NULL);
+}
+
+/// Visits a root of the walk.
+/// \param iterator The iterator to visit the root with.
+/// \param root The path of the root.
+/// \return true if the root matches the query. Otherwise, false.
+static bool VisitRoot(struct FindIterator* iterator, char* root)
+{
+	size_t pathLength = strlen(root);
+
+	ReservePath(iterator, pathLength);
+	memcpy(iterator->path, root, pathLength + 1);
+
+	// The name is determined like basename(), which might modify its argument
+	free(iterator->rootName);
+	iterator->rootName = strdup(root);
+
+	if (iterator->rootName == NULL)
+	{
+		// Out of memory
+		exit(-1);
+	}
+
+	struct FindEntry* entry = &iterator->entry;
+
+	entry->path = iterator->path;
+	entry->pathLength = pathLength;
+	entry->name = basename(iterator->rootName);
+	entry->type = DT_UNKNOWN;
+	entry->depth = 0;
+
+	if (iterator->exclusions != NULL)
+	{
+		bool excluded;
+
+		iterator->rootExcludeNode = FindRootExcludeNode(iterator->exclusions->set, root, &excluded);
+
+		if (excluded || IsExcludedFile(iterator->exclusions, EXCLUDE_NONE, entry->name, strlen(entry->name), entry->path, entry->pathLength))
+		{
+			ThreadStats.entriesExcluded++;
+			iterator->descend = false;
+
+			return false;
+		}
+	}
+
+	return VisitFile(iterator, NULL, NULL);
+}
+
+
+
+/// Determines whether an argument is the name of a predicate known to find_compile().
+/// \param name The argument to check.
+/// \return The number of arguments that follow the predicate's name. -1 if \p name is not a predicate.
+int find_predicate_arguments(const char* name)
+{
+	assert(name != NULL);
+
+
+	const struct FindPredicateSyntax* syntax = LookUpPredicate(name);
+
+	return (syntax != NULL) ? syntax->arguments : -1;
+}
+
+/// Compiles a query from predicates like "-type f -name *.c". All files have to fulfill all predicates.
+/// User and group names are resolved and patterns are analyzed once, so that the query can be executed any number of times, also concurrently.
+/// \param expression The predicates and their arguments. The last element of the array must be NULL.
+/// \param errors The stream to report invalid predicates to. May be NULL.
+/// \return The compiled query, which needs to be released with find_free_query(). NULL if the expression is invalid or out of memory.
+struct FindQuery* find_compile(char* const expression[], FILE* errors)
+{
+	assert(expression != NULL);
+
+
+	size_t tokenCount = 0;
+
+	while (expression[tokenCount] != NULL)
+		tokenCount++;
+
+	struct FindQuery* query = calloc(1, sizeof(struct FindQuery));
+
+	if (query == NULL)
+		return NULL;
+
+	// There cannot be more predicates than arguments
+	query->predicates = calloc((tokenCount > 0) ? tokenCount : 1, sizeof(struct FindPredicate));
+	query->referenceTime = time(NULL);
+
+	if (query->predicates == NULL)
+	{
+		find_free_query(query);
+
+		return NULL;
+	}
+
+	for (size_t i = 0; i < tokenCount; i++)
+	{
+		const struct FindPredicateSyntax* syntax = LookUpPredicate(expression[i]);
+
+		if (syntax == NULL)
+		{
+			if (errors != NULL)
+				fprintf(errors, "myfind: Unknown predicate \"%s\".\n", expression[i]);
+
+			find_free_query(query);
+
+			return NULL;
+		}
+
+		struct FindPredicate* predicate = &query->predicates[query->predicateCount++];
+		char* argument = (syntax->arguments > 0) ? expression[i + 1] : NULL;
+		bool valid = true;
+
+		predicate->kind = syntax->kind;
+		predicate->cost = syntax->cost;
+		predicate->needsStat = (syntax->statFields != 0);
+		query->statFields |= syntax->statFields;
+
+		switch (syntax->kind)
+		{
+		case FindPredicateType:
+			if (argument == NULL)
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: \"-type\" must be followed by one or more concatenated file type characters.\n");
+
+				valid = false;
+			}
+			else if (!ParseFileTypes(argument, &predicate->fileTypes))
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: The specified file types \"%s\" are invalid.\n", argument);
+
+				valid = false;
+			}
+			break;
+
+		case FindPredicateUser:
+		{
+			int userID = 0;
+
+			if (argument == NULL)
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: \"-user\" must be followed by the name or ID of a user.\n");
+
+				valid = false;
+			}
+			else if (!ConvertToInteger(argument, &userID) && !QueryUserID(argument, &userID))
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: \"%s\" is not the name of a known user\n", argument);
+
+				valid = false;
+			}
+
+			predicate->id = (unsigned int) userID;
+			break;
+		}
+
+		case FindPredicateGroup:
+		{
+			int groupID = 0;
+
+			if (argument == NULL)
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: \"-group\" must be followed by the name or ID of a group.\n");
+
+				valid = false;
+			}
+			else if (!ConvertToIntegerGroup(argument, &groupID) && !QueryGroupID(argument, &groupID))
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: \"%s\" is not the name of a known group\n", argument);
+
+				valid = false;
+			}
+
+			predicate->id = (unsigned int) groupID;
+			break;
+		}
+
+		case FindPredicateName:
+		case FindPredicatePath:
+			if (argument == NULL)
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: \"%s\" must be followed by a string representing the filter pattern to apply for the file %s.\n", syntax->name, (syntax->kind == FindPredicateName) ? "name" : "path");
+
+				valid = false;
+			}
+			else if (!CompilePattern(predicate, argument, syntax->ignoreCase))
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: Out of memory.\n");
+
+				valid = false;
+			}
+			break;
+
+		case FindPredicateRegex:
+		{
+			const char* error = NULL;
+
+			if (argument == NULL)
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: \"%s\" must be followed by a regular expression matching the whole file path.\n", syntax->name);
+
+				valid = false;
+			}
+			else if ((predicate->regex = CompileRegex(argument, syntax->ignoreCase, &error)) == NULL)
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: The regular expression \"%s\" is invalid: %s.\n", argument, error);
+
+				valid = false;
+			}
+
+			predicate->regexIndex = query->regexCount++;
+			break;
+		}
+
+		case FindPredicateInode:
+		case FindPredicateLinks:
+			if (argument == NULL)
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: \"%s\" must be followed by a number, optionally preceded by + or -.\n", syntax->name);
+
+				valid = false;
+			}
+			else if (!ParseComparison(argument, &predicate->comparison, &predicate->number))
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: \"%s\" is not a valid number for \"%s\".\n", argument, syntax->name);
+
+				valid = false;
+			}
+
+			// The roots have no directory entry to take the inode number from
+			if (syntax->kind == FindPredicateInode)
+				query->statFields |= STATX_INO;
+			break;
+
+		case FindPredicateDevice:
+		{
+			struct stat fileInformation;
+
+			if (argument == NULL)
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: \"-samefile\" must be followed by the path of a file.\n");
+
+				valid = false;
+			}
+			else if (lstat(argument, &fileInformation) == -1)
+			{
+				if (errors != NULL)
+					fprintf(errors, "myfind: Reading information of file \"%s\" has failed with error code %d: %s\n", argument, errno, strerror(errno));
+
+				valid = false;
+			}
+			else
+			{
+				// The inode number rejects almost all files before lstat(); Only the few with the same number need their device compared
+				struct FindPredicate* inode = &query->predicates[query->predicateCount++];
+
+				predicate->device = fileInformation.st_dev;
+
+				inode->kind = FindPredicateInode;
+				inode->cost = syntax->cost;
+				inode->comparison = FindEqual;
+				inode->number = fileInformation.st_ino;
+			}
+			break;
+		}
+
+		case FindPredicateNoUser:
+		case FindPredicateNoGroup:
+			break;
+		}
+
+		if (!valid)
+		{
+			find_free_query(query);
+
+			return NULL;
+		}
+
+		// Skip the arguments of the predicate
+		i += syntax->arguments;
+	}
+
+	// Order the predicates by whether they need the file information, then by their cost; As all of them have to be fulfilled, the order does not change the result
+	for (size_t i = 1; i < query->predicateCount; i++)
+	{
+		struct FindPredicate predicate = query->predicates[i];
+		size_t j = i;
+
+		while ((j > 0) && ((query->predicates[j - 1].needsStat > predicate.needsStat) ||
+			((query->predicates[j - 1].needsStat == predicate.needsStat) && (query->predicates[j - 1].cost > predicate.cost))))
+		{
+			query->predicates[j] = query->predicates[j - 1];
+			j--;
+		}
+
+		query->predicates[j] = predicate;
+	}
+
+	return query;
+}
+
+/// Gets the time at which a query was compiled, against which relative times such as file ages are evaluated.
+/// \param query The compiled query.
+/// \return The time at which the query was compiled.
+time_t find_query_time(const struct FindQuery* query)
+{
+	assert(query != NULL);
+
+
+	return query->referenceTime;
+}
+
+/// Frees a compiled query. No walk may use it anymore.
+/// \param query The query to free. May be NULL.
+void find_free_query(struct FindQuery* query)
+{
+	if (query == NULL)
+		return;
+
+	if (query->predicates != NULL)
+	{
+		for (size_t i = 0; i < query->predicateCount; i++)
+		{
+			free(query->predicates[i].pattern);
+			FreeRegex(query->predicates[i].regex);
+		}
+	}
+
+	free(query->predicates);
+	free(query);
+}
+
+/// Creates an empty set of exclusions, to be filled by find_load_exclusions().
+/// \return The exclusions, which need to be released with find_free_exclusions(). NULL if out of memory.
+struct FindExclusions* find_create_exclusions(void)
+{
+	struct FindExclusions* exclusions = calloc(1, sizeof(struct FindExclusions));
+
+	if (exclusions == NULL)
+		return NULL;
+
+	exclusions->set = CreateExcludeSet();
+
+	if (exclusions->set == NULL)
+	{
+		find_free_exclusions(exclusions);
+
+		return NULL;
+	}
+
+	return exclusions;
+}
+
+/// Adds a single line of an exclusion list.
+/// \param exclusions The exclusions to add to.
+/// \param line The line without its line break. Trailing slashes are removed.
+/// \return true if the line has been added. false if out of memory.
+static bool AddExclusion(struct FindExclusions* exclusions, char* line)
+{
+	size_t length = strlen(line);
+
+	// "build/" excludes the same as "build"; Everything below an excluded path is skipped anyway
+	while ((length > 1) && (line[length - 1] == '/'))
+		line[--length] = '\0';
+
+	if (strpbrk(line, "*?[\\") != NULL)
+	{
+		if (exclusions->globCount == exclusions->globCapacity)
+		{
+			size_t capacity = (exclusions->globCapacity > 0) ? exclusions->globCapacity * 2 : 16;
+			struct FindPredicate* globs = realloc(exclusions->globs, capacity * sizeof(struct FindPredicate));
+
+			if (globs == NULL)
+				return false;
+
+			exclusions->globs = globs;
+			exclusions->globCapacity = capacity;
+		}
+
+		struct FindPredicate* glob = &exclusions->globs[exclusions->globCount];
+
+		memset(glob, 0, sizeof(struct FindPredicate));
+		glob->kind = (strchr(line, '/') != NULL) ? FindPredicatePath : FindPredicateName;
+
+		if (!CompilePattern(glob, line, false))
+			return false;
+
+		exclusions->globCount++;
+		exclusions->hasPathGlobs = exclusions->hasPathGlobs || (glob->kind == FindPredicatePath);
+
+		return true;
+	}
+
+	if (strchr(line, '/') != NULL)
+		return AddExcludedPrefix(exclusions->set, line);
+
+	return AddExcludedName(exclusions->set, line, length);
+}
+
+/// Loads an exclusion list. Each line holds a name, a path prefix or a glob pattern; Empty lines and lines starting with "#" are ignored.
+/// Names without a slash exclude all files of that name. Paths exclude the file with exactly that path, as printed by the walk, and everything below it.
+/// Patterns containing "*", "?", "[" or "\\" are matched like "-name", or like "-path" if they contain a slash.
+/// \param exclusions The exclusions to add the lines to. No walk may use them yet.
+/// \param fileName The path of the exclusion list.
+/// \param errors The stream to report a failure to. May be NULL.
+/// \return true if the list has been loaded. Otherwise, false.
+bool find_load_exclusions(struct FindExclusions* exclusions, const char* fileName, FILE* errors)
+{
+	assert(exclusions != NULL);
+	assert(fileName != NULL);
+
+
+	FILE* file = fopen(fileName, "r");
+
+	if (file == NULL)
+	{
+		if (errors != NULL)
+			fprintf(errors, "myfind: Opening the exclusion list \"%s\" has failed with error code %d: %s\n", fileName, errno, strerror(errno));
+
+		return false;
+	}
+
+	char* line = NULL;
+	size_t lineCapacity = 0;
+	ssize_t lineLength;
+	bool valid = true;
+
+	while (valid && ((lineLength = getline(&line, &lineCapacity, file)) != -1))
+	{
+		// Lists written on Windows end their lines with a carriage return as well
+		while ((lineLength > 0) && ((line[lineLength - 1] == '\n') || (line[lineLength - 1] == '\r')))
+			line[--lineLength] = '\0';
+
+		if ((lineLength == 0) || (line[0] == '#'))
+			continue;
+
+		if (!AddExclusion(exclusions, line))
+		{
+			if (errors != NULL)
+				fprintf(errors, "myfind: Out of memory.\n");
+
+			valid = false;
+		}
+	}
+
+	if (valid && ferror(file))
+	{
+		if (errors != NULL)
+			fprintf(errors, "myfind: Reading the exclusion list \"%s\" has failed.\n", fileName);
+
+		valid = false;
+	}
+
+	free(line);
+	fclose(file);
+
+	return valid;
+}
+
+/// Frees a set of exclusions. No walk may use them anymore.
+/// \param exclusions The exclusions to free. May be NULL.
+void find_free_exclusions(struct FindExclusions* exclusions)
+{
+	if (exclusions == NULL)
+		return;
+
+	for (size_t i = 0; i < exclusions->globCount; i++)
+		free(exclusions->globs[i].pattern);
+
+	FreeExcludeSet(exclusions->set);
+	free(exclusions->globs);
+	free(exclusions);
+}
+
+/// Starts a walk over the files below the specified roots.
+/// \param query The compiled criteria by which to select the files. It must remain valid until find_close() is called, but may be used by other walks at the same time.
+/// \param roots The paths to start the walk at. The last element of the array must be NULL. The array must remain valid until find_close() is called.
+/// \return The iterator to pass to find_next(), which needs to be released with find_close(). NULL if out of memory.
+struct FindIterator* find_open(const struct FindQuery* query, char* const roots[])
+{
+	assert(query != NULL);
+	assert(roots != NULL);
+
+
+	struct FindIterator* iterator = calloc(1, sizeof(struct FindIterator));
+
+	if (iterator == NULL)
+		return NULL;
+
+	iterator->query = query;
+	iterator->roots = roots;
+	iterator->path = malloc(FIND_INITIAL_PATH_SIZE);
+	iterator->pathCapacity = FIND_INITIAL_PATH_SIZE;
+	iterator->directories = calloc(FIND_INITIAL_DEPTH, sizeof(struct FindDirectory));
+	iterator->directoryCapacity = FIND_INITIAL_DEPTH;
+	iterator->diagnostics.errors = stderr;
+	iterator->statFields = STATX_BASIC_STATS;
+
+	atomic_init(&iterator->cancelled, false);
+
+	if ((iterator->path == NULL) || (iterator->directories == NULL))
+	{
+		find_close(iterator);
+
+		return NULL;
+	}
+
+	return iterator;
+}
+
+/// Skips the excluded files of a walk together with everything below them. Their directories are never opened.
+/// \param iterator The iterator to exclude the files from. find_next() must not have been called yet.
+/// \param exclusions The exclusions loaded with find_load_exclusions(). They must remain valid until find_close() is called, but may be used by other walks at the same time. NULL to exclude nothing.
+void find_set_exclusions(struct FindIterator* iterator, const struct FindExclusions* exclusions)
+{
+	assert(iterator != NULL);
+
+
+	iterator->exclusions = exclusions;
+}
+
+/// Skips the files git ignores, as git would: Each directory's .gitignore file is compiled when the walk enters the directory and applies to everything below it,
+/// with the rules of deeper files taking precedence. Ignored directories are never opened, and neither are ".git" directories.
+/// The .gitignore files above the roots, .git/info/exclude and the global excludes of git are not read.
+/// \param iterator The iterator to skip the ignored files of. find_next() must not have been called yet.
+/// \param respect true to skip the ignored files. false to walk all files, the default.
+void find_set_gitignore(struct FindIterator* iterator, bool respect)
+{
+	assert(iterator != NULL);
+
+
+	iterator->respectGitignore = respect;
+}
+
+/// Selects the diagnostics collected by a walk. By default, errors are reported to stderr and nothing else is collected.
+/// \param iterator The iterator to collect the diagnostics for. find_next() must not have been called yet.
+/// \param diagnostics The diagnostics to collect.
+void find_set_diagnostics(struct FindIterator* iterator, const struct FindDiagnostics* diagnostics)
+{
+	assert(iterator != NULL);
+	assert(diagnostics != NULL);
+
+
+	iterator->diagnostics = *diagnostics;
+	iterator->progressCounters = (diagnostics->progress != NULL) ? GetProgressCounters(diagnostics->progress) : NULL;
+}
+
+/// Selects the members of the file information a walk reads, so that the file system is only asked for what is needed. By default, all members are read, like with lstat().
+/// \param iterator The iterator to select the members for. find_next() must not have been called yet.
+/// \param fields The FindStat* flags of the members the caller needs. The members needed by the query and the file type are always read.
+/// \param dontSync Indicates whether network file systems may answer from their cached attributes instead of revalidating them with the server (AT_STATX_DONT_SYNC), at the risk of returning outdated information.
+void find_set_stat_fields(struct FindIterator* iterator, unsigned int fields, bool dontSync)
+{
+	assert(iterator != NULL);
+
+
+	unsigned int statFields = STATX_TYPE | iterator->query->statFields;
+
+	if (fields & FindStatMode)
+		statFields |= STATX_MODE;
+
+	if (fields & FindStatOwner)
+		statFields |= STATX_UID | STATX_GID;
+
+	if (fields & FindStatSize)
+		statFields |= STATX_SIZE | STATX_BLOCKS;
+
+	if (fields & FindStatTimes)
+		statFields |= STATX_ATIME | STATX_MTIME | STATX_CTIME;
+
+	if (fields & FindStatIdentity)
+		statFields |= STATX_INO | STATX_NLINK;
+
+	iterator->statFields = statFields;
+	iterator->statFlags = dontSync ? AT_STATX_DONT_SYNC : 0;
+}
+
+/// Selects how a walk chooses its helper threads for each file system it enters. By default, the strategy is FindStrategyFixed.
+/// The helper threads started with find_set_prefetch() and find_set_stat_threads() are used on all file systems with either strategy; FindStrategyAuto only decides on the others.
+/// \param iterator The iterator to select the strategy for. find_next() must not have been called yet.
+/// \param strategy The strategy.
+void find_set_strategy(struct FindIterator* iterator, enum FindStrategy strategy)
+{
+	assert(iterator != NULL);
+
+
+	iterator->strategy = strategy;
+}
+
+/// Makes a walk perform its file system calls on a helper thread and give up on each call that does not return within the timeout.
+/// The file or directory is then reported as failed with ETIMEDOUT and skipped together with everything below it, so that e.g. a stale network mount only costs the timeout.
+/// \param iterator The iterator to set the timeout for. find_next() must not have been called yet.
+/// \param milliseconds The time to wait for each call.
+/// \return true if the helper thread has been started. Otherwise, false.
+bool find_set_call_timeout(struct FindIterator* iterator, unsigned long long milliseconds)
+{
+	assert(iterator != NULL);
+	assert(iterator->guard == NULL);
+	assert(iterator->prefetcher == NULL);
+	assert(iterator->chunkPool == NULL);
+	assert(milliseconds > 0);
+
+
+	iterator->guard = CreateCallGuard(milliseconds);
+
+	return iterator->guard != NULL;
+}
+
+/// Makes a walk read the next directories it is going to enter on a separate thread, while it is still visiting the files of the current one.
+/// The files are returned in the same order as without; Only the waiting for the file system overlaps with the walk, which pays off on file systems with a high latency per call.
+/// Must not be combined with find_set_call_timeout(), as the prefetch thread would wait for an unresponsive file system without a timeout.
+/// \param iterator The iterator to read ahead for. find_next() must not have been called yet.
+/// \param directories The number of directories to read ahead at most, between 1 and FIND_MAX_PREFETCH.
+/// \return true if the prefetch thread has been started. Otherwise, false.
+bool find_set_prefetch(struct FindIterator* iterator, unsigned int directories)
+{
+	assert(iterator != NULL);
+	assert(iterator->prefetcher == NULL);
+	assert(iterator->guard == NULL);
+	assert((directories > 0) && (directories <= FIND_MAX_PREFETCH));
+
+
+	iterator->prefetcher = StartPrefetcher(directories);
+	iterator->fixedPrefetch = true;
+
+	return iterator->prefetcher != NULL;
+}
+
+/// Makes a walk test the entries of large directories on separate threads: After reading a directory with more than FIND_CHUNK_ENTRIES entries,
+/// its entries are split into chunks of that size, whose lstat() calls and tests are claimed by whichever of the threads is idle, including the walk itself.
+/// The files are returned in the same order as without, so that a single huge directory no longer keeps one thread busy while the others wait.
+/// Must not be combined with find_set_call_timeout(), as the stat threads would wait for an unresponsive file system without a timeout.
+/// \param iterator The iterator to test the entries for. find_next() must not have been called yet.
+/// \param threads The number of stat threads besides the walk, between 1 and FIND_MAX_STAT_THREADS.
+/// \return true if the stat threads have been started. Otherwise, false.
+bool find_set_stat_threads(struct FindIterator* iterator, unsigned int threads)
+{
+	assert(iterator != NULL);
+	assert(iterator->chunkPool == NULL);
+	assert(iterator->guard == NULL);
+	assert((threads > 0) && (threads <= FIND_MAX_STAT_THREADS));
+
+
+	iterator->chunkPool = StartChunkPool(iterator->query, threads);
+	iterator->fixedStatThreads = true;
+
+	return iterator->chunkPool != NULL;
+}
+
+/// Continues the walk up to the next file that matches the query. Files are returned in the same order as they are visited: Each directory before its entries, the entries in the order returned by readdir().
+/// \param iterator The iterator to continue.
+/// \return The next matching file, which remains valid until the next call. NULL if all files below all roots have been visited or the walk has been cancelled.
+const struct FindEntry* find_next(struct FindIterator* iterator)
+{
+	assert(iterator != NULL);
+
+
+	while (true)
+	{
+		if (atomic_load_explicit(&iterator->cancelled, memory_order_relaxed))
+			return NULL;
+
+		// A directory is read right after it has been visited, so that its entries follow it
+		if (iterator->descend)
+		{
+			size_t depth = iterator->depth;
+			bool readAhead = true;
+			bool useStatThreads = true;
+			bool unresponsive = false;
+			int excludeNode = EXCLUDE_NONE;
+			size_t ignoreParent = 0;
+
+			iterator->descend = false;
+
+			// The .gitignore rules of the parent directories apply to the new one as well
+			if (depth > 0)
+			{
+				const struct FindDirectory* parent = &iterator->directories[depth - 1];
+
+				ignoreParent = (parent->ignoreRules != NULL) ? depth : parent->ignoreParent;
+			}
+
+			// The node of the directory follows from its parent's, or from the root's path for the root itself
+			if (iterator->exclusions != NULL)
+			{
+				excludeNode = (depth > 0)
+					? FindExcludeChild(iterator->exclusions->set, iterator->directories[depth - 1].excludeNode, iterator->entry.name, strlen(iterator->entry.name))
+					: iterator->rootExcludeNode;
+			}
+
+			// Without an automatic strategy, the file systems are only looked up to report them
+			if ((iterator->strategy == FindStrategyAuto) || (iterator->diagnostics.strategy != NULL))
+			{
+				const struct FindFileSystem* fileSystem = GetFileSystem(iterator);
+
+				readAhead = fileSystem->readAhead;
+				useStatThreads = fileSystem->useStatThreads;
+				unresponsive = fileSystem->unresponsive;
+			}
+
+			if (unresponsive)
+			{
+				// Reading the directory would wait for the file system as well; Skip it together with everything below it
+				if (iterator->diagnostics.errors != NULL)
+					fprintf(iterator->diagnostics.errors, "Reading directory \"%s\" has failed with error code %d: %s\n", iterator->path, ETIMEDOUT, strerror(ETIMEDOUT));
+			}
+			else
+			{
+				ReadDirectory(iterator);
+			}
+
+			// The directory has only been pushed if it could be read
+			if (iterator->depth > depth)
+			{
+				struct FindDirectory* directory = &iterator->directories[iterator->depth - 1];
+
+				directory->readAhead = readAhead;
+				directory->useStatThreads = useStatThreads;
+				directory->excludeNode = excludeNode;
+				directory->ignoreParent = ignoreParent;
+
+				// Before the entries are handed to the stat and read-ahead threads
+				if ((iterator->exclusions != NULL) || iterator->respectGitignore)
+					FilterEntries(iterator, directory);
+
+				if ((iterator->chunkPool != NULL) && useStatThreads)
+					StartChunkedDirectory(iterator, directory);
+			}
+
+			if (iterator->prefetcher != NULL)
+				RefillPrefetcher(iterator);
+		}
+
+		if (iterator->depth == 0)
+		{
+			// All files below the previous root have been visited; Continue with the next one
+			char* root = iterator->roots[iterator->nextRoot];
+
+			if (root == NULL)
+				return NULL;
+
+			iterator->nextRoot++;
+
+			if (VisitRoot(iterator, root))
+				return &iterator->entry;
+
+			continue;
+		}
+
+		struct FindDirectory* directory = &iterator->directories[iterator->depth - 1];
+
+		if (directory->nextEntry == directory->entryCount)
+		{
+			PopDirectory(iterator);
+
+			if (iterator->prefetcher != NULL)
+				RefillPrefetcher(iterator);
+
+			continue;
+		}
+
+		if (VisitDirectoryEntry(iterator, directory))
+			return &iterator->entry;
+	}
+}
+
+/// Cancels a walk. The current or next call of find_next() returns NULL without visiting any further files.
+/// May be called from any thread, e.g. once the consumer of the files has gone away.
+/// \param iterator The iterator to cancel.
+void find_cancel(struct FindIterator* iterator)
+{
+	assert(iterator != NULL);
+
+
+	atomic_store_explicit(&iterator->cancelled, true, memory_order_relaxed);
+}
+
+/// Reports the directories whose files have not all been visited yet, e.g. after the walk has been cancelled.
+/// The directories are reported in the order the walk would have continued in: First the directories it is in the middle of, from the root downwards, then the ones it has not entered yet.
+/// No file system calls are made, so that listing the directories cannot wait for an unresponsive file system once the walk has been given up on.
+/// Entries whose type readdir() has not reported are reported as possible directories.
+/// \param iterator The iterator whose remaining directories to report. Its current entry becomes invalid.
+/// \param maxDepth The depth of the deepest directories to report, e.g. 1 for the roots and the directories directly below them.
+/// \param report The function to call for each directory.
+/// \param context The context pointer passed to \p report.
+void find_unfinished(struct FindIterator* iterator, size_t maxDepth, FindUnfinished report, void* context)
+{
+	assert(iterator != NULL);
+	assert(report != NULL);
+
+
+	// A directory on the stack is finished if neither it nor any directory above it has entries left
+	size_t unfinishedDepth = iterator->descend ? iterator->depth : 0;
+
+	for (size_t i = iterator->depth; i > unfinishedDepth; i--)
+	{
+		struct FindDirectory* directory = &iterator->directories[i - 1];
+
+		if (directory->nextEntry < directory->entryCount)
+			unfinishedDepth = i;
+	}
+
+	// The directories on the stack share the leading part of the path buffer
+	for (size_t i = 0; (i < unfinishedDepth) && (i <= maxDepth); i++)
+	{
+		struct FindDirectory* directory = &iterator->directories[i];
+		char separator = iterator->path[directory->pathLength];
+
+		iterator->path[directory->pathLength] = '\0';
+		report(iterator->path, true, context);
+		iterator->path[directory->pathLength] = separator;
+	}
+
+	// The directory visited last has not been read yet
+	if (iterator->descend && (iterator->depth <= maxDepth))
+		report(iterator->entry.path, true, context);
+
+	// The remaining entries of the deepest directories come first, so that their paths can overwrite those of the directories below them
+	for (size_t i = iterator->depth; i > 0; i--)
+	{
+		struct FindDirectory* directory = &iterator->directories[i - 1];
+
+		if (i > maxDepth)
+			continue;
+
+		for (size_t j = directory->nextEntry; j < directory->entryCount; j++)
+		{
+			struct FindName* name = &directory->entries[j];
+			char* fileName = directory->names + name->offset;
+
+			AppendToPath(iterator, directory->pathLength, fileName, strlen(fileName));
+
+			// Only directories have files below them; Without the type from readdir(), the entry might be one
+			if ((name->type == DT_DIR) || (name->type == DT_UNKNOWN))
+				report(iterator->path, name->type == DT_DIR, context);
+		}
+	}
+
+	for (size_t i = iterator->nextRoot; iterator->roots[i] != NULL; i++)
+		report(iterator->roots[i], true, context);
+}
+
+/// Ends a walk and frees the iterator.
+/// \param iterator The iterator to free. May be NULL.
+void find_close(struct FindIterator* iterator)
+{
+	if (iterator == NULL)
+		return;
+
+	// The stat threads read the entries of the directories on the stack
+	FreeChunkPool(iterator->chunkPool);
+
+	if (iterator->directories != NULL)
+	{
+		for (size_t i = 0; i < iterator->directoryCapacity; i++)
+		{
+			free(iterator->directories[i].names);
+			free(iterator->directories[i].entries);
+			FreeChunkedDirectory(iterator->directories[i].chunked);
+			FreeIgnoreRules(iterator->directories[i].ignoreRules);
+		}
+	}
+
+	// Stop the helper threads before freeing the requests they might use
+	FreeCallGuard(iterator->guard);
+	FreePrefetcher(iterator->prefetcher);
+	ReleaseStatRequest(iterator->statRequest);
+	ReleaseReadRequest(iterator->readRequest);
+
+	FreeMatchCache(&iterator->cache);
+	free(iterator->fileSystems);
+	free(iterator->directories);
+	free(iterator->path);
+	free(iterator->rootName);
+	free(iterator);
+}
@@ -0,0 +1,139 @@
+/// \file libmyfind.h
+/// The directory walk of myfind as a library: Iterates over the files below a set of roots that match a query.
+
+
+
+#ifndef LIBMYFIND_H
+#define LIBMYFIND_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+
+/// The maximum number of directories a walk can read ahead, see find_set_prefetch().
+#define FIND_MAX_PREFETCH 64
+
+/// The maximum number of threads testing the entries of large directories, see find_set_stat_threads().
+#define FIND_MAX_STAT_THREADS 255
+
+/// The number of directories read ahead on file systems with a high latency per call if the caller has not chosen a number, see find_set_strategy().
+#define FIND_AUTO_PREFETCH 16
+
+/// The number of stat threads started on file systems with a high latency per call if the caller has not chosen a number, see find_set_strategy().
+#define FIND_AUTO_STAT_THREADS 8
+
+/// The ways a walk chooses its helper threads for each file system, see find_set_strategy().
+enum FindStrategy
+{
+	/// The helper threads selected with find_set_prefetch() and find_set_stat_threads() are used on all file systems.
+	FindStrategyFixed,
+
+	/// The helper threads are only used on file systems with a high latency per call, e.g. NFS, and started there with default sizes if none were selected.
+	FindStrategyAuto,
+};
+
+/// The members of FindEntry::info a caller can select with find_set_stat_fields().
+enum FindStatFields
+{
+	/// The file type in st_mode. Always read, as the walk needs it to descend into directories.
+	FindStatType = 1 << 0,
+
+	/// The permission bits in st_mode.
+	FindStatMode = 1 << 1,
+
+	/// st_uid and st_gid.
+	FindStatOwner = 1 << 2,
+
+	/// st_size and st_blocks.
+	FindStatSize = 1 << 3,
+
+	/// st_atime, st_mtime and st_ctime.
+	FindStatTimes = 1 << 4,
+
+	/// st_ino and st_nlink. st_dev is always valid.
+	FindStatIdentity = 1 << 5,
+
+	/// All members, as returned by lstat().
+	FindStatAll = (1 << 6) - 1,
+};
+
+/// A file returned by find_next(). All members point into the iterator and remain valid until the next call of find_next() or find_close().
+struct FindEntry
+{
+	/// The path of the file, starting with the root it was found below.
+	const char* path;
+
+	/// The number of characters in \p path.
+	size_t pathLength;
+
+	/// The last component of \p path.
+	const char* name;
+
+	/// The information of the file as returned by lstat(). Only the members selected with find_set_stat_fields() and those needed by the query are valid; The others are zero.
+	struct stat info;
+
+	/// The type of the file as a DT_* constant. Taken from the directory entry if the file system reports it, otherwise from \p info.
+	unsigned char type;
+
+	/// The number of directories between the root and the file. Zero for the roots themselves.
+	size_t depth;
+};
+
+/// Optional diagnostics collected while iterating. Any member may be NULL.
+struct FindDiagnostics
+{
+	/// The stream to report files and directories that could not be read to.
+	FILE* errors;
+
+	/// The report to record the time spent per directory in.
+	struct LatencyReport* latency;
+
+	/// The hardware performance counters to attribute the readdir, stat and filter phases to.
+	struct PerfCounters* perf;
+
+	/// The reporter to count directories and entries for and to publish the current directory to.
+	struct ProgressReporter* progress;
+
+	/// The stream to report each file system the walk enters to, together with the helper threads chosen for it.
+	FILE* strategy;
+};
+
+/// The function called by find_unfinished() for each directory that has not been walked completely.
+/// \param path The path of the directory, which remains valid only during the call.
+/// \param certain true if the path is known to be a directory. false if readdir() has not reported its type, so that it may be any file.
+/// \param context The context pointer that was passed to find_unfinished().
+typedef void (*FindUnfinished)(const char* path, bool certain, void* context);
+
+struct FindQuery;
+struct FindExclusions;
+struct FindIterator;
+
+int find_predicate_arguments(const char* name);
+struct FindQuery* find_compile(char* const expression[], FILE* errors);
+time_t find_query_time(const struct FindQuery* query);
+void find_free_query(struct FindQuery* query);
+
+struct FindExclusions* find_create_exclusions(void);
+bool find_load_exclusions(struct FindExclusions* exclusions, const char* fileName, FILE* errors);
+void find_free_exclusions(struct FindExclusions* exclusions);
+
+struct FindIterator* find_open(const struct FindQuery* query, char* const roots[]);
+void find_set_diagnostics(struct FindIterator* iterator, const struct FindDiagnostics* diagnostics);
+void find_set_exclusions(struct FindIterator* iterator, const struct FindExclusions* exclusions);
+void find_set_gitignore(struct FindIterator* iterator, bool respect);
+void find_set_stat_fields(struct FindIterator* iterator, unsigned int fields, bool dontSync);
+void find_set_strategy(struct FindIterator* iterator, enum FindStrategy strategy);
+bool find_set_call_timeout(struct FindIterator* iterator, unsigned long long milliseconds);
+bool find_set_prefetch(struct FindIterator* iterator, unsigned int directories);
+bool find_set_stat_threads(struct FindIterator* iterator, unsigned int threads);
+const struct FindEntry* find_next(struct FindIterator* iterator);
+void find_cancel(struct FindIterator* iterator);
+void find_unfinished(struct FindIterator* iterator, size_t maxDepth, FindUnfinished report, void* context);
+void find_close(struct FindIterator* iterator);
+
+#endif
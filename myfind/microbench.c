@@ -0,0 +1,734 @@
+/// \file microbench.c
+/// Microbenchmarks for the helper functions that myfind calls for every directory entry.
+///
+/// Each helper is timed on fixed datasets together with candidate replacements, so
+/// that the effect of a change to one of these functions can be quantified in
+/// isolation before it lands. The replacements are verified to produce the same
+/// results as the originals before they are timed.
+///
+/// The benchmark includes myfind.c and libmyfind.c directly, so that it measures
+/// exactly the code that is shipped, without exporting the helpers through a header.
+/// The path and list helpers of the recursive walk that libmyfind replaced are kept
+/// below as the baseline for their replacements.
+
+
+
+#define _GNU_SOURCE
+#define main MyfindMain
+#include "myfind.c"
+#undef main
+#include "libmyfind.c"
+
+#include <ctype.h>
+
+
+
+/// A single node in the linked list of file names.
+struct FileNode
+{
+	/// The name of the file (or directory). This member must not be NULL.
+	char* fileName;
+
+	/// A pointer to the next node in the list, or NULL if this is the last node.
+	struct FileNode* next;
+};
+
+/// Concatenates the provided path strings into a single path, adding or removing the intermediate directory separator as necessary.
+/// \param path1 The first path to combine.
+/// \param path2 The second path to combine.
+/// \return The combined path as a newly allocated string, which needs to be released with free().
+char* CombinePath(char* path1, char* path2)
+{
+	// Determine the number of characters in the input strings
+	int path1Len = strlen(path1);
+	int path2Len = strlen(path2);
+
+	// Check if both or either of the strings is empty
+	if ((path1Len == 0) && (path2Len == 0))
+	{
+		return strdup("");
+	}
+	else if (path1Len == 0)
+	{
+		return strdup(path2);
+	}
+	else if (path2Len == 0)
+	{
+		return strdup(path1);
+	}
+
+
+	// Allocate sufficient memory for concatenating the paths plus the directory separator and string terminator
+	char* combined = calloc(path1Len + path2Len + 2, sizeof(char));
+
+	ThreadStats.allocations++;
+	ThreadStats.pathBytes += path1Len + path2Len + 2;
+
+	if (combined == NULL)
+	{
+		// Out of memory
+		exit(-1);
+	}
+
+
+	// Check if the first path ends with a directory-separating slash
+	int path1HasTrailingSlash =
+		(path1Len > 0) && (path1[path1Len - 1] == '/');
+
+	// Check if the second path starts with a directory-separating slash
+	int path2HasLeadingSlash =
+		(path2Len > 0) && (path2[0] == '/');
+
+	if (path1HasTrailingSlash && path2HasLeadingSlash)
+	{
+		// Both paths contain a slash; Trim the slash from the first path and concatenate
+		strncat(combined, path1, path1Len - 1);
+		strcat(combined, path2);
+	}
+	else if (path1HasTrailingSlash || path2HasLeadingSlash)
+	{
+		// Only one path contains a slash; Concatenate the paths as they are
+		strcat(combined, path1);
+		strcat(combined, path2);
+	}
+	else
+	{
+		// Neither path contains a slash; Concatenate the paths with a slash in between
+		strcat(combined, path1);
+		strcat(combined, "/");
+		strcat(combined, path2);
+	}
+
+	return combined;
+}
+
+
+/// Creates a new file node and adds it to the linked list.
+/// \param head A pointer to the head of the linked list into which the new node should be inserted.
+/// \param fileName The file name to store in the created node.
+/// \return The created file node.
+struct FileNode* AddListNode(struct FileNode** head, char* fileName)
+{
+	assert(head != NULL);
+	assert(fileName != NULL);
+
+
+	// Create the new node
+	struct FileNode* node = malloc(sizeof(struct FileNode));
+
+	if (node == NULL)
+	{
+		// Out of memory
+		exit(-1);
+	}
+
+	node->fileName = strdup(fileName);
+	node->next = NULL;
+
+	// One allocation for the node and one for the copy of the name
+	ThreadStats.allocations += 2;
+
+
+	// Add the node to the list
+	if (*head == NULL)
+	{
+		// This is the first element
+		*head = node;
+	}
+	else
+	{
+		// Find the last node in the list
+		struct FileNode* tail = *head;
+
+		while (tail->next != NULL)
+			tail = tail->next;
+
+		// Add the new node at the end of the list
+		tail->next = node;
+	}
+
+	return node;
+}
+
+/// Frees all nodes in the provided linked list.
+/// \param head A pointer to the head of the linked list to be freed.
+void FreeList(struct FileNode** head)
+{
+	assert(head != NULL);
+
+
+	// Keep freeing nodes until all have been removed
+	while (*head != NULL)
+	{
+		// Preserve a pointer to the current head
+		struct FileNode* current = *head;
+
+		// Advance the head to the next node
+		*head = (*head)->next;
+
+		// Free the previous head
+		free(current->fileName);
+		free(current);
+	}
+}
+
+
+
+/// The minimum wall time spent on each benchmark, in nanoseconds.
+#define MICROBENCH_MIN_NANOSECONDS 200000000ULL
+
+/// The number of path depths for which the path helpers are measured.
+#define MICROBENCH_DEPTH_COUNT 4
+
+/// File names as they occur in typical source trees, configuration directories and home directories.
+static const char* MicrobenchNames[] =
+{
+	"Makefile", "README", "README.md", "LICENSE", "COPYING", "CMakeLists.txt", "configure", "configure.ac",
+	"main.c", "main.h", "util.c", "util.h", "parser.c", "parser.h", "lexer.l", "grammar.y",
+	"index.js", "package.json", "package-lock.json", "node_modules", "tsconfig.json", "webpack.config.js",
+	"__init__.py", "setup.py", "requirements.txt", "test_parser.py", "conftest.py", "__pycache__",
+	"Cargo.toml", "Cargo.lock", "lib.rs", "mod.rs", "build.rs", "target",
+	"pom.xml", "build.gradle", "Main.java", "AbstractSingletonProxyFactoryBean.java",
+	".git", ".gitignore", ".gitattributes", ".editorconfig", ".clang-format", ".travis.yml",
+	"HEAD", "ORIG_HEAD", "config", "description", "packed-refs", "FETCH_HEAD",
+	"2f4e2dc1a9b8c7d6e5f4a3b2c1d0e9f8a7b6c5d", "pack-9e1c3f7b2a4d6e8f0a1b3c5d7e9f1a3b5c7d9e1f.idx",
+	"passwd", "group", "shadow", "hosts", "resolv.conf", "fstab", "nsswitch.conf", "sshd_config",
+	"libc.so.6", "libpthread.so.0", "ld-linux-x86-64.so.2", "libstdc++.so.6.0.30",
+	"vmlinuz-6.1.0-18-amd64", "initrd.img-6.1.0-18-amd64", "System.map-6.1.0-18-amd64",
+	"IMG_20180331_142536.jpg", "Screenshot from 2018-03-31 14-25-36.png", "Thesis_final_v3 (1).docx",
+	"a", "b", "x", "foo", "bar", "tmp", "core", "nohup.out",
+	"access.log", "access.log.1", "access.log.2.gz", "error.log", "syslog", "kern.log", "dmesg",
+	"font.ttf", "icon-48x48.png", "favicon.ico", "style.min.css", "bundle.3f9a1c.js", "index.html",
+	"%s", "%*u", "%x", "dangling-sym-link", "file with spaces", "-rf", "..hidden", "trailing.",
+};
+
+/// The number of entries in \p MicrobenchNames.
+#define MICROBENCH_NAME_COUNT (sizeof(MicrobenchNames) / sizeof(MicrobenchNames[0]))
+
+/// The glob patterns used to measure the name filter, from literal names to patterns with several wildcards.
+static const char* MicrobenchPatterns[] =
+{
+	"Makefile", "*.c", "*.log*", "lib*.so.?", "[A-Z]*.java", "*test*",
+};
+
+/// The number of entries in \p MicrobenchPatterns.
+#define MICROBENCH_PATTERN_COUNT (sizeof(MicrobenchPatterns) / sizeof(MicrobenchPatterns[0]))
+
+/// The file type arguments used to measure ParseFileTypes().
+static const char* MicrobenchFileTypes[] =
+{
+	"f", "d", "fd", "bcdpfls", "l",
+};
+
+/// The number of entries in \p MicrobenchFileTypes.
+#define MICROBENCH_FILE_TYPE_COUNT (sizeof(MicrobenchFileTypes) / sizeof(MicrobenchFileTypes[0]))
+
+/// The directory depths at which the path helpers are measured.
+static const int MicrobenchDepths[MICROBENCH_DEPTH_COUNT] = { 1, 4, 16, 64 };
+
+/// Accumulates results of the measured functions, so that the compiler cannot discard the calls.
+static volatile size_t MicrobenchSink;
+
+/// A single node of the replacement list, storing the file name in the same allocation.
+struct InlineFileNode
+{
+	/// A pointer to the next node in the list, or NULL if this is the last node.
+	struct InlineFileNode* next;
+
+	/// The name of the file, stored directly after the node.
+	char fileName[];
+};
+
+/// A list of file names with a pointer to its last node, so that appending does not need to walk the list.
+struct FileList
+{
+	/// The first node of the list, or NULL if the list is empty.
+	struct InlineFileNode* head;
+
+	/// The last node of the list, or NULL if the list is empty.
+	struct InlineFileNode* tail;
+};
+
+
+
+/// Replacement for CombinePath(): Concatenates the paths with a single memcpy() each, based on lengths that are computed only once.
+char* CombinePathConcat(char* path1, char* path2)
+{
+	size_t path1Len = strlen(path1);
+	size_t path2Len = strlen(path2);
+
+	// Drop a trailing slash of the first path if the second one brings its own
+	bool path1HasTrailingSlash = (path1Len > 0) && (path1[path1Len - 1] == '/');
+	bool path2HasLeadingSlash = (path2Len > 0) && (path2[0] == '/');
+
+	if (path1HasTrailingSlash && path2HasLeadingSlash)
+		path1Len--;
+
+	bool needsSeparator = (path1Len > 0) && (path2Len > 0) && !path1HasTrailingSlash && !path2HasLeadingSlash;
+
+	char* combined = malloc(path1Len + needsSeparator + path2Len + 1);
+
+	if (combined == NULL)
+		exit(-1);
+
+	memcpy(combined, path1, path1Len);
+
+	if (needsSeparator)
+		combined[path1Len] = '/';
+
+	memcpy(combined + path1Len + needsSeparator, path2, path2Len + 1);
+
+	return combined;
+}
+
+/// Replacement for AddListNode(): Appends in constant time and stores the name in the node's allocation.
+struct InlineFileNode* AppendFileList(struct FileList* list, char* fileName)
+{
+	size_t length = strlen(fileName);
+	struct InlineFileNode* node = malloc(sizeof(struct InlineFileNode) + length + 1);
+
+	if (node == NULL)
+		exit(-1);
+
+	node->next = NULL;
+	memcpy(node->fileName, fileName, length + 1);
+
+	if (list->tail == NULL)
+		list->head = node;
+	else
+		list->tail->next = node;
+
+	list->tail = node;
+
+	return node;
+}
+
+/// Replacement for FreeList(): A single free() per node.
+void FreeFileList(struct FileList* list)
+{
+	struct InlineFileNode* node = list->head;
+
+	while (node != NULL)
+	{
+		struct InlineFileNode* next = node->next;
+
+		free(node);
+		node = next;
+	}
+
+	list->head = NULL;
+	list->tail = NULL;
+}
+
+/// Replacement for ParseFileTypes(): Stops at the terminator instead of calling strlen() in every iteration.
+bool ParseFileTypesTable(char* fileTypeChars, enum FileTypes* fileTypes)
+{
+	*fileTypes = None;
+
+	for (char* c = fileTypeChars; *c != '\0'; c++)
+	{
+		switch (*c)
+		{
+		case 'b': *fileTypes |= BlockSpecialFile; break;
+		case 'c': *fileTypes |= CharacterSpecialFile; break;
+		case 'd': *fileTypes |= Directory; break;
+		case 'p': *fileTypes |= NamedPipe; break;
+		case 'f': *fileTypes |= RegularFile; break;
+		case 'l': *fileTypes |= SymbolicLink; break;
+		case 's': *fileTypes |= Socket; break;
+		default: return false;
+		}
+	}
+
+	return true;
+}
+
+/// The name filter as applied by ShouldPrintFileInformation(): basename() of the path followed by fnmatch().
+bool MatchNameBasename(char* filePath, const char* pattern)
+{
+	return fnmatch(pattern, basename(filePath), 0) == 0;
+}
+
+/// Replacement for the name filter: Finds the name with strrchr() and compares literal patterns and "*<suffix>" patterns without fnmatch().
+bool MatchNameFastPath(char* filePath, const char* pattern)
+{
+	char* slash = strrchr(filePath, '/');
+	char* name = (slash != NULL) ? slash + 1 : filePath;
+
+	// A pattern without any special characters can only match itself
+	if (strpbrk(pattern, "*?[\\") == NULL)
+		return strcmp(name, pattern) == 0;
+
+	// A single leading asterisk followed by a literal is a suffix comparison
+	if ((pattern[0] == '*') && (strpbrk(pattern + 1, "*?[\\") == NULL))
+	{
+		size_t nameLength = strlen(name);
+		size_t suffixLength = strlen(pattern + 1);
+
+		// fnmatch() without FNM_PERIOD lets the asterisk match a leading period as well
+		return (nameLength >= suffixLength) && (memcmp(name + nameLength - suffixLength, pattern + 1, suffixLength) == 0);
+	}
+
+	return fnmatch(pattern, name, 0) == 0;
+}
+
+
+/// Builds a directory path with the specified number of components.
+/// \param depth The number of directory components.
+/// \return The newly allocated path, e.g. "/usr/src/linux/..." for a depth of three.
+char* BuildMicrobenchPath(int depth)
+{
+	char* path = strdup("");
+
+	for (int i = 0; i < depth; i++)
+	{
+		const char* component = MicrobenchNames[(i * 7) % MICROBENCH_NAME_COUNT];
+		size_t length = strlen(path);
+		char* longer = malloc(length + strlen(component) + 2);
+
+		if (longer == NULL)
+			exit(-1);
+
+		sprintf(longer, "%s/%s", path, component);
+		free(path);
+		path = longer;
+	}
+
+	return path;
+}
+
+/// Prints the result of a single benchmark.
+/// \param name The name of the benchmark.
+/// \param nanoseconds The total time spent.
+/// \param operations The number of operations performed in that time.
+void PrintMicrobenchResult(const char* name, uint64_t nanoseconds, unsigned long long operations)
+{
+	printf("%-44s %12.1f ns/op %14llu ops\n", name, (double) nanoseconds / operations, operations);
+}
+
+
+/// Measures CombinePath() and its replacement for the directory depths in \p MicrobenchDepths.
+void BenchmarkCombinePath()
+{
+	for (int d = 0; d < MICROBENCH_DEPTH_COUNT; d++)
+	{
+		char* directoryPath = BuildMicrobenchPath(MicrobenchDepths[d]);
+		char name[64];
+
+		// Make sure that the replacement produces identical paths, including the corner cases
+		char* corners[][2] = { { directoryPath, "x" }, { "/", "x" }, { "a/", "/b" }, { "", "b" }, { "a", "" }, { "", "" } };
+
+		for (size_t i = 0; i < sizeof(corners) / sizeof(corners[0]); i++)
+		{
+			char* expected = CombinePath(corners[i][0], corners[i][1]);
+			char* actual = CombinePathConcat(corners[i][0], corners[i][1]);
+
+			if (strcmp(expected, actual) != 0)
+			{
+				fprintf(stderr, "microbench: CombinePathConcat(\"%s\", \"%s\") returned \"%s\" instead of \"%s\".\n", corners[i][0], corners[i][1], actual, expected);
+				exit(1);
+			}
+
+			free(expected);
+			free(actual);
+		}
+
+		char* (*functions[])(char*, char*) = { CombinePath, CombinePathConcat };
+		const char* functionNames[] = { "CombinePath", "CombinePathConcat" };
+
+		for (int f = 0; f < 2; f++)
+		{
+			unsigned long long operations = 0;
+			uint64_t start = GetMonotonicNanoseconds();
+			uint64_t elapsed = 0;
+
+			while (elapsed < MICROBENCH_MIN_NANOSECONDS)
+			{
+				for (size_t i = 0; i < MICROBENCH_NAME_COUNT; i++)
+				{
+					char* combined = functions[f](directoryPath, (char*) MicrobenchNames[i]);
+
+					MicrobenchSink += combined[0];
+					free(combined);
+				}
+
+				operations += MICROBENCH_NAME_COUNT;
+				elapsed = GetMonotonicNanoseconds() - start;
+			}
+
+			snprintf(name, sizeof(name), "%s depth=%d", functionNames[f], MicrobenchDepths[d]);
+			PrintMicrobenchResult(name, elapsed, operations);
+		}
+
+		free(directoryPath);
+	}
+}
+
+/// Measures building and freeing a list of directory entries with AddListNode()/FreeList() and their replacements.
+void BenchmarkFileList()
+{
+	static const size_t entryCounts[] = { 16, 1024, 16384 };
+
+	for (size_t c = 0; c < sizeof(entryCounts) / sizeof(entryCounts[0]); c++)
+	{
+		size_t entryCount = entryCounts[c];
+		char name[64];
+		unsigned long long operations = 0;
+		uint64_t start = GetMonotonicNanoseconds();
+		uint64_t elapsed = 0;
+
+		while (elapsed < MICROBENCH_MIN_NANOSECONDS)
+		{
+			struct FileNode* head = NULL;
+
+			for (size_t i = 0; i < entryCount; i++)
+				AddListNode(&head, (char*) MicrobenchNames[i % MICROBENCH_NAME_COUNT]);
+
+			MicrobenchSink += head->fileName[0];
+			FreeList(&head);
+
+			operations += entryCount;
+			elapsed = GetMonotonicNanoseconds() - start;
+		}
+
+		snprintf(name, sizeof(name), "AddListNode+FreeList entries=%zu", entryCount);
+		PrintMicrobenchResult(name, elapsed, operations);
+
+		operations = 0;
+		start = GetMonotonicNanoseconds();
+		elapsed = 0;
+
+		while (elapsed < MICROBENCH_MIN_NANOSECONDS)
+		{
+			struct FileList list = { NULL, NULL };
+
+			for (size_t i = 0; i < entryCount; i++)
+				AppendFileList(&list, (char*) MicrobenchNames[i % MICROBENCH_NAME_COUNT]);
+
+			MicrobenchSink += list.head->fileName[0];
+			FreeFileList(&list);
+
+			operations += entryCount;
+			elapsed = GetMonotonicNanoseconds() - start;
+		}
+
+		snprintf(name, sizeof(name), "AppendFileList+FreeFileList entries=%zu", entryCount);
+		PrintMicrobenchResult(name, elapsed, operations);
+	}
+}
+
+/// Measures ParseFileTypes() and its replacement.
+void BenchmarkParseFileTypes()
+{
+	bool (*functions[])(char*, enum FileTypes*) = { ParseFileTypes, ParseFileTypesTable };
+	const char* functionNames[] = { "ParseFileTypes", "ParseFileTypesTable" };
+
+	// Make sure that the replacement parses all arguments identically, including invalid ones
+	const char* checks[] = { "f", "bcdpfls", "", "x", "fx" };
+
+	for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++)
+	{
+		enum FileTypes expected;
+		enum FileTypes actual;
+		bool expectedResult = ParseFileTypes((char*) checks[i], &expected);
+		bool actualResult = ParseFileTypesTable((char*) checks[i], &actual);
+
+		if ((expectedResult != actualResult) || (expectedResult && (expected != actual)))
+		{
+			fprintf(stderr, "microbench: ParseFileTypesTable(\"%s\") differs from ParseFileTypes().\n", checks[i]);
+			exit(1);
+		}
+	}
+
+	for (int f = 0; f < 2; f++)
+	{
+		unsigned long long operations = 0;
+		uint64_t start = GetMonotonicNanoseconds();
+		uint64_t elapsed = 0;
+
+		while (elapsed < MICROBENCH_MIN_NANOSECONDS)
+		{
+			for (size_t i = 0; i < MICROBENCH_FILE_TYPE_COUNT; i++)
+			{
+				enum FileTypes fileTypes;
+
+				MicrobenchSink += functions[f]((char*) MicrobenchFileTypes[i], &fileTypes) + fileTypes;
+			}
+
+			operations += MICROBENCH_FILE_TYPE_COUNT;
+			elapsed = GetMonotonicNanoseconds() - start;
+		}
+
+		PrintMicrobenchResult(functionNames[f], elapsed, operations);
+	}
+}
+
+/// Measures the fnmatch() based name filter and its replacement for each pattern in \p MicrobenchPatterns.
+void BenchmarkNameFilter()
+{
+	char* directoryPath = BuildMicrobenchPath(MicrobenchDepths[1]);
+	char* paths[MICROBENCH_NAME_COUNT];
+
+	for (size_t i = 0; i < MICROBENCH_NAME_COUNT; i++)
+		paths[i] = CombinePath(directoryPath, (char*) MicrobenchNames[i]);
+
+	bool (*functions[])(char*, const char*) = { MatchNameBasename, MatchNameFastPath };
+	const char* functionNames[] = { "fnmatch(basename())", "MatchNameFastPath" };
+
+	for (size_t p = 0; p < MICROBENCH_PATTERN_COUNT; p++)
+	{
+		const char* pattern = MicrobenchPatterns[p];
+		char name[64];
+
+		// Make sure that the replacement selects the same names
+		for (size_t i = 0; i < MICROBENCH_NAME_COUNT; i++)
+		{
+			if (MatchNameBasename(paths[i], pattern) != MatchNameFastPath(paths[i], pattern))
+			{
+				fprintf(stderr, "microbench: MatchNameFastPath(\"%s\", \"%s\") differs from fnmatch().\n", paths[i], pattern);
+				exit(1);
+			}
+		}
+
+		for (int f = 0; f < 2; f++)
+		{
+			unsigned long long operations = 0;
+			uint64_t start = GetMonotonicNanoseconds();
+			uint64_t elapsed = 0;
+
+			while (elapsed < MICROBENCH_MIN_NANOSECONDS)
+			{
+				for (size_t i = 0; i < MICROBENCH_NAME_COUNT; i++)
+					MicrobenchSink += functions[f](paths[i], pattern);
+
+				operations += MICROBENCH_NAME_COUNT;
+				elapsed = GetMonotonicNanoseconds() - start;
+			}
+
+			snprintf(name, sizeof(name), "%s \"%s\"", functionNames[f], pattern);
+			PrintMicrobenchResult(name, elapsed, operations);
+		}
+	}
+
+	for (size_t i = 0; i < MICROBENCH_NAME_COUNT; i++)
+		free(paths[i]);
+
+	free(directoryPath);
+}
+
+/// Baseline for FoldAscii(): Folds one byte at a time with tolower(), as fnmatch(FNM_CASEFOLD) does.
+bool FoldTolower(const char* source, size_t length, char* destination)
+{
+	bool ascii = true;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		unsigned char c = (unsigned char) source[i];
+
+		ascii = ascii && (c < 0x80);
+		destination[i] = (char) tolower(c);
+	}
+
+	return ascii;
+}
+
+/// Measures the case folding of "-iname" and "-ipath" on names and on paths at the depths in \p MicrobenchDepths.
+void BenchmarkCaseFold()
+{
+	bool (*functions[])(const char*, size_t, char*) = { FoldTolower, FoldAscii };
+	const char* functionNames[] = { "FoldTolower", "FoldAscii" };
+	char name[64];
+
+	for (int d = -1; d < MICROBENCH_DEPTH_COUNT; d++)
+	{
+		// The names alone first, then the paths of the names below directories of increasing depth
+		char* directoryPath = (d >= 0) ? BuildMicrobenchPath(MicrobenchDepths[d]) : NULL;
+		char* strings[MICROBENCH_NAME_COUNT];
+		size_t lengths[MICROBENCH_NAME_COUNT];
+		size_t maxLength = 0;
+
+		for (size_t i = 0; i < MICROBENCH_NAME_COUNT; i++)
+		{
+			strings[i] = (d >= 0) ? CombinePath(directoryPath, (char*) MicrobenchNames[i]) : strdup(MicrobenchNames[i]);
+			lengths[i] = strlen(strings[i]);
+			maxLength = (lengths[i] > maxLength) ? lengths[i] : maxLength;
+		}
+
+		char* expected = malloc(maxLength + 1);
+		char* folded = malloc(maxLength + 1);
+
+		if ((expected == NULL) || (folded == NULL))
+			exit(-1);
+
+		// Make sure that the replacement folds the same way
+		for (size_t i = 0; i < MICROBENCH_NAME_COUNT; i++)
+		{
+			if ((FoldTolower(strings[i], lengths[i], expected) != FoldAscii(strings[i], lengths[i], folded)) || (memcmp(expected, folded, lengths[i]) != 0))
+			{
+				fprintf(stderr, "microbench: FoldAscii(\"%s\") differs from tolower().\n", strings[i]);
+				exit(1);
+			}
+		}
+
+		for (int f = 0; f < 2; f++)
+		{
+			unsigned long long operations = 0;
+			uint64_t start = GetMonotonicNanoseconds();
+			uint64_t elapsed = 0;
+
+			while (elapsed < MICROBENCH_MIN_NANOSECONDS)
+			{
+				for (size_t i = 0; i < MICROBENCH_NAME_COUNT; i++)
+					MicrobenchSink += functions[f](strings[i], lengths[i], folded) + (unsigned char) folded[0];
+
+				operations += MICROBENCH_NAME_COUNT;
+				elapsed = GetMonotonicNanoseconds() - start;
+			}
+
+			if (d >= 0)
+				snprintf(name, sizeof(name), "%s (depth %d)", functionNames[f], MicrobenchDepths[d]);
+			else
+				snprintf(name, sizeof(name), "%s (names)", functionNames[f]);
+
+			PrintMicrobenchResult(name, elapsed, operations);
+		}
+
+		for (size_t i = 0; i < MICROBENCH_NAME_COUNT; i++)
+			free(strings[i]);
+
+		free(expected);
+		free(folded);
+		free(directoryPath);
+	}
+}
+
+
+/// The entry point of the microbenchmark.
+/// \param argc The number of command line arguments in \p argv.
+/// \param argv The array of command line arguments. The optional first argument selects a single benchmark by name.
+/// \return Zero if all benchmarks were run. One if a replacement produced a different result than the original.
+int main(int argc, char* argv[])
+{
+	const char* selected = (argc > 1) ? argv[1] : NULL;
+
+	struct
+	{
+		const char* name;
+		void (*run)();
+	} benchmarks[] =
+	{
+		{ "CombinePath", BenchmarkCombinePath },
+		{ "FileList", BenchmarkFileList },
+		{ "ParseFileTypes", BenchmarkParseFileTypes },
+		{ "NameFilter", BenchmarkNameFilter },
+		{ "CaseFold", BenchmarkCaseFold },
+	};
+
+	for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+	{
+		if ((selected == NULL) || (strcmp(selected, benchmarks[i].name) == 0))
+			benchmarks[i].run();
+	}
+
+	return 0;
+}
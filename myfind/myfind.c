@@ -24,29 +24,55 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <sys/queue.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <locale.h>
+
+#include "libmyfind.h"
+#include "hash.h"
+#include "pool.h"
+#include "scan.h"
+#include "stats.h"
+#include "latency.h"
+#include "perf.h"
+#include "progress.h"
+#include "output.h"
+#include "deadline.h"
+
+
+
+/// Contains flags selecting the diagnostic information printed with "-D".
+enum DebugOptions
+{
+	/// No diagnostic information is printed.
+	DebugNone = 0,
+
+	/// Counters describing the work done during the search are printed at exit.
+	DebugStats = 1 << 0,
 
+	/// The distribution of the time spent per directory and the slowest directories are printed at exit.
+	DebugLatency = 1 << 1,
 
+	/// Hardware performance counters for the whole search and per phase are printed at exit, if available.
+	DebugPerf = 1 << 2,
+
+	/// The type of each file system entered and the helper threads chosen for it are printed when it is entered.
+	DebugStrategy = 1 << 3,
+};
 
-/// Contains flags indicating the file types to be printed in the application's output.
-enum FileTypes
+/// The algorithms that can be used to compute the checksums of the found files.
+enum ChecksumAlgorithms
 {
-	/// No filtering by file type.
-	None = 0,
+	/// No checksums are computed.
+	NoChecksum = 0,
 
-	/// Block special files should be printed.
-	BlockSpecialFile = 1 << 0,
-	/// Character special files should be printed.
-	CharacterSpecialFile = 1 << 1,
-	/// Directories should be printed.
-	Directory = 1 << 2,
-	/// Named pipes should be printed.
-	NamedPipe = 1 << 3,
-	/// Regular files should be printed.
-	RegularFile = 1 << 4,
-	/// Symbolic links should be printed.
-	SymbolicLink = 1 << 5,
-	/// Sockets should be printed.
-	Socket = 1 << 6,
+	/// The fast, non-cryptographic 64 bit XXH64 hash.
+	ChecksumXXH64,
+
+	/// The cryptographic SHA-256 digest.
+	ChecksumSHA256,
 };
 
 /// The command line arguments provided to the application at startup.
@@ -58,80 +84,283 @@ struct Args
 	/// Indicates whether the output should be printed in extended list format.
 	bool printInExtendedFormat;
 
-	/// Indicates whether only files of the types specified in \p fileTypes should be printed.
-	bool filterByFileType;
-	/// Only files with the types specified in this set of flags will be printed. This member is only valid if \p filterByFileType is true.
-	enum FileTypes fileTypes;
+	/// The criteria by which the files to be printed are selected, compiled from \p expression. NULL until all arguments have been parsed.
+	struct FindQuery* query;
+
+	/// The predicates and their arguments collected while parsing the command line. NULL once they have been compiled into \p query.
+	char** expression;
+
+	/// The number of elements in \p expression.
+	size_t expressionLength;
+
+	/// The distributions accumulated over all matching files if the summary mode was requested. NULL if the files should be printed individually.
+	struct Summary* summary;
+
+	/// Indicates whether only regular files containing the literal specified in \p contentLiteral should be printed.
+	bool filterForContent;
+
+	/// Only regular files containing this byte sequence will be printed. This member is only valid if \p filterForContent is true.
+	char* contentLiteral;
+
+	/// The number of bytes in \p contentLiteral.
+	size_t contentLiteralLength;
+
+	/// The algorithm used to compute the checksums printed next to the paths of the found regular files.
+	enum ChecksumAlgorithms checksumAlgorithm;
+
+	/// The worker threads searching or hashing the content of the files that match all other criteria. NULL if no content has to be read.
+	struct OrderedPipeline* contentPipeline;
+
+	/// The regular files collected for the duplicate search if the duplicates mode was requested. NULL if the files should be printed individually.
+	struct DuplicateSet* duplicates;
+
+	/// The maximum number of threads used to read file contents. Zero if the number of processors available to the process should be used.
+	unsigned int threadCount;
+
+	/// Indicates whether the number of threads reading file contents is adjusted to the observed throughput, as specified with "-threads auto".
+	bool adaptiveThreads;
 
-	/// Indicates whether only files belonging to a user with the ID specified in \p userID should be printed. This member has precedence over \p filterUserName and \p filterForNoUser.
-	bool filterByUserID;
+	/// The diagnostic information to print, as specified with "-D".
+	enum DebugOptions debugOptions;
 
-	/// Only files belonging to a user with this ID will be printed. This member is only valid if \p filterByUserID is true.
-	int userID;
+	/// The number of slowest directories listed in the latency report.
+	size_t slowestDirectoryCount;
 
-	/// Indicates whether only files not belonging to any user should be printed.
-	bool filterForNoUser;
+	/// The time spent per directory. NULL unless DebugLatency is set in \p debugOptions.
+	struct LatencyReport* latency;
 
-	/// Indicates whether only files belonging to a group with the ID specified in \p groupID should be printed. This member has precedence over \p filterGroupName and \p filterForNoGroup.
-	bool filterByGroupID;
+	/// Indicates whether the progress of the search should be reported periodically.
+	bool showProgress;
 
-	/// Only files belonging to a group with this ID will be printed. This member is only valid if \p filterBygroupID is true.
-	int groupID;
+	/// The thread reporting the progress of the search. NULL unless \p showProgress is set.
+	struct ProgressReporter* progress;
 
-	/// Indicates whether only files not belonging to any group should be printed.
-	bool filterForNoGroup;
+	/// The counters of \p progress, cached to keep their increments cheap. NULL unless \p showProgress is set.
+	struct ProgressCounters* progressCounters;
 
-	/// Indicates whether only files with names that match the pattern specified in \p namePattern should be printed.
-	bool filterForNamePattern;
+	/// The hardware performance counters of the search. NULL unless DebugPerf is set in \p debugOptions and the counters are available.
+	struct PerfCounters* perf;
 
-	/// Only files whose name matches this pattern will be printed. This member is only valid if \p filterForNamePattern is true.
-	char* namePattern;
+	/// The error code of the first failed write to stdout, e.g. EPIPE once the reader has gone away. Zero while the output is fine.
+	atomic_int outputError;
 
-	/// Indicates whether only files where the whole path matches the pattern specified in \p pathPattern should be printed.
-	bool filterForPathPattern;
+	/// The running search, which is cancelled once the output has failed or the time limit has passed. NULL outside of SearchFiles().
+	struct FindIterator* iterator;
 
-	/// Only files where the whole path matches this pattern will be printed. This member is only valid if \p filterForPathPattern is true.
-	char* pathPattern;
+	/// The time limit of the search in milliseconds, as specified with "-timeout". Zero if the search is not limited.
+	unsigned long long timeoutMilliseconds;
+
+	/// Indicates whether the search has been stopped because of \p timeoutMilliseconds.
+	atomic_bool timedOut;
+
+	/// The time to wait for each file system call in milliseconds, as specified with "-io-timeout". Zero if the calls are made directly.
+	unsigned long long callTimeoutMilliseconds;
+
+	/// The number of directories to read ahead of the search, as specified with "-prefetch". Zero if directories are only read when the search reaches them.
+	unsigned int prefetchDirectories;
+
+	/// The number of threads testing the entries of large directories besides the search, as specified with "-stat-threads". Zero if all entries are tested by the search itself.
+	unsigned int statThreads;
+
+	/// Indicates whether network file systems may answer from their cached file attributes, as specified with "-dont-sync".
+	bool dontSync;
+
+	/// Indicates whether the helper threads are used on all file systems, as specified with "-strategy fixed", instead of only where they pay off.
+	bool fixedStrategy;
+
+	/// The files skipped by the search, as loaded from the lists specified with "--exclude-from". NULL if none are excluded.
+	struct FindExclusions* exclusions;
+
+	/// Indicates whether the files ignored by git are skipped, as specified with "--respect-gitignore".
+	bool respectGitignore;
 };
 
-/// A single node in the linked list of file names.
-struct FileNode
+/// The number of log2 buckets in the file size histogram. Bucket 0 holds empty files, bucket n holds sizes in [2^(n-1), 2^n).
+#define SUMMARY_SIZE_BUCKETS 65
+
+/// The number of buckets in the file age histogram.
+#define SUMMARY_AGE_BUCKETS 10
+
+/// The number of distinct file types counted in the summary.
+#define SUMMARY_TYPE_COUNT 8
+
+/// The maximum number of owners listed individually in the summary report.
+#define SUMMARY_MAX_OWNERS 20
+
+/// The number of files belonging to a single user.
+struct OwnerCount
 {
-	/// The name of the file (or directory). This member must not be NULL.
-	char* fileName;
+	/// The user ID of the owner.
+	uid_t userID;
 
-	/// A pointer to the next node in the list, or NULL if this is the last node.
-	struct FileNode* next;
+	/// The number of files belonging to the owner. Zero if this slot of the hash table is unused.
+	unsigned long long fileCount;
+
+	/// The total size in bytes of the files belonging to the owner.
+	unsigned long long byteCount;
 };
 
-void PrintUsage();
+/// The distributions accumulated over all matching files in summary mode.
+struct Summary
+{
+	/// The point in time against which the age of the files is measured.
+	time_t referenceTime;
 
-bool ParseCommandLineArgs(char* argv[], struct Args *args);
-bool ConvertToInteger(char* s, int* i);
-bool ConvertToIntegerGroup(char* s, int* i);
-bool QueryUserID(char* userName, int* userID);
-bool QueryGroupID(char* groupName, int* groupID);
-bool ParseFileTypes(char* fileTypeChars, enum FileTypes* fileTypes);
+	/// The total number of matching files.
+	unsigned long long fileCount;
 
-void SearchFile(char* file_name, struct Args* args);
-void SearchDirectory(char* dir_name, struct Args* args);
+	/// The total size in bytes of all matching files.
+	unsigned long long byteCount;
 
-char* CombinePath(char* path1, char* path2);
+	/// The number of files per log2 size bucket.
+	unsigned long long sizeBuckets[SUMMARY_SIZE_BUCKETS];
 
-struct FileNode* AddListNode(struct FileNode** head, char* fileName);
-void FreeList(struct FileNode** head);
+	/// The number of files per age bucket, based on the time of the last modification.
+	unsigned long long ageBuckets[SUMMARY_AGE_BUCKETS];
+
+	/// The number of files per file type, indexed by the value returned from GetSummaryTypeIndex().
+	unsigned long long typeCounts[SUMMARY_TYPE_COUNT];
+
+	/// An open addressing hash table of the number of files per owner. The capacity is always a power of two.
+	struct OwnerCount* owners;
+
+	/// The number of slots in \p owners.
+	size_t ownerCapacity;
+
+	/// The number of used slots in \p owners.
+	size_t ownerCount;
+};
+
+/// The number of bytes at the beginning of a file that are hashed to rule out most duplicate candidates cheaply.
+#define DUPLICATE_PREFIX_SIZE 4096
+
+/// The size in bytes of the buffer used for reading complete files.
+#define DUPLICATE_READ_SIZE (1024 * 1024)
+
+/// A regular file that might have the same content as another file.
+struct DuplicateCandidate
+{
+	/// The path of the file.
+	char* filePath;
+
+	/// The size of the file in bytes.
+	off_t size;
+
+	/// The device containing the file. Used together with \p inode to recognize hard links.
+	dev_t device;
+
+	/// The inode number of the file.
+	ino_t inode;
+
+	/// The hash value of the first DUPLICATE_PREFIX_SIZE bytes of the file.
+	uint64_t prefixHash;
+
+	/// The hash value of the entire file. Only valid once the prefix hash matched the one of another file.
+	uint64_t contentHash;
+
+	/// Indicates whether reading the file has failed, which excludes it from the result.
+	bool readFailed;
+};
+
+/// The regular files collected for the duplicate search.
+struct DuplicateSet
+{
+	/// The array of candidate files.
+	struct DuplicateCandidate* candidates;
+
+	/// The number of used elements in \p candidates.
+	size_t count;
+
+	/// The number of allocated elements in \p candidates.
+	size_t capacity;
+};
+
+/// The number of bytes read from a file per call while searching its content.
+#define CONTENT_READ_SIZE (1024 * 1024)
+
+/// The maximum number of threads reading file contents per available processor with "-threads auto". Network file systems need many requests in flight.
+#define CONTENT_ADAPTIVE_THREADS_PER_PROCESSOR 8
+
+/// A file that matches all criteria except for its content, waiting to be searched by a worker thread.
+struct ContentJob
+{
+	/// The path of the file.
+	char* filePath;
+
+	/// The information of the file as returned by stat().
+	struct stat fileInfo;
+
+	/// Indicates whether the content of the file contains the literal. Only valid once the job has been processed.
+	bool matched;
+
+	/// The hexadecimal checksum of the file's content. Empty if no checksum was requested or reading the file has failed.
+	char checksum[SHA256_DIGEST_SIZE * 2 + 1];
+};
+
+void PrintUsage();
+void FreeArgs(struct Args* args);
 
-bool ShouldPrintFileInformation(char* filePath, struct stat* fileInformation, struct Args* args);
-void PrintFileInformation(char* filePath, struct stat* fileInformation, struct Args* args);
+bool ParseCommandLineArgs(char* argv[], struct Args *args);
+bool ParseDebugOptions(char* optionList, struct Args* args);
+bool ParseDuration(const char* text, unsigned long long* milliseconds);
+
+bool SearchFiles(char* searchPath, struct Args* args);
+void HandleMatchingFile(const struct FindEntry* entry, struct Args* args);
+void CancelSearch(struct Args* args);
+void StopOnOutputError(struct Args* args, int error);
+void OnDeadlineExpired(void* context);
+void PrintUnfinishedDirectory(const char* path, bool certain, void* context);
+void OnOutputClosed(void* context);
+bool CheckOutput(struct Args* args);
+void ProcessMatchingFile(const char* filePath, const struct stat* fileInformation, char* checksum, struct Args* args);
+
+void PrintFileInformation(const char* filePath, const struct stat* fileInformation, struct Args* args);
+
+void ProcessContentJob(void* item, void* buffer, void* context);
+void EmitContentJob(void* item, void* context);
+bool FileContainsLiteral(char* filePath, char* literal, size_t literalLength, char* buffer);
+bool ComputeChecksum(char* filePath, enum ChecksumAlgorithms algorithm, char* buffer, char* checksum);
+
+struct Summary* CreateSummary();
+void FreeSummary(struct Summary* summary);
+void AddToSummary(struct Summary* summary, const struct stat* fileInformation);
+struct OwnerCount* FindOwnerCount(struct Summary* summary, uid_t userID);
+int GetSummaryTypeIndex(mode_t mode);
+int GetSummaryAgeIndex(time_t age);
+void PrintSummary(struct Summary* summary);
+int CompareOwnerCounts(const void* a, const void* b);
+
+struct DuplicateSet* CreateDuplicateSet();
+void FreeDuplicateSet(struct DuplicateSet* set);
+void AddDuplicateCandidate(struct DuplicateSet* set, const char* filePath, const struct stat* fileInformation);
+void FindDuplicates(struct DuplicateSet* set, unsigned int threadCount);
+size_t KeepDuplicateGroups(struct DuplicateSet* set, int (*compare)(const void*, const void*));
+void HashCandidatePrefix(size_t index, void* buffer, void* context);
+void HashCandidateContent(size_t index, void* buffer, void* context);
+int CompareCandidateIdentity(const void* a, const void* b);
+int CompareCandidateSize(const void* a, const void* b);
+int CompareCandidatePrefix(const void* a, const void* b);
+int CompareCandidateContent(const void* a, const void* b);
+int CompareCandidateOutput(const void* a, const void* b);
+void FormatSize(unsigned long long size, char* buffer, size_t bufferSize);
 
 
 
 /// The entry point of the application.
 /// \param argc The number of command line arguments in \p argv.
 /// \param argv The array of command line arguments. The last element of the array is NULL.
-/// \return Zero if execution was successful. -1 if an unrecoverable error occurred during execution.
+/// \return Zero if execution was successful. 2 if the search has been stopped by "-timeout" and the results are incomplete. -1 if an unrecoverable error occurred during execution.
 int main(int argc, char* argv[])
 {
+	// Measure the elapsed time including the parsing of the arguments
+	StartStatsClock();
+
+	// Names outside of ASCII are compared by -iname and -ipath in the case rules of the user's locale
+	setlocale(LC_CTYPE, "");
+
+	// A closed pipe is detected through EPIPE instead, so that the search can stop on its own terms and still print its diagnostics
+	signal(SIGPIPE, SIG_IGN);
+
 	struct Args* args = calloc(1, sizeof(struct Args));
 
 	if (args == NULL)
@@ -145,7 +374,7 @@ int main(int argc, char* argv[])
 	{
 		//PrintUsage();
 
-		free(args);
+		FreeArgs(args);
 
 		return -1;
 	}
@@ -156,21 +385,165 @@ int main(int argc, char* argv[])
 		? "."
 		: args->searchPath;
 
+	if (args->filterForContent || (args->checksumAlgorithm != NoChecksum))
+	{
+		unsigned int threadCount = (args->threadCount > 0) ? args->threadCount : GetDefaultThreadCount();
+
+		// Each worker needs room for a full read plus the tail of the previous one, which might contain the start of a match
+		if (args->adaptiveThreads)
+		{
+			unsigned int maxThreadCount = threadCount * CONTENT_ADAPTIVE_THREADS_PER_PROCESSOR;
+
+			args->contentPipeline = CreateAdaptivePipeline((maxThreadCount < 1024) ? maxThreadCount : 1024, CONTENT_READ_SIZE + args->contentLiteralLength, ProcessContentJob, EmitContentJob, args);
+		}
+		else
+		{
+			args->contentPipeline = CreatePipeline(threadCount, CONTENT_READ_SIZE + args->contentLiteralLength, ProcessContentJob, EmitContentJob, args);
+		}
+
+		if (args->contentPipeline == NULL)
+		{
+			fprintf(stderr, "myfind: Starting the content reading threads has failed.\n");
+
+			FreeArgs(args);
+
+			return -1;
+		}
+	}
+
+	if (args->debugOptions & DebugLatency)
+	{
+		args->latency = CreateLatencyReport(args->slowestDirectoryCount);
+
+		if (args->latency == NULL)
+		{
+			fprintf(stderr, "myfind: Out of memory.\n");
+
+			FreeArgs(args);
+
+			return -1;
+		}
+	}
+
+	// Hardware counters are optional; Without them, the search simply runs unmeasured
+	if (args->debugOptions & DebugPerf)
+		args->perf = OpenPerfCounters();
+
+	if (args->showProgress)
+	{
+		args->progress = StartProgressReporter(stderr);
+
+		if (args->progress == NULL)
+		{
+			fprintf(stderr, "myfind: Starting the progress reporting thread has failed.\n");
+
+			FreeArgs(args);
+
+			return -1;
+		}
+
+		args->progressCounters = GetProgressCounters(args->progress);
+	}
+
+	if (args->perf != NULL)
+		StartPerfCounters(args->perf);
+
 	// Start the search at the specified path
-	SearchFile(searchPath, args);
+	if (!SearchFiles(searchPath, args))
+	{
+		FreeArgs(args);
 
-	free(args);
+		return -1;
+	}
+
+	// Wait for the content search of the remaining files
+	if (args->contentPipeline != NULL)
+		FreePipeline(args->contentPipeline);
+
+	if (args->perf != NULL)
+		StopPerfCounters(args->perf);
+
+	// The final report includes the matches of the content search
+	StopProgressReporter(args->progress);
+	args->progress = NULL;
+	args->progressCounters = NULL;
+
+	// In summary mode, nothing has been printed during the search
+	if ((args->summary != NULL) && CheckOutput(args))
+		PrintSummary(args->summary);
+
+	if ((args->duplicates != NULL) && CheckOutput(args))
+		FindDuplicates(args->duplicates, (args->threadCount > 0) ? args->threadCount : GetDefaultThreadCount());
+
+	// Make sure that the diagnostics follow all regular output
+	fflush(stdout);
+	CheckOutput(args);
+
+	if (args->debugOptions & DebugStats)
+		PrintStats(stderr);
+
+	if (args->perf != NULL)
+		PrintPerfCounters(args->perf, stderr);
+
+	if (args->latency != NULL)
+		PrintLatencyReport(args->latency, stderr);
+
+	int outputError = atomic_load(&args->outputError);
+	bool timedOut = atomic_load(&args->timedOut);
+
+	FreeArgs(args);
+
+	if (outputError != 0)
+	{
+		// Like other tools, stay quiet if the reader has simply stopped reading
+		if (outputError != EPIPE)
+			fprintf(stderr, "myfind: Writing the output has failed with error code %d: %s\n", outputError, strerror(outputError));
+
+		return -1;
+	}
+
+	// Distinguish partial results from both a complete search and a failure
+	if (timedOut)
+		return 2;
 
 	return 0;
 }
 
+/// Frees the provided command line arguments and all state that was allocated for the search.
+/// \param args The arguments to free.
+void FreeArgs(struct Args* args)
+{
+	assert(args != NULL);
+
+
+	FreeSummary(args->summary);
+	FreeDuplicateSet(args->duplicates);
+	FreeLatencyReport(args->latency);
+	ClosePerfCounters(args->perf);
+	StopProgressReporter(args->progress);
+	find_free_query(args->query);
+	find_free_exclusions(args->exclusions);
+	free(args->expression);
+	free(args);
+}
+
 /// Prints an explanation of the application's command line arguments.
 void PrintUsage()
 {
 	printf("\n");
 	printf("myfind - Prints files that match an arbitrary combination of search criteria.\n\n");
 	printf("Usage:\n");
-	printf("    find <file or directory> [<action>] ...\n");
+	printf("    find [-D <options>] [--progress] [--exclude-from <file>] [--respect-gitignore] <file or directory> [<action>] ...\n");
+	printf("--progress prints the number of directories, entries and matches, the rate and the current directory to stderr every second.\n");
+	printf("--exclude-from skips the files listed in <file> and everything below them. Each line holds a name, which is skipped\n");
+	printf("    anywhere, a path with a slash, which is compared with the printed paths, or a pattern like those of -name, or of\n");
+	printf("    -path if it contains a slash. Empty lines and lines starting with # are ignored. May be given more than once.\n");
+	printf("--respect-gitignore skips the files ignored by the .gitignore files in the searched directories, and .git directories.\n");
+	printf("-D <options> is a comma-separated list of diagnostics printed to stderr:\n");
+	printf("    stats                   Counters describing the work done during the search, printed at exit.\n");
+	printf("    latency[=<n>]           The distribution of the time spent per directory and the n slowest directories.\n");
+	printf("    perf                    Cycles, instructions, cache and branch misses in total and per phase, if available.\n");
+	printf("    strategy                The type of each file system entered and the threads chosen for it.\n");
 	printf("<action> can one or more of:\n");
 	printf("    -print                  Simply prints the path of the found files, as if no action was given.\n");
 	printf("    -ls	                    Prints found files in extended list format.\n");
@@ -185,7 +558,33 @@ void PrintUsage()
 	printf("    -user <name>/<uid>      Prints only files belonging to the user with the specified name or ID.\n");
 	printf("    -nouser                 Prints only files that do not belong to any user.\n");
 	printf("    -name <pattern>         Prints only files whose name matches the specified pattern.\n");
+	printf("    -iname <pattern>        Like -name, but letters match in any case.\n");
 	printf("    -path <pattern>         Prints only files whose complete path matches the specified pattern.\n");
+	printf("    -ipath <pattern>        Like -path, but letters match in any case.\n");
+	printf("    -regex <expression>     Prints only files whose complete path matches the POSIX extended regular expression.\n");
+	printf("    -iregex <expression>    Like -regex, but ASCII letters match in any case.\n");
+	printf("    -inum [+-]<n>           Prints only files whose inode number is n, more than n (+n) or less than n (-n).\n");
+	printf("    -samefile <file>        Prints only hard links to the specified file, including the file itself.\n");
+	printf("    -links [+-]<n>          Prints only files with n, more than n (+n) or less than n (-n) hard links.\n");
+	printf("    -contains <literal>     Prints only regular files whose content contains the specified byte sequence.\n");
+	printf("    -checksum <algorithm>   Prints the checksum of each found regular file next to its path. <algorithm> is xxh64 or sha256.\n");
+	printf("    -summary                Prints size, age, type and owner distributions of the found files instead of their paths.\n");
+	printf("    -duplicates             Prints groups of found regular files that have identical content instead of all paths.\n");
+	printf("    -threads <n>|auto       Reads file contents with up to n threads. Defaults to the number of processors. With auto,\n");
+	printf("                            starts with few threads and adds more while they increase the throughput.\n");
+	printf("    -timeout <duration>     Stops the search after the duration, e.g. 2s, 500ms or 1m, keeping the files found so far.\n");
+	printf("                            The top-level directories not searched completely are listed on stderr and the exit code is 2.\n");
+	printf("    -io-timeout <duration>  Skips files and directories whose file system does not answer within the duration, e.g. a\n");
+	printf("                            stale network mount. Makes every file system call on a helper thread, which costs some speed.\n");
+	printf("    -prefetch <n>           Reads up to n of the next directories ahead on a separate thread, keeping the output order.\n");
+	printf("                            Helps on file systems with a high latency per call. Cannot be combined with -io-timeout.\n");
+	printf("    -strategy auto|fixed    With auto, the default, read-ahead and stat threads not given with -prefetch and\n");
+	printf("                            -stat-threads are started with default sizes on network file systems and only used there.\n");
+	printf("                            Those given are used on all file systems, as with fixed.\n");
+	printf("    -dont-sync              Lets network file systems answer from their cached file attributes instead of asking\n");
+	printf("                            the server for each file. The information might be slightly outdated.\n");
+	printf("    -stat-threads <n>       Splits directories with more than 1024 entries into chunks, whose files are examined by\n");
+	printf("                            n additional threads, keeping the output order. Cannot be combined with -io-timeout.\n");
 }
 
 
@@ -202,157 +601,317 @@ bool ParseCommandLineArgs(char* argv[], struct Args *args)
 	// The first argument is the executable path; Start processing with the second argument
 	int i = 1;
 
+	// The index at which the search path is expected; Debug options may precede it
+	int pathIndex = 1;
+
+	// The number of arguments of the predicate being parsed
+	int predicateArguments;
+
+	int argumentCount = 0;
+
+	while (argv[argumentCount] != NULL)
+		argumentCount++;
+
+	// The predicates cannot have more elements than the command line, plus the terminator
+	args->expression = calloc(argumentCount + 1, sizeof(char*));
+
+	if (args->expression == NULL)
+	{
+		fprintf(stderr, "myfind: Out of memory.\n");
+
+		return false;
+	}
+
 	while (argv[i] != NULL)
 	{
-		if (strcmp(argv[i], "-print") == 0)
+		if (strcmp(argv[i], "-D") == 0)
 		{
-			// This argument does not have any effect on the application's behavior; Nothing to do
+			// Make sure that this argument is followed by another one
+			char* optionList = argv[i + 1];
+
+			if (optionList == NULL)
+			{
+				fprintf(stderr, "myfind: \"-D\" must be followed by a comma-separated list of debug options.\n");
+
+				return false;
+			}
+
+			if (!ParseDebugOptions(optionList, args))
+				return false;
+
+			if (pathIndex == i)
+				pathIndex = i + 2;
+
+			// Skip the option list argument
+			i++;
 		}
-		else if (strcmp(argv[i], "-ls") == 0)
+		else if (strcmp(argv[i], "--progress") == 0)
 		{
-			// Simply set the flag
-			args->printInExtendedFormat = true;
+			// Simply set the flag; The reporting thread is started with the search
+			args->showProgress = true;
+
+			if (pathIndex == i)
+				pathIndex = i + 1;
 		}
-		else if (strcmp(argv[i], "-type") == 0)
+		else if (strcmp(argv[i], "--respect-gitignore") == 0)
+		{
+			// Simply set the flag; The .gitignore files are read as the search enters their directories
+			args->respectGitignore = true;
+
+			if (pathIndex == i)
+				pathIndex = i + 1;
+		}
+		else if (strcmp(argv[i], "--exclude-from") == 0)
 		{
 			// Make sure that this argument is followed by another one
-			char* fileTypes = argv[i + 1];
+			char* fileName = argv[i + 1];
 
-			if (fileTypes == NULL)
+			if (fileName == NULL)
 			{
-				fprintf(stderr, "myfind: \"-type\" must be followed by one or more concatenated file type characters.\n");
+				fprintf(stderr, "myfind: \"--exclude-from\" must be followed by the path of an exclusion list.\n");
 
 				return false;
 			}
 
-			if (!ParseFileTypes(fileTypes, &args->fileTypes))
+			// All lists are loaded into the same set, so that the cost per entry does not grow with their number
+			if (args->exclusions == NULL)
+				args->exclusions = find_create_exclusions();
+
+			if (args->exclusions == NULL)
 			{
-				fprintf(stderr, "myfind: The specified file types \"%s\" are invalid.\n", fileTypes);
+				fprintf(stderr, "myfind: Out of memory.\n");
 
 				return false;
 			}
 
-			// Indicate that we want to filter for the specified file types
-			args->filterByFileType = true;
+			if (!find_load_exclusions(args->exclusions, fileName, stderr))
+				return false;
+
+			if (pathIndex == i)
+				pathIndex = i + 2;
 
-			// Skip the file types argument 
+			// Skip the file name argument
 			i++;
 		}
-		else if (strcmp(argv[i], "-user") == 0)
+		else if (strcmp(argv[i], "-print") == 0)
+		{
+			// This argument does not have any effect on the application's behavior; Nothing to do
+		}
+		else if (strcmp(argv[i], "-ls") == 0)
+		{
+			// Simply set the flag
+			args->printInExtendedFormat = true;
+		}
+		else if ((predicateArguments = find_predicate_arguments(argv[i])) >= 0)
+		{
+			// Collect the predicate and its arguments; All of them are compiled into a single query once the arguments have been parsed
+			args->expression[args->expressionLength++] = argv[i];
+
+			for (int j = 1; (j <= predicateArguments) && (argv[i + 1] != NULL); j++)
+				args->expression[args->expressionLength++] = argv[++i];
+		}
+		else if (strcmp(argv[i], "-contains") == 0)
 		{
 			// Make sure that this argument is followed by another one
-			char* userNameOrID = argv[i + 1];
+			char* literal = argv[i + 1];
 
-			if (userNameOrID == NULL)
+			if (literal == NULL)
 			{
-				fprintf(stderr, "myfind: \"-user\" must be followed by the name or ID of a user.\n");
+				fprintf(stderr, "myfind: \"-contains\" must be followed by the string to search for in the file content.\n");
 
 				return false;
 			}
 
-			if (ConvertToInteger(userNameOrID, &args->userID))
+			// Store a pointer to the literal and set the flag that it is available
+			args->contentLiteral = literal;
+			args->contentLiteralLength = strlen(literal);
+			args->filterForContent = true;
+
+			// Skip the literal argument
+			i++;
+		}
+		else if (strcmp(argv[i], "-checksum") == 0)
+		{
+			// Make sure that this argument is followed by a known algorithm
+			char* algorithm = argv[i + 1];
+
+			if ((algorithm != NULL) && (strcmp(algorithm, "xxh64") == 0))
 			{
-				// The user was specified by their numeric user ID; Nothing more to do
+				args->checksumAlgorithm = ChecksumXXH64;
 			}
-			else if (QueryUserID(userNameOrID, &args->userID))
+			else if ((algorithm != NULL) && (strcmp(algorithm, "sha256") == 0))
 			{
-				// The user was specified by their user name for which the corresponding ID could be queried successfully; Nothing more to do
+				args->checksumAlgorithm = ChecksumSHA256;
 			}
 			else
 			{
-				fprintf(stderr, "myfind: \"%s\" is not the name of a known user\n", userNameOrID);
+				fprintf(stderr, "myfind: \"-checksum\" must be followed by the checksum algorithm, either \"xxh64\" or \"sha256\".\n");
 
 				return false;
 			}
 
-			// Indicate that we want to filter for the determined user ID
-			args->filterByUserID = true;
-			
-			// Skip the user name/ID argument 
+			// Skip the algorithm argument
 			i++;
 		}
-		else if (strcmp(argv[i], "-nouser") == 0)
+		else if (strcmp(argv[i], "-summary") == 0)
 		{
-			// Simply set the flag
-			args->filterForNoUser = true;
+			// Allocate the counters once, even if the argument is repeated
+			if (args->summary == NULL)
+			{
+				args->summary = CreateSummary();
+
+				if (args->summary == NULL)
+				{
+					fprintf(stderr, "myfind: Out of memory.\n");
+
+					return false;
+				}
+			}
 		}
-		else if (strcmp(argv[i], "-group") == 0)
+		else if (strcmp(argv[i], "-duplicates") == 0)
 		{
-			// Make sure that this argument is followed by another one
-			char* groupNameOrID = argv[i + 1];
-
-			if (groupNameOrID == NULL)
+			// Allocate the candidate set once, even if the argument is repeated
+			if (args->duplicates == NULL)
 			{
-				fprintf(stderr, "myfind: \"-group\" must be followed by the name or ID of a group.\n");
+				args->duplicates = CreateDuplicateSet();
 
-				return false;
+				if (args->duplicates == NULL)
+				{
+					fprintf(stderr, "myfind: Out of memory.\n");
+
+					return false;
+				}
 			}
+		}
+		else if (strcmp(argv[i], "-threads") == 0)
+		{
+			// Make sure that this argument is followed by a positive number or "auto"
+			char* threadCount = argv[i + 1];
+			char* end = NULL;
 
-			if (ConvertToIntegerGroup(groupNameOrID, &args->groupID))
+			if ((threadCount != NULL) && (strcmp(threadCount, "auto") == 0))
 			{
-				// The group was specified by their numeric group ID; Nothing more to do
+				// The maximum is derived from the number of available processors once the search starts
+				args->adaptiveThreads = true;
+				args->threadCount = 0;
 			}
-			else if (QueryGroupID(groupNameOrID, &args->groupID))
+			else
 			{
-				// The group was specified by their group name for which the corresponding ID could be queried successfully; Nothing more to do
+				long count = (threadCount != NULL)
+					? strtol(threadCount, &end, 10)
+					: 0;
+
+				if ((threadCount == NULL) || (*end != '\0') || (count < 1) || (count > 1024))
+				{
+					fprintf(stderr, "myfind: \"-threads\" must be followed by a number of threads between 1 and 1024 or \"auto\".\n");
+
+					return false;
+				}
+
+				args->threadCount = (unsigned int) count;
+				args->adaptiveThreads = false;
 			}
-			else
+
+			// Skip the thread count argument
+			i++;
+		}
+		else if (strcmp(argv[i], "-timeout") == 0)
+		{
+			// Make sure that this argument is followed by a positive duration
+			if ((argv[i + 1] == NULL) || !ParseDuration(argv[i + 1], &args->timeoutMilliseconds))
 			{
-				fprintf(stderr, "myfind: \"%s\" is not the name of a known group\n", groupNameOrID);
+				fprintf(stderr, "myfind: \"-timeout\" must be followed by a positive duration, e.g. 2s, 500ms or 1m.\n");
 
 				return false;
 			}
 
-			// Indicate that we want to filter for the determined user ID
-			args->filterByGroupID = true;
-
-			// Skip the group name/ID argument 
+			// Skip the duration argument
 			i++;
 		}
-		else if (strcmp(argv[i], "-nogroup") == 0)
+		else if (strcmp(argv[i], "-io-timeout") == 0)
 		{
-			// Simply set the flag
-			args->filterForNoGroup = true;
+			// Make sure that this argument is followed by a positive duration
+			if ((argv[i + 1] == NULL) || !ParseDuration(argv[i + 1], &args->callTimeoutMilliseconds))
+			{
+				fprintf(stderr, "myfind: \"-io-timeout\" must be followed by a positive duration, e.g. 2s, 500ms or 1m.\n");
+
+				return false;
+			}
+
+			// Skip the duration argument
+			i++;
 		}
-		else if (strcmp(argv[i], "-name") == 0)
+		else if (strcmp(argv[i], "-prefetch") == 0)
 		{
-			// Make sure that this argument is followed by another one
-			char* namePattern = argv[i + 1];
-
-			if (namePattern == NULL)
+			// Make sure that this argument is followed by a positive number
+			char* directoryCount = argv[i + 1];
+			char* end = NULL;
+			long count = (directoryCount != NULL)
+				? strtol(directoryCount, &end, 10)
+				: 0;
+
+			if ((directoryCount == NULL) || (*end != '\0') || (count < 1) || (count > FIND_MAX_PREFETCH))
 			{
-				fprintf(stderr, "myfind: \"-name\" must be followed by a string representing the filter pattern to apply for the file name.\n");
+				fprintf(stderr, "myfind: \"-prefetch\" must be followed by a number of directories between 1 and %d.\n", FIND_MAX_PREFETCH);
 
 				return false;
 			}
 
-			// Store a pointer to the pattern and set the flag that it is available
-			args->namePattern = namePattern;
-			args->filterForNamePattern = true;
+			args->prefetchDirectories = (unsigned int) count;
 
-			// Skip the name pattern argument 
+			// Skip the directory count argument
 			i++;
 		}
-		else if (strcmp(argv[i], "-path") == 0)
+		else if (strcmp(argv[i], "-strategy") == 0)
 		{
-			// Make sure that this argument is followed by another one
-			char* pathPattern = argv[i + 1];
+			// Make sure that this argument is followed by a known strategy
+			char* strategy = argv[i + 1];
+
+			if ((strategy != NULL) && (strcmp(strategy, "auto") == 0))
+			{
+				args->fixedStrategy = false;
+			}
+			else if ((strategy != NULL) && (strcmp(strategy, "fixed") == 0))
+			{
+				args->fixedStrategy = true;
+			}
+			else
+			{
+				fprintf(stderr, "myfind: \"-strategy\" must be followed by either \"auto\" or \"fixed\".\n");
 
-			if (pathPattern == NULL)
+				return false;
+			}
+
+			// Skip the strategy argument
+			i++;
+		}
+		else if (strcmp(argv[i], "-dont-sync") == 0)
+		{
+			// Simply set the flag
+			args->dontSync = true;
+		}
+		else if (strcmp(argv[i], "-stat-threads") == 0)
+		{
+			// Make sure that this argument is followed by a positive number
+			char* threadCount = argv[i + 1];
+			char* end = NULL;
+			long count = (threadCount != NULL)
+				? strtol(threadCount, &end, 10)
+				: 0;
+
+			if ((threadCount == NULL) || (*end != '\0') || (count < 1) || (count > FIND_MAX_STAT_THREADS))
 			{
-				fprintf(stderr, "myfind: \"-path\" must be followed by a string representing the filter pattern to apply for the file path.\n");
+				fprintf(stderr, "myfind: \"-stat-threads\" must be followed by a number of threads between 1 and %d.\n", FIND_MAX_STAT_THREADS);
 
 				return false;
 			}
 
-			// Store a pointer to the pattern and set the flag that it is available
-			args->pathPattern = pathPattern;
-			args->filterForPathPattern = true;
+			args->statThreads = (unsigned int) count;
 
-			// Skip the path pattern argument 
+			// Skip the thread count argument
 			i++;
 		}
-		else if (i == 1)
+		else if (i == pathIndex)
 		{
 			// If this argument does not match any of the actions but is the first one, assume that it is the search path
 			args->searchPath = argv[i];
@@ -367,558 +926,1330 @@ bool ParseCommandLineArgs(char* argv[], struct Args *args)
 		i++;
 	}
 
-	// All arguments were parsed successfully
-	return true;
-}
-
-/// Parses the string that specifies the file types to be printed.
-/// \param fileTypeChars The array of characters representing the file types to be printed.
-/// \param fileTypes A pointer to the enumeration value in which to store the parsed information.
-/// \return true if all file type characters could be parsed successfully. Otherwise, false.
-bool ParseFileTypes(char* fileTypeChars, enum FileTypes* fileTypes)
-{
-	assert(fileTypeChars != NULL);
-	assert(fileTypes != NULL);
-
-
-	// Assume no file type by default
-	*fileTypes = None;
-
-	// Loop through the individual characters in the string
-	for (size_t i = 0; i < strlen(fileTypeChars); i++)
+	// The prefetch thread would wait for an unresponsive file system without a timeout
+	if ((args->prefetchDirectories > 0) && (args->callTimeoutMilliseconds > 0))
 	{
-		switch (fileTypeChars[i])
-		{
-		case 'b':
-			*fileTypes |= BlockSpecialFile;
-			break;
+		fprintf(stderr, "myfind: \"-prefetch\" cannot be combined with \"-io-timeout\".\n");
 
-		case 'c':
-			*fileTypes |= CharacterSpecialFile;
-			break;
+		return false;
+	}
 
-		case 'd':
-			*fileTypes |= Directory;
-			break;
+	// Neither would the stat threads
+	if ((args->statThreads > 0) && (args->callTimeoutMilliseconds > 0))
+	{
+		fprintf(stderr, "myfind: \"-stat-threads\" cannot be combined with \"-io-timeout\".\n");
 
-		case 'p':
-			*fileTypes |= NamedPipe;
-			break;
+		return false;
+	}
 
-		case 'f':
-			*fileTypes |= RegularFile;
-			break;
+	// Resolve user and group names and analyze the patterns once for the whole search
+	args->query = find_compile(args->expression, stderr);
 
-		case 'l':
-			*fileTypes |= SymbolicLink;
-			break;
+	free(args->expression);
+	args->expression = NULL;
 
-		case 's':
-			*fileTypes |= Socket;
-			break;
+	if (args->query == NULL)
+		return false;
 
-		default:
-			// Invalid character
-			return false;
-		}
-	}
+	// File ages in the summary are relative to the same point in time as the query
+	if (args->summary != NULL)
+		args->summary->referenceTime = find_query_time(args->query);
 
-	// All characters could be parsed successfully
+	// All arguments were parsed successfully
 	return true;
 }
 
-
-/// Converts the provided string to an integer.
-/// \param s The string to convert to an integer.
-/// \param i A pointer to the integer value in which to store the converted string.
-/// \return true if the string could successfully be converted to an integer value. Otherwise, false.
-bool ConvertToInteger(char* s, int* i)
+/// Parses the comma-separated list of debug options following "-D".
+/// \param optionList The comma-separated list of option names.
+/// \param args A pointer to the struct of processed command line arguments to which the parsed options are added.
+/// \return true if all options are known. Otherwise, false.
+bool ParseDebugOptions(char* optionList, struct Args* args)
 {
-	struct passwd *p;
-	struct passwd *pw;
-	unsigned int uid;
-	
-	pw = getpwnam(s);
-	
-	if (pw != NULL) 
+	assert(optionList != NULL);
+	assert(args != NULL);
+
+
+	char* option = optionList;
+
+	while (true)
 	{
-		return false;
-	}
-	else if (uid = strtol(s, &s, 10))
-	{
-		p = getpwuid(uid);
-			
-		if (p != NULL) 
+		size_t length = strcspn(option, ",");
+
+		if ((length == 5) && (strncmp(option, "stats", length) == 0))
+		{
+			args->debugOptions |= DebugStats;
+		}
+		else if ((length >= 7) && (strncmp(option, "latency", 7) == 0) && ((length == 7) || (option[7] == '=')))
+		{
+			args->debugOptions |= DebugLatency;
+			args->slowestDirectoryCount = LATENCY_DEFAULT_SLOWEST;
+
+			// An optional number of slowest directories to list may follow
+			if (length > 7)
+			{
+				char* end = NULL;
+				long count = strtol(option + 8, &end, 10);
+
+				if ((end != option + length) || (count < 0) || (count > 100000))
+				{
+					fprintf(stderr, "myfind: \"%.*s\" must specify a number of directories between 0 and 100000.\n", (int) length, option);
+
+					return false;
+				}
+
+				args->slowestDirectoryCount = (size_t) count;
+			}
+		}
+		else if ((length == 4) && (strncmp(option, "perf", length) == 0))
+		{
+			args->debugOptions |= DebugPerf;
+		}
+		else if ((length == 8) && (strncmp(option, "strategy", length) == 0))
 		{
-			*i = p->pw_uid;
-			return true;
+			args->debugOptions |= DebugStrategy;
 		}
-		
 		else
 		{
+			fprintf(stderr, "myfind: Unknown debug option \"%.*s\". Valid options are: stats, latency[=<n>], perf, strategy\n", (int) length, option);
+
 			return false;
 		}
+
+		if (option[length] == '\0')
+			break;
+
+		// Continue after the comma
+		option += length + 1;
 	}
+
+	return true;
+}
+
+/// Parses a duration, which is a number of seconds optionally followed by one of the units "ms", "s", "m" or "h".
+/// \param text The duration to parse, e.g. "2", "1.5s" or "500ms".
+/// \param milliseconds Receives the duration in milliseconds.
+/// \return true if \p text is a positive duration. Otherwise, false.
+bool ParseDuration(const char* text, unsigned long long* milliseconds)
+{
+	assert(text != NULL);
+	assert(milliseconds != NULL);
+
+
+	char* unit = NULL;
+	double value = strtod(text, &unit);
+	double scale;
+
+	if (unit == text)
+		return false;
+
+	if ((strcmp(unit, "") == 0) || (strcmp(unit, "s") == 0))
+		scale = 1000.0;
+	else if (strcmp(unit, "ms") == 0)
+		scale = 1.0;
+	else if (strcmp(unit, "m") == 0)
+		scale = 60.0 * 1000.0;
+	else if (strcmp(unit, "h") == 0)
+		scale = 60.0 * 60.0 * 1000.0;
 	else
-	{
 		return false;
-	}
-		
+
+	// Also rejects NaN; Anything shorter than a millisecond is rounded up, as a zero timeout would not search at all
+	if (!(value > 0.0) || (value * scale > 1e15))
+		return false;
+
+	*milliseconds = (unsigned long long) (value * scale);
+
+	if (*milliseconds == 0)
+		*milliseconds = 1;
+
+	return true;
 }
 
-/// Converts the provided string to an integer.
-/// \param s The string to convert to an integer.
-/// \param i A pointer to the integer value in which to store the converted string.
-/// \return true if the string could successfully be converted to an integer value. Otherwise, false.
-bool ConvertToIntegerGroup(char* s, int* i)
+/// Walks through all the files and directories below the specified path and handles each entry that matches the criteria specified in \p args.
+/// \param searchPath The path of the file or directory to start at.
+/// \param args The command line options representing the criteria and the actions to use for printing the information of each file or directory entry.
+/// \return true if the search was run, even if it has been stopped early. false if it could not be started, which has been reported to stderr.
+bool SearchFiles(char* searchPath, struct Args* args)
 {
-	struct group *g;
-	struct group *gw;
-	unsigned int gid;
+	assert(searchPath != NULL);
+	assert(args != NULL);
+
 
-	gw = getgrnam(s);
+	char* roots[] = { searchPath, NULL };
 
-	if (gw != NULL)
+	struct FindIterator* iterator = find_open(args->query, roots);
+
+	if (iterator == NULL)
 	{
+		fprintf(stderr, "myfind: Out of memory.\n");
+
 		return false;
 	}
-	else if (gid = strtol(s, &s, 10))
+
+	struct FindDiagnostics diagnostics =
 	{
-		g = getgrgid(gid);
+		.errors = stderr,
+		.latency = args->latency,
+		.perf = args->perf,
+		.progress = args->progress,
+		.strategy = (args->debugOptions & DebugStrategy) ? stderr : NULL,
+	};
 
-		if (g != NULL)
-		{
-			*i = g->gr_gid;
-			return true;
-		}
+	find_set_diagnostics(iterator, &diagnostics);
+	find_set_exclusions(iterator, args->exclusions);
+	find_set_gitignore(iterator, args->respectGitignore);
+	find_set_strategy(iterator, args->fixedStrategy ? FindStrategyFixed : FindStrategyAuto);
 
-		else
+	// Only ask the file system for what is printed or counted; The query adds what its predicates need
+	// "-ls" does not print anything beyond the path yet, so it needs no more than the type
+	unsigned int statFields = FindStatType;
+
+	if (args->summary != NULL)
+		statFields |= FindStatSize | FindStatTimes | FindStatOwner;
+
+	if (args->duplicates != NULL)
+		statFields |= FindStatSize | FindStatIdentity;
+
+	find_set_stat_fields(iterator, statFields, args->dontSync);
+
+	if ((args->callTimeoutMilliseconds > 0) && !find_set_call_timeout(iterator, args->callTimeoutMilliseconds))
+	{
+		fprintf(stderr, "myfind: Starting the file system helper thread has failed.\n");
+
+		find_close(iterator);
+
+		return false;
+	}
+
+	if ((args->prefetchDirectories > 0) && !find_set_prefetch(iterator, args->prefetchDirectories))
+	{
+		fprintf(stderr, "myfind: Starting the prefetch thread has failed.\n");
+
+		find_close(iterator);
+
+		return false;
+	}
+
+	if ((args->statThreads > 0) && !find_set_stat_threads(iterator, args->statThreads))
+	{
+		fprintf(stderr, "myfind: Starting the stat threads has failed.\n");
+
+		find_close(iterator);
+
+		return false;
+	}
+
+	args->iterator = iterator;
+
+	// A rare match might not be printed for a long time, so notice a closed pipe without waiting for a failed write
+	struct OutputWatch* watch = StartOutputWatch(STDOUT_FILENO, OnOutputClosed, args);
+	struct Deadline* deadline = NULL;
+
+	if (args->timeoutMilliseconds > 0)
+	{
+		deadline = StartDeadline(args->timeoutMilliseconds, OnDeadlineExpired, args);
+
+		if (deadline == NULL)
 		{
+			// Without the timer thread, the search could not be stopped in time
+			fprintf(stderr, "myfind: Starting the timeout thread has failed.\n");
+
+			StopOutputWatch(watch);
+			args->iterator = NULL;
+			find_close(iterator);
+
 			return false;
 		}
 	}
-	else
+
+	const struct FindEntry* entry;
+
+	while ((entry = find_next(iterator)) != NULL)
 	{
-		return false;
+		if (args->perf != NULL)
+			BeginPerfPhase(args->perf);
+
+		HandleMatchingFile(entry, args);
+
+		if (args->perf != NULL)
+			EndPerfPhase(args->perf, PerfPhasePrint);
 	}
 
+	// The content search of the remaining files can still be cancelled while it is waited for
+	if (args->contentPipeline != NULL)
+		DrainPipeline(args->contentPipeline);
+
+	StopDeadline(deadline);
+	StopOutputWatch(watch);
+
+	args->iterator = NULL;
+
+	if (atomic_load(&args->timedOut))
+	{
+		// The files found so far come first, followed by what is missing from them
+		fflush(stdout);
+
+		fprintf(stderr, "myfind: The search has timed out after %llu ms; The results are incomplete.\n", args->timeoutMilliseconds);
+
+		// Listing every unfinished directory could take as long as the search itself, so only the top-level ones are listed
+		find_unfinished(iterator, 1, PrintUnfinishedDirectory, NULL);
+	}
+
+	find_close(iterator);
+
+	return true;
 }
 
-/// Queries the user ID of the user with the specified name.
-/// \param userName The name of the user for which to get the ID.
-/// \param userID A pointer to the integer value in which to store the queries user ID.
-/// \return true if the user ID could be queried successfully. Otherwise, false.
-bool QueryUserID(char* userName, int* userID)
+/// Hands a file that matches the search criteria to the content search, if requested, or processes it right away.
+/// \param entry The matching file as returned by find_next().
+/// \param args The command line options specifying how to handle matching files.
+void HandleMatchingFile(const struct FindEntry* entry, struct Args* args)
 {
-	struct passwd *p;
-	p = getpwnam(userName);
-	
-	if (p != NULL)
+	assert(entry != NULL);
+	assert(args != NULL);
+
+
+	if (args->contentPipeline != NULL)
 	{
-		*userID = p->pw_uid;
-		return true;
+		// Reading the content is by far the most expensive step; Leave it to the workers and only for regular files
+		if (S_ISREG(entry->info.st_mode))
+		{
+			struct ContentJob* job = calloc(1, sizeof(struct ContentJob));
+
+			if (job == NULL)
+			{
+				// Out of memory
+				exit(-1);
+			}
+
+			// The entry is only valid until the next one is requested
+			job->filePath = strdup(entry->path);
+			job->fileInfo = entry->info;
+
+			if (job->filePath == NULL)
+			{
+				// Out of memory
+				exit(-1);
+			}
+
+			SubmitToPipeline(args->contentPipeline, job);
+		}
 	}
-	
 	else
 	{
-		return false;
+		ProcessMatchingFile(entry->path, &entry->info, NULL, args);
 	}
+}
+
+/// Cancels the directory walk and the content search. May be called from any thread while SearchFiles() is running.
+/// \param args The arguments of the search.
+void CancelSearch(struct Args* args)
+{
+	assert(args != NULL);
 
+
+	if (args->iterator != NULL)
+		find_cancel(args->iterator);
+
+	if (args->contentPipeline != NULL)
+		CancelPipeline(args->contentPipeline);
 }
-/// Queries the group ID of the group with the specified name.
-/// \param groupName The name of the group for which to get the ID.
-/// \param gruopID A pointer to the integer value in which to store the queries group ID.
-/// \return true if the group ID could be queried successfully. Otherwise, false.
-bool QueryGroupID(char* groupName, int* groupID)
+
+/// Records that writing the output has failed and cancels the search and the content search, as their results can no longer be printed.
+/// May be called from any thread; Only the first error is kept.
+/// \param args The arguments of the search.
+/// \param error The error code of the failed write.
+void StopOnOutputError(struct Args* args, int error)
 {
-	struct group *g;
-	g = getgrnam(groupName);
+	assert(args != NULL);
 
-	if (g != NULL)
-	{
-		*groupID = g->gr_gid;
-		return true;
-	}
 
-	else
-	{
-		return false;
-	}
+	int expected = 0;
 
+	if (atomic_compare_exchange_strong(&args->outputError, &expected, error))
+		CancelSearch(args);
 }
 
+/// Called by the output watch once the reader of stdout has gone away.
+/// \param context The struct Args of the search.
+void OnOutputClosed(void* context)
+{
+	StopOnOutputError(context, EPIPE);
+}
 
-/// Recursively walks through all the files and directories below the specified path and prints the information of each entry according to the actions specified in \p args.
-/// \param filePath The path of the file or directory to process.
-/// \param args The command line options representing the actions to use for printing the information of each file or directory entry.
-void SearchFile(char* filePath, struct Args* args)
+/// Called by the deadline of "-timeout" once the time limit has passed.
+/// \param context The struct Args of the search.
+void OnDeadlineExpired(void* context)
+{
+	struct Args* args = context;
+
+	atomic_store(&args->timedOut, true);
+	CancelSearch(args);
+}
+
+/// Lists a directory that has not been searched completely because of "-timeout".
+/// \param path The path of the directory.
+/// \param certain false if the file system has not reported whether the path is a directory.
+/// \param context Not used.
+void PrintUnfinishedDirectory(const char* path, bool certain, void* context)
+{
+	(void) context;
+
+	fprintf(stderr, "myfind: Not searched completely%s: %s\n", certain ? "" : " (possibly a directory)", path);
+}
+
+/// Checks whether a write to stdout has failed and stops the search if so.
+/// \param args The arguments of the search.
+/// \return true if the output is still fine, otherwise false.
+bool CheckOutput(struct Args* args)
 {
-	assert(filePath != NULL);
 	assert(args != NULL);
 
 
-	struct stat fileInfo;
+	if (!ferror(stdout))
+		return true;
 
-	// Read the file information without following symbolic links
-	int result = lstat(filePath, &fileInfo);
+	// A write error of a buffered stream is only reported through errno
+	StopOnOutputError(args, (errno != 0) ? errno : EIO);
+
+	return false;
+}
+
+/// Handles a file that matches all search criteria, either by printing its information or by adding it to the requested reports.
+/// \param filePath The path of the matching file.
+/// \param fileInformation The information of the file as returned by stat().
+/// \param checksum The hexadecimal checksum of the file's content to print in front of its path. NULL if no checksum was requested.
+/// \param args The command line options specifying how to handle matching files.
+void ProcessMatchingFile(const char* filePath, const struct stat* fileInformation, char* checksum, struct Args* args)
+{
+	assert(filePath != NULL);
+	assert(fileInformation != NULL);
+	assert(args != NULL);
 
-	if (result == -1)
-	{
-		fprintf(stderr, "Reading information of file \"%s\" has failed with error code %d: %s\n", filePath, errno, strerror(errno));
 
+	// Files that are still being emitted after the output has failed are dropped
+	if (atomic_load_explicit(&args->outputError, memory_order_relaxed) != 0)
 		return;
+
+	ThreadStats.matches++;
+
+	if (args->progressCounters != NULL)
+		CountProgress(&args->progressCounters->matches);
+
+	if (args->summary != NULL)
+	{
+		// Only count the file; The report is printed once the search has finished
+		AddToSummary(args->summary, fileInformation);
 	}
-	
-	// Check if the file should be ignored based on the command line arguments
-	if (ShouldPrintFileInformation(filePath, &fileInfo, args))
+
+	if (args->duplicates != NULL)
 	{
-		// Print the information of this file or directory
-		PrintFileInformation(filePath, &fileInfo, args);
+		// Only remember the file; The contents are compared once the search has finished
+		if (S_ISREG(fileInformation->st_mode))
+			AddDuplicateCandidate(args->duplicates, filePath, fileInformation);
 	}
 
-	// Continue the search in subdirectories if the "file" is actually a directory
-	if (S_ISDIR(fileInfo.st_mode))
+	if ((args->summary == NULL) && (args->duplicates == NULL))
 	{
-		SearchDirectory(filePath, args);
+		if (checksum != NULL)
+		{
+			// Use the format of sha256sum, so that the output can be verified with the standard tools
+			printf("%s  %s\n", checksum, filePath);
+		}
+		else
+		{
+			// Print the information of this file or directory
+			PrintFileInformation(filePath, fileInformation, args);
+		}
+
+		CheckOutput(args);
 	}
 }
 
-/// Enumerates the files and directories below the specified directory path and prints the information of each entry according to the actions specified in \p args.
-/// \param directoryPath The path of the directory to process.
-/// \param args The command line options representing the actions to use for printing the information of each file or directory entry.
-void SearchDirectory(char* directoryPath, struct Args* args)
+/// Prints the information of a single file or directory.
+/// \param filePath The path of the file to be printed.
+/// \param fileInformation The information of the file as returned by stat().
+/// \param args The command line options that specify the format in which to print the file's information.
+/// \return The created file node.
+void PrintFileInformation(const char* filePath, const struct stat* fileInformation, struct Args* args)
 {
-	assert(directoryPath != NULL);
+	assert(filePath != NULL);
+	assert(fileInformation != NULL);
 	assert(args != NULL);
 
 
-	// Open the specified directory
-	DIR* pDir = opendir(directoryPath);
-
-	if (pDir == NULL)
+	if (args->printInExtendedFormat)
 	{
-		fprintf(stderr, "Opening directory \"%s\" has failed with error code %d: %s\n", directoryPath, errno, strerror(errno));
-
-		return;
+		// TODO: Print in extended list format
 	}
+	else
+	{
+		// Simply print the path of the file
+		printf("%s\n", filePath);
+	}
+}
 
 
-	// If we keep the current directory open while descending further
-	// down the directory tree, we might run into the open file limit.
-	// Therefore, we will read all entries of the current directory
-	// into a linked list and close the directory right away.
+/// Creates an empty set of summary counters.
+/// \return The created summary, which needs to be released with FreeSummary(), or NULL if the memory could not be allocated.
+struct Summary* CreateSummary()
+{
+	struct Summary* summary = calloc(1, sizeof(struct Summary));
 
-	// The head of the linked list that stores the file names of the current directory
-	struct FileNode* head = NULL;
+	if (summary == NULL)
+		return NULL;
 
-	struct dirent* directoryInfo = NULL;
+	// Start with a small owner table; Most trees belong to a handful of users
+	summary->ownerCapacity = 16;
+	summary->owners = calloc(summary->ownerCapacity, sizeof(struct OwnerCount));
 
-	do
+	if (summary->owners == NULL)
 	{
-		// Reset error for the subsequent library call
-		errno = 0;
+		free(summary);
 
-		// Read directory information
-		directoryInfo = readdir(pDir);
+		return NULL;
+	}
 
-		if (directoryInfo == NULL)
-		{
-			// If no error value is set, it indicates that the end of the directory stream has been reached
-			if (errno != 0)
-				fprintf(stderr, "Reading directory \"%s\" has failed with error code %d: %s\n", directoryPath, errno, strerror(errno));
+	// All ages are measured against the time the search was started
+	summary->referenceTime = time(NULL);
 
-			break;
-		}
+	return summary;
+}
 
-		// Ignore the directory entries that represent the current and the parent directory
-		if ((strcmp(directoryInfo->d_name, ".") == 0) || (strcmp(directoryInfo->d_name, "..") == 0))
-			continue;
+/// Frees the provided summary and all counters associated with it.
+/// \param summary The summary to free. May be NULL.
+void FreeSummary(struct Summary* summary)
+{
+	if (summary == NULL)
+		return;
 
+	free(summary->owners);
+	free(summary);
+}
 
-		// Add the directory name to the temporary list
-		AddListNode(&head, directoryInfo->d_name);
-	} while (directoryInfo != NULL);
+/// Adds a single file to the distributions of the summary.
+/// \param summary The summary to update.
+/// \param fileInformation The information of the file as returned by stat().
+void AddToSummary(struct Summary* summary, const struct stat* fileInformation)
+{
+	assert(summary != NULL);
+	assert(fileInformation != NULL);
 
 
-	// Close the directory
-	int result = closedir(pDir);
+	unsigned long long size = (fileInformation->st_size > 0)
+		? (unsigned long long) fileInformation->st_size
+		: 0;
 
-	if (result == -1)
-	{
-		fprintf(stderr, "Closing directory \"%s\" has failed with error code %d: %s\n", directoryPath, errno, strerror(errno));
+	summary->fileCount++;
+	summary->byteCount += size;
 
-		return;
+	// The bucket index is the number of significant bits, so that bucket n holds sizes in [2^(n-1), 2^n)
+	int sizeIndex = (size == 0)
+		? 0
+		: 64 - __builtin_clzll(size);
+
+	summary->sizeBuckets[sizeIndex]++;
+	summary->ageBuckets[GetSummaryAgeIndex(summary->referenceTime - fileInformation->st_mtime)]++;
+	summary->typeCounts[GetSummaryTypeIndex(fileInformation->st_mode)]++;
+
+	struct OwnerCount* owner = FindOwnerCount(summary, fileInformation->st_uid);
+
+	if (owner == NULL)
+	{
+		// Out of memory
+		exit(-1);
 	}
 
+	owner->fileCount++;
+	owner->byteCount += size;
+}
+
+/// Looks up the counters of the specified owner, adding them to the hash table if necessary.
+/// \param summary The summary containing the owner hash table.
+/// \param userID The user ID of the owner.
+/// \return The counters of the owner, or NULL if the hash table could not be grown.
+struct OwnerCount* FindOwnerCount(struct Summary* summary, uid_t userID)
+{
+	assert(summary != NULL);
 
-	// Iterate over the list of file names 
-	struct FileNode* node = head;
 
-	while (node != NULL)
+	// Keep the load factor below 50% so that probe sequences stay short
+	if ((summary->ownerCount + 1) * 2 > summary->ownerCapacity)
 	{
-		// TODO:
-		// CombinePath() might be unnecessary since the file system accepts duplicated
-		// slashes in paths (".////doc" will be treated the same as "./doc"). Simply
-		// concatenate directoryPath and directoryInfo->d_name with a slash in between.
+		size_t newCapacity = summary->ownerCapacity * 2;
+		struct OwnerCount* newOwners = calloc(newCapacity, sizeof(struct OwnerCount));
+
+		if (newOwners == NULL)
+			return NULL;
 
-		// Construct the combined path of the file, taking care of duplicated slashes
-		char* filePath = CombinePath(directoryPath, node->fileName);
+		// Rehash all used slots into the larger table
+		for (size_t i = 0; i < summary->ownerCapacity; i++)
+		{
+			if (summary->owners[i].fileCount == 0)
+				continue;
 
-		// Process files and directories below the current one
-		SearchFile(filePath, args);
+			size_t j = (summary->owners[i].userID * 2654435761u) & (newCapacity - 1);
 
-		// Free the previously allocated, combined path string
-		free(filePath);
+			while (newOwners[j].fileCount != 0)
+				j = (j + 1) & (newCapacity - 1);
 
+			newOwners[j] = summary->owners[i];
+		}
 
-		// Continue with the next entry in the list
-		node = node->next;
+		free(summary->owners);
+		summary->owners = newOwners;
+		summary->ownerCapacity = newCapacity;
 	}
 
-	// Free the temporary list
-	FreeList(&head);
+	// Probe linearly until either the owner or an unused slot is found
+	size_t i = (userID * 2654435761u) & (summary->ownerCapacity - 1);
+
+	while (summary->owners[i].fileCount != 0)
+	{
+		if (summary->owners[i].userID == userID)
+			return &summary->owners[i];
+
+		i = (i + 1) & (summary->ownerCapacity - 1);
+	}
+
+	// The slot only counts as used once the caller has incremented its file count
+	summary->owners[i].userID = userID;
+	summary->ownerCount++;
+
+	return &summary->owners[i];
 }
 
+/// Determines the index of the type counter for the provided file mode.
+/// \param mode The file mode as returned by stat().
+/// \return The index into \p typeCounts of struct Summary. The last index is used for unknown file types.
+int GetSummaryTypeIndex(mode_t mode)
+{
+	if (S_ISREG(mode))
+		return 0;
+	else if (S_ISDIR(mode))
+		return 1;
+	else if (S_ISLNK(mode))
+		return 2;
+	else if (S_ISBLK(mode))
+		return 3;
+	else if (S_ISCHR(mode))
+		return 4;
+	else if (S_ISFIFO(mode))
+		return 5;
+	else if (S_ISSOCK(mode))
+		return 6;
+
+	return 7;
+}
 
-/// Concatenates the provided path strings into a single path, adding or removing the intermediate directory separator as necessary.
-/// \param path1 The first path to combine.
-/// \param path2 The second path to combine.
-/// \return The combined path as a newly allocated string, which needs to be released with free().
-char* CombinePath(char* path1, char* path2)
+/// Determines the index of the age bucket for the provided file age.
+/// \param age The number of seconds since the last modification of the file. Negative if the modification time lies in the future.
+/// \return The index into \p ageBuckets of struct Summary.
+int GetSummaryAgeIndex(time_t age)
 {
-	// Determine the number of characters in the input strings
-	int path1Len = strlen(path1);
-	int path2Len = strlen(path2);
+	// The upper bounds of all buckets except the last one, in seconds
+	static const time_t bounds[SUMMARY_AGE_BUCKETS - 1] =
+	{
+		0,
+		60 * 60,
+		24 * 60 * 60,
+		7 * 24 * 60 * 60,
+		30 * 24 * 60 * 60,
+		90 * 24 * 60 * 60,
+		365 * 24 * 60 * 60,
+		2 * 365 * 24 * 60 * 60,
+		5 * 365 * 24 * 60 * 60,
+	};
+
+	int index = 0;
+
+	while ((index < SUMMARY_AGE_BUCKETS - 1) && (age >= bounds[index]))
+		index++;
+
+	return index;
+}
+
+/// Formats the provided size in bytes using binary unit prefixes.
+/// \param size The size in bytes to format.
+/// \param buffer The character array in which to store the formatted string.
+/// \param bufferSize The number of characters available in \p buffer.
+void FormatSize(unsigned long long size, char* buffer, size_t bufferSize)
+{
+	static const char* units[] = { "B", "KiB", "MiB", "GiB", "TiB", "PiB", "EiB" };
+
+	int unit = 0;
 
-	// Check if both or either of the strings is empty
-	if ((path1Len == 0) && (path2Len == 0))
+	// Only switch to the next unit for exact multiples, so that bucket bounds stay precise
+	while ((unit < 6) && (size >= 1024) && (size % 1024 == 0))
 	{
-		return strdup("");
+		size /= 1024;
+		unit++;
 	}
-	else if (path1Len == 0)
+
+	snprintf(buffer, bufferSize, "%llu %s", size, units[unit]);
+}
+
+/// Compares two owner counters by their file count in descending order. Used with qsort().
+int CompareOwnerCounts(const void* a, const void* b)
+{
+	const struct OwnerCount* ownerA = a;
+	const struct OwnerCount* ownerB = b;
+
+	if (ownerA->fileCount != ownerB->fileCount)
+		return (ownerA->fileCount < ownerB->fileCount) ? 1 : -1;
+
+	return (ownerA->userID > ownerB->userID) - (ownerA->userID < ownerB->userID);
+}
+
+/// Prints the distributions accumulated in the provided summary.
+/// \param summary The summary to print.
+void PrintSummary(struct Summary* summary)
+{
+	assert(summary != NULL);
+
+
+	static const char* typeNames[SUMMARY_TYPE_COUNT] =
 	{
-		return strdup(path2);
-	}
-	else if (path2Len == 0)
+		"regular files", "directories", "symbolic links", "block special files",
+		"character special files", "named pipes", "sockets", "unknown",
+	};
+
+	static const char* ageNames[SUMMARY_AGE_BUCKETS] =
 	{
-		return strdup(path1);
-	}
+		"in the future", "< 1 hour", "< 1 day", "< 1 week", "< 30 days",
+		"< 90 days", "< 1 year", "< 2 years", "< 5 years", ">= 5 years",
+	};
+
+	char lower[32];
+	char upper[32];
 
+	printf("files: %llu, total size: %llu bytes\n", summary->fileCount, summary->byteCount);
 
-	// Allocate sufficient memory for concatenating the paths plus the directory separator and string terminator
-	char* combined = calloc(path1Len + path2Len + 2, sizeof(char));
+	printf("\nsize:\n");
 
-	if (combined == NULL)
+	for (int i = 0; i < SUMMARY_SIZE_BUCKETS; i++)
 	{
-		// Out of memory
-		exit(-1);
+		if (summary->sizeBuckets[i] == 0)
+			continue;
+
+		if (i == 0)
+		{
+			printf("  %-28s %llu\n", "0 B", summary->sizeBuckets[i]);
+		}
+		else
+		{
+			char range[80];
+
+			FormatSize(1ULL << (i - 1), lower, sizeof(lower));
+
+			if (i < 64)
+			{
+				FormatSize(1ULL << i, upper, sizeof(upper));
+				snprintf(range, sizeof(range), "[%s, %s)", lower, upper);
+			}
+			else
+			{
+				snprintf(range, sizeof(range), ">= %s", lower);
+			}
+
+			printf("  %-28s %llu\n", range, summary->sizeBuckets[i]);
+		}
 	}
 
+	printf("\nage (last modification):\n");
 
-	// Check if the first path ends with a directory-separating slash
-	int path1HasTrailingSlash =
-		(path1Len > 0) && (path1[path1Len - 1] == '/');
+	for (int i = 0; i < SUMMARY_AGE_BUCKETS; i++)
+	{
+		if (summary->ageBuckets[i] != 0)
+			printf("  %-28s %llu\n", ageNames[i], summary->ageBuckets[i]);
+	}
 
-	// Check if the second path starts with a directory-separating slash
-	int path2HasLeadingSlash =
-		(path2Len > 0) && (path2[0] == '/');
+	printf("\ntype:\n");
 
-	if (path1HasTrailingSlash && path2HasLeadingSlash)
+	for (int i = 0; i < SUMMARY_TYPE_COUNT; i++)
 	{
-		// Both paths contain a slash; Trim the slash from the first path and concatenate
-		strncat(combined, path1, path1Len - 1);
-		strcat(combined, path2);
+		if (summary->typeCounts[i] != 0)
+			printf("  %-28s %llu\n", typeNames[i], summary->typeCounts[i]);
 	}
-	else if (path1HasTrailingSlash || path2HasLeadingSlash)
+
+	// Compact the used slots of the hash table and sort them by the number of files
+	size_t used = 0;
+
+	for (size_t i = 0; i < summary->ownerCapacity; i++)
 	{
-		// Only one path contains a slash; Concatenate the paths as they are
-		strcat(combined, path1);
-		strcat(combined, path2);
+		if (summary->owners[i].fileCount != 0)
+			summary->owners[used++] = summary->owners[i];
 	}
-	else
+
+	qsort(summary->owners, used, sizeof(struct OwnerCount), CompareOwnerCounts);
+
+	// The table is no longer a valid hash table; Prevent further use
+	summary->ownerCount = 0;
+	summary->ownerCapacity = 0;
+
+	printf("\nowner:\n");
+
+	for (size_t i = 0; (i < used) && (i < SUMMARY_MAX_OWNERS); i++)
 	{
-		// Neither path contains a slash; Concatenate the paths with a slash in between
-		strcat(combined, path1);
-		strcat(combined, "/");
-		strcat(combined, path2);
+		// Names are only resolved here, so that the search itself does not perform any lookups
+		struct passwd* p = getpwuid(summary->owners[i].userID);
+		char name[64];
+
+		if (p != NULL)
+			snprintf(name, sizeof(name), "%s (%u)", p->pw_name, (unsigned int) summary->owners[i].userID);
+		else
+			snprintf(name, sizeof(name), "%u", (unsigned int) summary->owners[i].userID);
+
+		printf("  %-28s %llu files, %llu bytes\n", name, summary->owners[i].fileCount, summary->owners[i].byteCount);
 	}
 
-	return combined;
+	if (used > SUMMARY_MAX_OWNERS)
+		printf("  (%zu more owners)\n", used - SUMMARY_MAX_OWNERS);
 }
 
 
-/// Creates a new file node and adds it to the linked list.
-/// \param head A pointer to the head of the linked list into which the new node should be inserted.
-/// \param fileName The file name to store in the created node.
-/// \return The created file node.
-struct FileNode* AddListNode(struct FileNode** head, char* fileName)
+/// Creates an empty set of duplicate candidates.
+/// \return The created set, which needs to be released with FreeDuplicateSet(), or NULL if the memory could not be allocated.
+struct DuplicateSet* CreateDuplicateSet()
 {
-	assert(head != NULL);
-	assert(fileName != NULL);
+	return calloc(1, sizeof(struct DuplicateSet));
+}
 
+/// Frees the provided set of duplicate candidates, including the paths of all candidates.
+/// \param set The set to free. May be NULL.
+void FreeDuplicateSet(struct DuplicateSet* set)
+{
+	if (set == NULL)
+		return;
 
-	// Create the new node
-	struct FileNode* node = malloc(sizeof(struct FileNode));
+	for (size_t i = 0; i < set->count; i++)
+		free(set->candidates[i].filePath);
+
+	free(set->candidates);
+	free(set);
+}
+
+/// Adds a regular file to the set of duplicate candidates.
+/// \param set The set to add the file to.
+/// \param filePath The path of the file. The string is copied.
+/// \param fileInformation The information of the file as returned by stat().
+void AddDuplicateCandidate(struct DuplicateSet* set, const char* filePath, const struct stat* fileInformation)
+{
+	assert(set != NULL);
+	assert(filePath != NULL);
+	assert(fileInformation != NULL);
 
-	if (node == NULL)
+
+	// Empty files are trivially identical; Reporting them would only bury the interesting groups
+	if (fileInformation->st_size == 0)
+		return;
+
+	if (set->count == set->capacity)
+	{
+		size_t newCapacity = (set->capacity == 0) ? 1024 : set->capacity * 2;
+		struct DuplicateCandidate* newCandidates = realloc(set->candidates, newCapacity * sizeof(struct DuplicateCandidate));
+
+		if (newCandidates == NULL)
+		{
+			// Out of memory
+			exit(-1);
+		}
+
+		set->candidates = newCandidates;
+		set->capacity = newCapacity;
+	}
+
+	struct DuplicateCandidate* candidate = &set->candidates[set->count++];
+
+	memset(candidate, 0, sizeof(struct DuplicateCandidate));
+	candidate->filePath = strdup(filePath);
+	candidate->size = fileInformation->st_size;
+	candidate->device = fileInformation->st_dev;
+	candidate->inode = fileInformation->st_ino;
+
+	if (candidate->filePath == NULL)
 	{
 		// Out of memory
 		exit(-1);
 	}
+}
+
+/// Determines which of the collected files have identical content and prints them in groups separated by empty lines.
+/// Files are only read if their size matches the one of another file, and only read completely if their first
+/// DUPLICATE_PREFIX_SIZE bytes match as well.
+/// \param set The collected candidates. The set is reordered and shrunk in the process.
+/// \param threadCount The maximum number of threads used to read the files.
+void FindDuplicates(struct DuplicateSet* set, unsigned int threadCount)
+{
+	assert(set != NULL);
 
-	node->fileName = strdup(fileName);
-	node->next = NULL;
 
+	// Hard links share their content without wasting any space; Only keep one path per inode
+	qsort(set->candidates, set->count, sizeof(struct DuplicateCandidate), CompareCandidateIdentity);
 
-	// Add the node to the list
-	if (*head == NULL)
+	size_t kept = 0;
+
+	for (size_t i = 0; i < set->count; i++)
 	{
-		// This is the first element
-		*head = node;
+		bool isHardLink = (kept > 0) &&
+			(set->candidates[kept - 1].device == set->candidates[i].device) &&
+			(set->candidates[kept - 1].inode == set->candidates[i].inode);
+
+		if (isHardLink)
+			free(set->candidates[i].filePath);
+		else
+			set->candidates[kept++] = set->candidates[i];
 	}
-	else
+
+	set->count = kept;
+
+	// Files with a unique size cannot have a duplicate; Discard them without reading anything
+	qsort(set->candidates, set->count, sizeof(struct DuplicateCandidate), CompareCandidateSize);
+	KeepDuplicateGroups(set, CompareCandidateSize);
+
+	// Hash the beginning of the remaining files, which tells most files of equal size apart
+	if (!ParallelFor(set->count, threadCount, DUPLICATE_PREFIX_SIZE, HashCandidatePrefix, set))
 	{
-		// Find the last node in the list
-		struct FileNode* tail = *head;
+		fprintf(stderr, "myfind: Out of memory.\n");
 
-		while (tail->next != NULL)
-			tail = tail->next;
+		return;
+	}
 
-		// Add the new node at the end of the list
-		tail->next = node;
+	qsort(set->candidates, set->count, sizeof(struct DuplicateCandidate), CompareCandidatePrefix);
+	KeepDuplicateGroups(set, CompareCandidatePrefix);
+
+	// Only the survivors are read completely
+	if (!ParallelFor(set->count, threadCount, DUPLICATE_READ_SIZE, HashCandidateContent, set))
+	{
+		fprintf(stderr, "myfind: Out of memory.\n");
+
+		return;
 	}
 
-	return node;
+	qsort(set->candidates, set->count, sizeof(struct DuplicateCandidate), CompareCandidateContent);
+	KeepDuplicateGroups(set, CompareCandidateContent);
+
+	// Print the largest groups of wasted space first, with the paths of each group in a stable order
+	qsort(set->candidates, set->count, sizeof(struct DuplicateCandidate), CompareCandidateOutput);
+
+	for (size_t i = 0; i < set->count; i++)
+	{
+		// Nobody reads the remaining groups once the output has failed
+		if (ferror(stdout))
+			break;
+
+		if ((i > 0) && (CompareCandidateContent(&set->candidates[i - 1], &set->candidates[i]) != 0))
+			printf("\n");
+
+		printf("%s\n", set->candidates[i].filePath);
+	}
 }
 
-/// Frees all nodes in the provided linked list.
-/// \param head A pointer to the head of the linked list to be freed.
-void FreeList(struct FileNode** head)
+/// Removes all candidates that are either unreadable or not equal to any of their neighbours.
+/// \param set The set of candidates, which must be sorted so that equal candidates are adjacent.
+/// \param compare The function that returns zero for candidates belonging to the same group.
+/// \return The number of remaining candidates.
+size_t KeepDuplicateGroups(struct DuplicateSet* set, int (*compare)(const void*, const void*))
 {
-	assert(head != NULL);
+	assert(set != NULL);
+	assert(compare != NULL);
 
 
-	// Keep freeing nodes until all have been removed
-	while (*head != NULL)
+	struct DuplicateCandidate* candidates = set->candidates;
+	size_t kept = 0;
+	size_t groupStart = 0;
+
+	while (groupStart < set->count)
 	{
-		// Preserve a pointer to the current head
-		struct FileNode* current = *head;
+		// Find the end of the group of equal candidates
+		size_t groupEnd = groupStart + 1;
+
+		while ((groupEnd < set->count) && (compare(&candidates[groupStart], &candidates[groupEnd]) == 0))
+			groupEnd++;
 
-		// Advance the head to the next node
-		*head = (*head)->next;
+		// Count the readable members of the group
+		size_t readable = 0;
+
+		for (size_t i = groupStart; i < groupEnd; i++)
+		{
+			if (!candidates[i].readFailed)
+				readable++;
+		}
+
+		for (size_t i = groupStart; i < groupEnd; i++)
+		{
+			if ((readable >= 2) && !candidates[i].readFailed)
+				candidates[kept++] = candidates[i];
+			else
+				free(candidates[i].filePath);
+		}
 
-		// Free the previous head
-		free(current->fileName);
-		free(current);
+		groupStart = groupEnd;
 	}
-}
 
+	set->count = kept;
 
-/// Determines whether the file with the provided path and information should be printed based on the application's command line arguments.
-/// \param filePath The path of the file to be printed.
-/// \param fileInformation The information of the file as returned by stat().
-/// \param args The command line options that specify the criteria by which to select the files to be printed.
-bool ShouldPrintFileInformation(char* filePath, struct stat* fileInformation, struct Args* args)
-{
-	assert(filePath != NULL);
-	assert(fileInformation != NULL);
-	assert(args != NULL);
+	return kept;
+}
 
+/// Hashes the first DUPLICATE_PREFIX_SIZE bytes of a candidate. Executed by ParallelFor().
+/// \param index The index of the candidate in the set.
+/// \param buffer The worker's scratch buffer of at least DUPLICATE_PREFIX_SIZE bytes.
+/// \param context The struct DuplicateSet containing the candidate.
+void HashCandidatePrefix(size_t index, void* buffer, void* context)
+{
+	struct DuplicateSet* set = context;
+	struct DuplicateCandidate* candidate = &set->candidates[index];
 
-	// TODO:
-	// Apply the command line actions to determine whether this file should
-	// be ignored. Exit without printing any information in that case.
+	int fd = open(candidate->filePath, O_RDONLY | O_NOCTTY | O_CLOEXEC);
 
-	if (args->filterByFileType)
+	if (fd == -1)
 	{
-		// Return whether the file is of any of the types specified in args
-		return
-			(S_ISBLK(fileInformation->st_mode) && (args->fileTypes & BlockSpecialFile)) ||
-			(S_ISCHR(fileInformation->st_mode) && (args->fileTypes & CharacterSpecialFile)) ||
-			(S_ISDIR(fileInformation->st_mode) && (args->fileTypes & Directory)) ||
-			(S_ISFIFO(fileInformation->st_mode) && (args->fileTypes & NamedPipe)) ||
-			(S_ISREG(fileInformation->st_mode) && (args->fileTypes & RegularFile)) ||
-			(S_ISLNK(fileInformation->st_mode) && (args->fileTypes & SymbolicLink)) ||
-			(S_ISSOCK(fileInformation->st_mode) && (args->fileTypes & Socket));
+		fprintf(stderr, "Opening file \"%s\" has failed with error code %d: %s\n", candidate->filePath, errno, strerror(errno));
+		candidate->readFailed = true;
+
+		return;
 	}
-	else if (args->filterByUserID)
+
+	ssize_t length;
+
+	do
 	{
-		if ((unsigned int) fileInformation->st_uid == (unsigned int) args->userID)
-		{
-			return true;
-		}
-		else return false;
+		length = pread(fd, buffer, DUPLICATE_PREFIX_SIZE, 0);
+	} while ((length == -1) && (errno == EINTR));
+
+	if (length == -1)
+	{
+		fprintf(stderr, "Reading file \"%s\" has failed with error code %d: %s\n", candidate->filePath, errno, strerror(errno));
+		candidate->readFailed = true;
 	}
-	else if (args->filterForNoUser)
+	else
 	{
-		struct passwd *p;
-		p = (getpwuid(fileInformation->st_uid));
+		candidate->prefixHash = Hash64(buffer, length, 0);
 
-			if (p == NULL)
-			{
-				return true;
-			}
-			return false;
-						
+		ThreadStats.filesRead++;
+		ThreadStats.bytesRead += length;
+
+		// For small files the prefix already is the whole content
+		if (candidate->size <= DUPLICATE_PREFIX_SIZE)
+			candidate->contentHash = candidate->prefixHash;
 	}
-	else if (args->filterByGroupID)
+
+	close(fd);
+}
+
+/// Hashes the entire content of a candidate. Executed by ParallelFor().
+/// \param index The index of the candidate in the set.
+/// \param buffer The worker's scratch buffer of DUPLICATE_READ_SIZE bytes.
+/// \param context The struct DuplicateSet containing the candidate.
+void HashCandidateContent(size_t index, void* buffer, void* context)
+{
+	struct DuplicateSet* set = context;
+	struct DuplicateCandidate* candidate = &set->candidates[index];
+
+	// The content hash of small files was already computed along with the prefix
+	if (candidate->size <= DUPLICATE_PREFIX_SIZE)
+		return;
+
+	int fd = open(candidate->filePath, O_RDONLY | O_NOCTTY | O_CLOEXEC);
+
+	if (fd == -1)
 	{
-		if ((unsigned int)fileInformation->st_gid == (unsigned int)args->groupID)
-		{
-			return true;
-		}
-		else return false;
+		fprintf(stderr, "Opening file \"%s\" has failed with error code %d: %s\n", candidate->filePath, errno, strerror(errno));
+		candidate->readFailed = true;
+
+		return;
 	}
-	else if (args->filterForNoGroup)
+
+	// Let the kernel read ahead aggressively, since the file is consumed front to back
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	struct Hash64State state;
+	off_t offset = 0;
+
+	Hash64Init(&state, 0);
+
+	while (true)
 	{
-		struct group *g;
-		g = (getgrgid(fileInformation->st_gid));
+		ssize_t length = pread(fd, buffer, DUPLICATE_READ_SIZE, offset);
 
-		if (g == NULL)
+		if (length == -1)
 		{
-			return true;
+			if (errno == EINTR)
+				continue;
+
+			fprintf(stderr, "Reading file \"%s\" has failed with error code %d: %s\n", candidate->filePath, errno, strerror(errno));
+			candidate->readFailed = true;
+
+			break;
 		}
-		return false;
 
+		if (length == 0)
+			break;
+
+		Hash64Update(&state, buffer, length);
+		offset += length;
+		ThreadStats.bytesRead += length;
 	}
-	else if (args->filterForNamePattern)
+
+	candidate->contentHash = Hash64Final(&state);
+
+	close(fd);
+}
+
+/// Orders candidates by their device, inode number and path, so that hard links to the same file are adjacent. Used with qsort().
+int CompareCandidateIdentity(const void* a, const void* b)
+{
+	const struct DuplicateCandidate* candidateA = a;
+	const struct DuplicateCandidate* candidateB = b;
+
+	if (candidateA->device != candidateB->device)
+		return (candidateA->device < candidateB->device) ? -1 : 1;
+
+	if (candidateA->inode != candidateB->inode)
+		return (candidateA->inode < candidateB->inode) ? -1 : 1;
+
+	// Make the lexicographically first path the representative of the inode
+	return strcmp(candidateA->filePath, candidateB->filePath);
+}
+
+/// Orders candidates by their size. Used with qsort().
+int CompareCandidateSize(const void* a, const void* b)
+{
+	const struct DuplicateCandidate* candidateA = a;
+	const struct DuplicateCandidate* candidateB = b;
+
+	return (candidateA->size > candidateB->size) - (candidateA->size < candidateB->size);
+}
+
+/// Orders candidates by their size and prefix hash. Used with qsort().
+int CompareCandidatePrefix(const void* a, const void* b)
+{
+	const struct DuplicateCandidate* candidateA = a;
+	const struct DuplicateCandidate* candidateB = b;
+
+	int result = CompareCandidateSize(a, b);
+
+	if (result != 0)
+		return result;
+
+	return (candidateA->prefixHash > candidateB->prefixHash) - (candidateA->prefixHash < candidateB->prefixHash);
+}
+
+/// Orders candidates by their size, prefix hash and content hash. Used with qsort().
+int CompareCandidateContent(const void* a, const void* b)
+{
+	const struct DuplicateCandidate* candidateA = a;
+	const struct DuplicateCandidate* candidateB = b;
+
+	int result = CompareCandidatePrefix(a, b);
+
+	if (result != 0)
+		return result;
+
+	return (candidateA->contentHash > candidateB->contentHash) - (candidateA->contentHash < candidateB->contentHash);
+}
+
+/// Orders candidates by descending size, keeping groups of identical content together and sorting each group by path. Used with qsort().
+int CompareCandidateOutput(const void* a, const void* b)
+{
+	const struct DuplicateCandidate* candidateA = a;
+	const struct DuplicateCandidate* candidateB = b;
+
+	int result = CompareCandidateContent(b, a);
+
+	if (result != 0)
+		return result;
+
+	return strcmp(candidateA->filePath, candidateB->filePath);
+}
+
+
+/// Searches the content of a file for the literal and computes its checksum as specified on the command line. Executed by the worker threads of the content pipeline.
+/// \param item The struct ContentJob describing the file.
+/// \param buffer The worker's scratch buffer of CONTENT_READ_SIZE plus the literal's length bytes.
+/// \param context The command line options containing the literal and checksum algorithm.
+void ProcessContentJob(void* item, void* buffer, void* context)
+{
+	struct ContentJob* job = item;
+	struct Args* args = context;
+
+	job->matched = !args->filterForContent ||
+		FileContainsLiteral(job->filePath, args->contentLiteral, args->contentLiteralLength, buffer);
+
+	if (job->matched && (args->checksumAlgorithm != NoChecksum))
 	{
-		char* f = basename(filePath);
-		if (fnmatch(args->namePattern, f, 0) != 0)
-		{
-			return true;
-		}
-		else return false;
+		// A file that cannot be read has no checksum and is therefore not printed
+		job->matched = ComputeChecksum(job->filePath, args->checksumAlgorithm, buffer, job->checksum);
 	}
-	else if (args->filterForPathPattern)
+}
+
+/// Handles a file whose content has been searched, in the order in which the files were found.
+/// \param item The processed struct ContentJob, which is freed.
+/// \param context The command line options specifying how to handle matching files.
+void EmitContentJob(void* item, void* context)
+{
+	struct ContentJob* job = item;
+	struct Args* args = context;
+
+	if (job->matched)
+		ProcessMatchingFile(job->filePath, &job->fileInfo, (job->checksum[0] != '\0') ? job->checksum : NULL, args);
+
+	free(job->filePath);
+	free(job);
+}
+
+/// Determines whether the content of a file contains the provided literal, stopping at the first occurrence.
+/// \param filePath The path of the file to search.
+/// \param literal The byte sequence to search for.
+/// \param literalLength The number of bytes in \p literal.
+/// \param buffer A buffer of at least CONTENT_READ_SIZE plus \p literalLength bytes.
+/// \return true if the literal occurs in the file. false if it does not or the file could not be read.
+bool FileContainsLiteral(char* filePath, char* literal, size_t literalLength, char* buffer)
+{
+	assert(filePath != NULL);
+	assert(literal != NULL);
+	assert(buffer != NULL);
+
+
+	int fd = open(filePath, O_RDONLY | O_NOCTTY | O_CLOEXEC);
+
+	if (fd == -1)
 	{
-		return true;
-		
+		fprintf(stderr, "Opening file \"%s\" has failed with error code %d: %s\n", filePath, errno, strerror(errno));
+
 		return false;
 	}
 
-	return true;
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	ThreadStats.filesRead++;
+
+	bool found = false;
+	off_t offset = 0;
+
+	// The number of bytes carried over from the previous read at the start of the buffer
+	size_t carried = 0;
+
+	while (!found)
+	{
+		ssize_t length = pread(fd, buffer + carried, CONTENT_READ_SIZE, offset);
+
+		if (length == -1)
+		{
+			if (errno == EINTR)
+				continue;
+
+			fprintf(stderr, "Reading file \"%s\" has failed with error code %d: %s\n", filePath, errno, strerror(errno));
+
+			break;
+		}
+
+		if (length == 0)
+			break;
+
+		size_t available = carried + length;
+
+		found = (FindLiteral(buffer, available, literal, literalLength) != NULL);
+		offset += length;
+		ThreadStats.bytesRead += length;
+
+		// Keep the bytes that could be the beginning of a match crossing into the next read
+		carried = (literalLength > 1)
+			? ((available < literalLength - 1) ? available : literalLength - 1)
+			: 0;
+
+		memmove(buffer, buffer + available - carried, carried);
+	}
+
+	close(fd);
+
+	// An empty literal is contained in every file, even in an empty one
+	return found || (literalLength == 0);
 }
 
-/// Prints the information of a single file or directory.
-/// \param filePath The path of the file to be printed.
-/// \param fileInformation The information of the file as returned by stat().
-/// \param args The command line options that specify the format in which to print the file's information.
-/// \return The created file node.
-void PrintFileInformation(char* filePath, struct stat* fileInformation, struct Args* args)
+
+/// Computes the checksum of a file's content.
+/// \param filePath The path of the file to hash.
+/// \param algorithm The algorithm used to compute the checksum.
+/// \param buffer A buffer of at least CONTENT_READ_SIZE bytes.
+/// \param checksum The character array of SHA256_DIGEST_SIZE * 2 + 1 characters in which to store the hexadecimal checksum.
+/// \return true if the checksum could be computed. false if the file could not be read.
+bool ComputeChecksum(char* filePath, enum ChecksumAlgorithms algorithm, char* buffer, char* checksum)
 {
 	assert(filePath != NULL);
-	assert(fileInformation != NULL);
-	assert(args != NULL);
+	assert(algorithm != NoChecksum);
+	assert(buffer != NULL);
+	assert(checksum != NULL);
 
 
-	if (args->printInExtendedFormat)
+	int fd = open(filePath, O_RDONLY | O_NOCTTY | O_CLOEXEC);
+
+	if (fd == -1)
 	{
-		// TODO: Print in extended list format
+		fprintf(stderr, "Opening file \"%s\" has failed with error code %d: %s\n", filePath, errno, strerror(errno));
+
+		return false;
+	}
+
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	ThreadStats.filesRead++;
+
+	struct Hash64State hash64;
+	struct Sha256State sha256;
+
+	Hash64Init(&hash64, 0);
+	Sha256Init(&sha256);
+
+	bool succeeded = true;
+	off_t offset = 0;
+
+	while (true)
+	{
+		ssize_t length = pread(fd, buffer, CONTENT_READ_SIZE, offset);
+
+		if (length == -1)
+		{
+			if (errno == EINTR)
+				continue;
+
+			fprintf(stderr, "Reading file \"%s\" has failed with error code %d: %s\n", filePath, errno, strerror(errno));
+			succeeded = false;
+
+			break;
+		}
+
+		if (length == 0)
+			break;
+
+		if (algorithm == ChecksumXXH64)
+			Hash64Update(&hash64, buffer, length);
+		else
+			Sha256Update(&sha256, buffer, length);
+
+		offset += length;
+		ThreadStats.bytesRead += length;
+	}
+
+	close(fd);
+
+	if (!succeeded)
+		return false;
+
+	if (algorithm == ChecksumXXH64)
+	{
+		snprintf(checksum, SHA256_DIGEST_SIZE * 2 + 1, "%016llx", (unsigned long long) Hash64Final(&hash64));
 	}
 	else
 	{
-		// Simply print the path of the file
-		printf("%s\n", filePath);
+		unsigned char digest[SHA256_DIGEST_SIZE];
+
+		Sha256Final(&sha256, digest);
+
+		for (int i = 0; i < SHA256_DIGEST_SIZE; i++)
+			snprintf(checksum + i * 2, 3, "%02x", digest[i]);
 	}
+
+	return true;
 }
@@ -0,0 +1,142 @@
+/// \file output.c
+/// Detects that the reader of the output has gone away, e.g. "head" at the end of a pipe.
+///
+/// A write to a pipe without readers fails, but a search that finds nothing for a
+/// while does not write anything. A thread therefore waits in poll() for the error
+/// condition that the kernel reports on the writing end as soon as the last reader
+/// has closed it, which costs the search itself nothing.
+
+
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "output.h"
+
+
+
+/// The state of a thread watching a single output.
+struct OutputWatch
+{
+	/// The file descriptor of the output.
+	int fd;
+
+	/// A pipe whose reading end wakes up the thread when the watch is stopped.
+	int wakeFds[2];
+
+	/// The watching thread.
+	pthread_t thread;
+
+	/// The function to call once the reader has gone away.
+	OutputClosed closed;
+
+	/// The context pointer passed to \p closed.
+	void* context;
+};
+
+
+
+/// Waits until the reader of the output has gone away or the watch is stopped.
+/// \param argument A pointer to the struct OutputWatch to run.
+/// \return Always NULL.
+static void* RunOutputWatch(void* argument)
+{
+	struct OutputWatch* watch = argument;
+
+	// No events are requested for the output; Errors and hangups are always reported
+	struct pollfd fds[2] =
+	{
+		{ .fd = watch->fd, .events = 0 },
+		{ .fd = watch->wakeFds[0], .events = POLLIN },
+	};
+
+	while (true)
+	{
+		if (poll(fds, 2, -1) == -1)
+		{
+			if (errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		if (fds[1].revents != 0)
+			break;
+
+		if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+		{
+			watch->closed(watch->context);
+
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/// Starts a thread that calls \p closed once the reader of the output has gone away.
+/// \param fd The file descriptor of the output. Only pipes and sockets are watched, as other files do not have a reader that could go away.
+/// \param closed The function to call once the reader has gone away.
+/// \param context The context pointer passed to \p closed.
+/// \return The watch, which needs to be stopped with StopOutputWatch(). NULL if the output is not watched.
+struct OutputWatch* StartOutputWatch(int fd, OutputClosed closed, void* context)
+{
+	assert(closed != NULL);
+
+
+	struct stat info;
+
+	if ((fstat(fd, &info) == -1) || !(S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode)))
+		return NULL;
+
+	struct OutputWatch* watch = calloc(1, sizeof(struct OutputWatch));
+
+	if (watch == NULL)
+		return NULL;
+
+	watch->fd = fd;
+	watch->closed = closed;
+	watch->context = context;
+
+	if (pipe(watch->wakeFds) == -1)
+	{
+		free(watch);
+
+		return NULL;
+	}
+
+	if (pthread_create(&watch->thread, NULL, RunOutputWatch, watch) != 0)
+	{
+		close(watch->wakeFds[0]);
+		close(watch->wakeFds[1]);
+		free(watch);
+
+		return NULL;
+	}
+
+	return watch;
+}
+
+/// Stops the watching thread and frees the watch. Once this function returns, \p closed is not called anymore.
+/// \param watch The watch to stop. May be NULL.
+void StopOutputWatch(struct OutputWatch* watch)
+{
+	if (watch == NULL)
+		return;
+
+	// Wake up the thread; If it has already exited, the byte is simply never read
+	while ((write(watch->wakeFds[1], "", 1) == -1) && (errno == EINTR))
+		;
+
+	pthread_join(watch->thread, NULL);
+
+	close(watch->wakeFds[0]);
+	close(watch->wakeFds[1]);
+	free(watch);
+}
@@ -0,0 +1,20 @@
+/// \file output.h
+/// Detects that the reader of the output has gone away, e.g. "head" at the end of a pipe.
+
+
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+
+
+/// The function called once the reader of the watched output has gone away. It is called on the watching thread.
+/// \param context The context pointer that was passed to StartOutputWatch().
+typedef void (*OutputClosed)(void* context);
+
+struct OutputWatch;
+
+struct OutputWatch* StartOutputWatch(int fd, OutputClosed closed, void* context);
+void StopOutputWatch(struct OutputWatch* watch);
+
+#endif
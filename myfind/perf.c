@@ -0,0 +1,268 @@
+/// \file perf.c
+/// Hardware performance counters read through perf_event_open(), reported with "-D perf".
+///
+/// All events are opened as a single group, so that they are scheduled onto the
+/// processor together and a single read() returns consistent values for all of
+/// them. Phase boundaries cost one read() each, which is why phases are only
+/// measured on request.
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf.h"
+
+
+
+/// The layout of a group read with PERF_FORMAT_GROUP, PERF_FORMAT_TOTAL_TIME_ENABLED and PERF_FORMAT_TOTAL_TIME_RUNNING.
+struct PerfGroupRead
+{
+	/// The number of values.
+	uint64_t count;
+
+	/// The nanoseconds during which the group was enabled.
+	uint64_t timeEnabled;
+
+	/// The nanoseconds during which the group was actually counting on the processor.
+	uint64_t timeRunning;
+
+	/// The value of each event in the group.
+	uint64_t values[PerfEventCount];
+};
+
+
+
+/// Opens a single hardware event for the calling thread.
+/// \param config The PERF_COUNT_HW_* event to count.
+/// \param groupFd The file descriptor of the group leader, or -1 to open a new group.
+/// \return The file descriptor of the event, or -1 if it is not available.
+static int OpenPerfEvent(uint64_t config, int groupFd)
+{
+	struct perf_event_attr attributes;
+
+	memset(&attributes, 0, sizeof(attributes));
+	attributes.size = sizeof(attributes);
+	attributes.type = PERF_TYPE_HARDWARE;
+	attributes.config = config;
+	attributes.disabled = (groupFd == -1);
+	attributes.exclude_hv = 1;
+	attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// Most of the search is spent in system calls; Count the kernel too, unless this is not permitted
+	int fd = syscall(SYS_perf_event_open, &attributes, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC);
+
+	if (fd == -1)
+	{
+		attributes.exclude_kernel = 1;
+		fd = syscall(SYS_perf_event_open, &attributes, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC);
+	}
+
+	return fd;
+}
+
+/// Returns the file descriptor of the group leader.
+static int GetPerfLeader(struct PerfCounters* counters)
+{
+	for (int i = 0; i < PerfEventCount; i++)
+	{
+		if (counters->fds[i] != -1)
+			return counters->fds[i];
+	}
+
+	return -1;
+}
+
+/// Reads the current values of all events in the group.
+/// \return true if the values could be read. Otherwise, false.
+static bool ReadPerfGroup(struct PerfCounters* counters, struct PerfGroupRead* group)
+{
+	ssize_t expected = (ssize_t) (sizeof(uint64_t) * (3 + counters->eventCount));
+
+	return read(GetPerfLeader(counters), group, sizeof(*group)) == expected;
+}
+
+/// Opens the performance counters for the calling thread. The counters are not started yet.
+/// \return The opened counters, which need to be released with ClosePerfCounters(), or NULL if no hardware events are available.
+struct PerfCounters* OpenPerfCounters()
+{
+	static const uint64_t configs[PerfEventCount] =
+	{
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES,
+	};
+
+	struct PerfCounters* counters = calloc(1, sizeof(struct PerfCounters));
+
+	if (counters == NULL)
+		return NULL;
+
+	int leader = -1;
+
+	for (int i = 0; i < PerfEventCount; i++)
+	{
+		counters->fds[i] = OpenPerfEvent(configs[i], leader);
+		counters->positions[i] = -1;
+
+		if (counters->fds[i] == -1)
+			continue;
+
+		if (leader == -1)
+			leader = counters->fds[i];
+
+		// Values are returned in the order in which the events joined the group
+		counters->positions[i] = counters->eventCount++;
+	}
+
+	if (leader == -1)
+	{
+		// No hardware events, e.g. in a virtual machine or due to perf_event_paranoid
+		free(counters);
+
+		return NULL;
+	}
+
+	return counters;
+}
+
+/// Closes the performance counters.
+/// \param counters The counters to close. May be NULL.
+void ClosePerfCounters(struct PerfCounters* counters)
+{
+	if (counters == NULL)
+		return;
+
+	for (int i = 0; i < PerfEventCount; i++)
+	{
+		if (counters->fds[i] != -1)
+			close(counters->fds[i]);
+	}
+
+	free(counters);
+}
+
+/// Resets and starts all counters of the group.
+/// \param counters The counters to start.
+void StartPerfCounters(struct PerfCounters* counters)
+{
+	assert(counters != NULL);
+
+
+	int leader = GetPerfLeader(counters);
+
+	ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+/// Stops all counters of the group and stores their final values in \p totals.
+/// \param counters The counters to stop.
+void StopPerfCounters(struct PerfCounters* counters)
+{
+	assert(counters != NULL);
+
+
+	ioctl(GetPerfLeader(counters), PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+	struct PerfGroupRead group;
+
+	if (!ReadPerfGroup(counters, &group))
+		return;
+
+	for (int i = 0; i < PerfEventCount; i++)
+	{
+		if (counters->positions[i] == -1)
+			continue;
+
+		uint64_t value = group.values[counters->positions[i]];
+
+		// Extrapolate if the group had to share the processor's counters with other groups
+		if ((group.timeRunning > 0) && (group.timeRunning < group.timeEnabled))
+			value = (uint64_t) ((double) value * group.timeEnabled / group.timeRunning);
+
+		counters->totals[i] = value;
+	}
+}
+
+/// Records the counter values at the beginning of a phase.
+/// \param counters The running counters.
+void BeginPerfPhase(struct PerfCounters* counters)
+{
+	assert(counters != NULL);
+
+
+	struct PerfGroupRead group;
+
+	if (!ReadPerfGroup(counters, &group))
+		return;
+
+	for (int i = 0; i < PerfEventCount; i++)
+	{
+		if (counters->positions[i] != -1)
+			counters->phaseStart[i] = group.values[counters->positions[i]];
+	}
+}
+
+/// Attributes the events counted since BeginPerfPhase() to the specified phase.
+/// \param counters The running counters.
+/// \param phase The phase that has just ended.
+void EndPerfPhase(struct PerfCounters* counters, enum PerfPhase phase)
+{
+	assert(counters != NULL);
+
+
+	struct PerfGroupRead group;
+
+	if (!ReadPerfGroup(counters, &group))
+		return;
+
+	for (int i = 0; i < PerfEventCount; i++)
+	{
+		if (counters->positions[i] != -1)
+			counters->phaseTotals[phase][i] += group.values[counters->positions[i]] - counters->phaseStart[i];
+	}
+}
+
+/// Prints the counted events in total and per phase.
+/// \param counters The stopped counters.
+/// \param stream The stream to print to.
+void PrintPerfCounters(struct PerfCounters* counters, FILE* stream)
+{
+	assert(counters != NULL);
+	assert(stream != NULL);
+
+
+	static const char* eventNames[PerfEventCount] = { "cycles", "instructions", "cache misses", "branch misses" };
+	static const char* phaseNames[PerfPhaseCount] = { "readdir", "stat", "filter", "print" };
+
+	fprintf(stream, "myfind performance counters:\n");
+	fprintf(stream, "  %-14s %16s", "", "total");
+
+	for (int p = 0; p < PerfPhaseCount; p++)
+		fprintf(stream, " %16s", phaseNames[p]);
+
+	fprintf(stream, "\n");
+
+	for (int i = 0; i < PerfEventCount; i++)
+	{
+		if (counters->positions[i] == -1)
+			continue;
+
+		fprintf(stream, "  %-14s %16llu", eventNames[i], (unsigned long long) counters->totals[i]);
+
+		for (int p = 0; p < PerfPhaseCount; p++)
+			fprintf(stream, " %16llu", (unsigned long long) counters->phaseTotals[p][i]);
+
+		fprintf(stream, "\n");
+	}
+
+	// Instructions per cycle are the most telling single figure
+	if ((counters->positions[PerfCycles] != -1) && (counters->positions[PerfInstructions] != -1) && (counters->totals[PerfCycles] > 0))
+		fprintf(stream, "  %-14s %16.2f\n", "IPC", (double) counters->totals[PerfInstructions] / counters->totals[PerfCycles]);
+}
@@ -0,0 +1,83 @@
+/// \file perf.h
+/// Hardware performance counters read through perf_event_open(), reported with "-D perf".
+
+
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+
+/// The hardware events that are counted.
+enum PerfEvent
+{
+	/// CPU cycles.
+	PerfCycles = 0,
+
+	/// Retired instructions.
+	PerfInstructions,
+
+	/// Last level cache misses.
+	PerfCacheMisses,
+
+	/// Mispredicted branches.
+	PerfBranchMisses,
+
+	/// The number of events.
+	PerfEventCount,
+};
+
+/// The phases of the search to which the counted events are attributed.
+enum PerfPhase
+{
+	/// Opening and reading directories.
+	PerfPhaseReaddir = 0,
+
+	/// Reading file information with lstat().
+	PerfPhaseStat,
+
+	/// Applying the search criteria.
+	PerfPhaseFilter,
+
+	/// Printing or otherwise handling matching files.
+	PerfPhasePrint,
+
+	/// The number of phases.
+	PerfPhaseCount,
+};
+
+/// A group of performance counters for the calling thread.
+struct PerfCounters
+{
+	/// The file descriptor of each event, or -1 if the event is not supported. The first supported event leads the group.
+	int fds[PerfEventCount];
+
+	/// The position of each event's value in the group read, or -1 if the event is not supported.
+	int positions[PerfEventCount];
+
+	/// The number of supported events.
+	int eventCount;
+
+	/// The counter values at the beginning of the current phase.
+	uint64_t phaseStart[PerfEventCount];
+
+	/// The events counted per phase.
+	uint64_t phaseTotals[PerfPhaseCount][PerfEventCount];
+
+	/// The events counted between StartPerfCounters() and StopPerfCounters(), scaled for multiplexing.
+	uint64_t totals[PerfEventCount];
+};
+
+struct PerfCounters* OpenPerfCounters();
+void ClosePerfCounters(struct PerfCounters* counters);
+void StartPerfCounters(struct PerfCounters* counters);
+void StopPerfCounters(struct PerfCounters* counters);
+void BeginPerfPhase(struct PerfCounters* counters);
+void EndPerfPhase(struct PerfCounters* counters, enum PerfPhase phase);
+void PrintPerfCounters(struct PerfCounters* counters, FILE* stream);
+
+#endif
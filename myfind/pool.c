@@ -0,0 +1,708 @@
+/// \file pool.c
+/// Helpers for distributing independent work items across a set of worker threads.
+///
+/// The best number of workers depends on the storage: Local SSDs are CPU-bound
+/// and need few threads, network file systems are latency-bound and need many
+/// requests in flight. An adaptive pipeline therefore starts with few workers
+/// and adjusts their number like TCP adjusts its window: It adds one worker at
+/// a time while items are waiting, and halves the workers once more of them
+/// only make each item slower without increasing the throughput.
+
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "pool.h"
+#include "stats.h"
+#include "latency.h"
+
+
+
+/// The alignment of the scratch buffers handed to the workers. Matches the page size so that buffers are suitable for direct I/O.
+#define POOL_BUFFER_ALIGNMENT 4096
+
+/// The number of items that may be in flight in an ordered pipeline per worker thread.
+#define PIPELINE_ITEMS_PER_WORKER 16
+
+/// The number of workers an adaptive pipeline starts with.
+#define PIPELINE_ADAPTIVE_INITIAL_THREADS 2
+
+/// The minimum time between two adjustments of an adaptive pipeline, in nanoseconds.
+#define PIPELINE_ADJUST_INTERVAL_NANOSECONDS 100000000u
+
+/// The factor by which the mean processing time of the items may exceed its minimum before an adaptive pipeline considers the storage congested.
+#define PIPELINE_CONGESTION_FACTOR 2.0
+
+/// The relative gain in throughput that justifies a congested storage.
+#define PIPELINE_THROUGHPUT_GAIN 1.1
+
+/// The shared state of a single parallel loop.
+struct ParallelLoop
+{
+	/// The index of the next item that has not been claimed by any worker.
+	atomic_size_t nextIndex;
+
+	/// The total number of items to process.
+	size_t itemCount;
+
+	/// The size in bytes of each worker's scratch buffer.
+	size_t bufferSize;
+
+	/// The function to execute for each item.
+	ParallelWork work;
+
+	/// The context pointer passed to \p work.
+	void* context;
+};
+
+
+/// A worker thread of an ordered pipeline.
+struct PipelineWorker
+{
+	/// The thread executing the worker.
+	pthread_t thread;
+
+	/// The pipeline the worker belongs to.
+	struct OrderedPipeline* pipeline;
+
+	/// The scratch buffer owned by the worker. NULL if no buffer was requested.
+	void* buffer;
+};
+
+/// A bounded window of items that are processed by worker threads and handed back in submission order.
+struct OrderedPipeline
+{
+	/// Protects all members below that are modified after the pipeline was created.
+	pthread_mutex_t lock;
+
+	/// Signalled when an item was submitted or the pipeline is shutting down.
+	pthread_cond_t itemSubmitted;
+
+	/// Signalled when a worker has finished processing an item.
+	pthread_cond_t itemProcessed;
+
+	/// The ring buffer of submitted items that have not been emitted yet.
+	void** items;
+
+	/// Indicates for each slot in \p items whether the item has been processed.
+	bool* processed;
+
+	/// The number of slots in \p items.
+	size_t capacity;
+
+	/// The sequence number of the oldest item that has not been emitted yet.
+	size_t head;
+
+	/// The sequence number of the oldest item that has not been claimed by any worker.
+	size_t next;
+
+	/// The sequence number that will be assigned to the next submitted item.
+	size_t tail;
+
+	/// Indicates whether the workers should exit once no items are left.
+	bool shuttingDown;
+
+	/// Indicates whether the remaining items should be emitted without being processed.
+	bool cancelled;
+
+	/// The worker threads.
+	struct PipelineWorker* workers;
+
+	/// The number of successfully started worker threads.
+	unsigned int threadCount;
+
+	/// The number of worker threads allocated in \p workers.
+	unsigned int maxThreadCount;
+
+	/// The size in bytes of each worker's scratch buffer, needed to start workers later.
+	size_t bufferSize;
+
+	/// Indicates whether the number of active workers is adjusted to the observed throughput.
+	bool adaptive;
+
+	/// The number of workers that may process items at the same time. Equal to \p threadCount unless \p adaptive is set.
+	unsigned int activeLimit;
+
+	/// The number of workers processing an item right now.
+	unsigned int busyWorkers;
+
+	/// The start of the current measurement window of an adaptive pipeline.
+	uint64_t windowStart;
+
+	/// The number of items processed in the current measurement window.
+	unsigned long long windowItems;
+
+	/// The total time spent processing the items of the current measurement window.
+	uint64_t windowBusyNanoseconds;
+
+	/// The throughput of the previous measurement window in items per second.
+	double previousThroughput;
+
+	/// The lowest mean processing time per item of all measurement windows so far.
+	double minimumLatency;
+
+	/// Indicates whether \p activeLimit has been increased at the end of the previous measurement window.
+	bool probing;
+
+	/// The highest value of \p activeLimit so far.
+	unsigned int peakLimit;
+
+	/// The number of times \p activeLimit has been changed.
+	unsigned int adjustments;
+
+	/// The function processing each item on a worker thread.
+	PipelineWork work;
+
+	/// The function handing back each item on the submitting thread.
+	PipelineEmit emit;
+
+	/// The context pointer passed to \p work and \p emit.
+	void* context;
+};
+
+
+
+/// Reads the CPU quota of the cgroup of the process, as limited by e.g. a container runtime.
+/// \return The number of processors the quota corresponds to, rounded up. Zero if there is no quota.
+static unsigned int GetCgroupProcessorCount()
+{
+	long long quota = 0;
+	long long period = 0;
+
+	// cgroup v2 has both values in one file, "max" meaning no quota
+	FILE* file = fopen("/sys/fs/cgroup/cpu.max", "r");
+
+	if (file != NULL)
+	{
+		if (fscanf(file, "%lld %lld", &quota, &period) != 2)
+			quota = 0;
+
+		fclose(file);
+	}
+	else
+	{
+		// cgroup v1 has separate files, -1 meaning no quota
+		file = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+
+		if (file != NULL)
+		{
+			if (fscanf(file, "%lld", &quota) != 1)
+				quota = 0;
+
+			fclose(file);
+		}
+
+		file = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r");
+
+		if (file != NULL)
+		{
+			if (fscanf(file, "%lld", &period) != 1)
+				period = 0;
+
+			fclose(file);
+		}
+	}
+
+	if ((quota <= 0) || (period <= 0))
+		return 0;
+
+	return (unsigned int) ((quota + period - 1) / period);
+}
+
+/// Determines the number of worker threads to use if none was specified.
+/// \return The number of processors the process may run on, limited by its affinity mask and its cgroup CPU quota, but at least one.
+unsigned int GetDefaultThreadCount()
+{
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	cpu_set_t affinity;
+
+	// The process might be pinned to a subset of the processors, e.g. with taskset
+	if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0)
+	{
+		int count = CPU_COUNT(&affinity);
+
+		if ((count > 0) && ((processors <= 0) || (count < processors)))
+			processors = count;
+	}
+
+	unsigned int quota = GetCgroupProcessorCount();
+
+	if ((quota > 0) && ((processors <= 0) || (quota < processors)))
+		processors = quota;
+
+	return (processors > 0)
+		? (unsigned int) processors
+		: 1;
+}
+
+/// Claims and processes items of a parallel loop until none are left.
+/// \param argument A pointer to the struct ParallelLoop to work on.
+/// \return NULL if all claimed items were processed, or a non-NULL value if the scratch buffer could not be allocated.
+static void* RunParallelWorker(void* argument)
+{
+	struct ParallelLoop* loop = argument;
+	void* buffer = NULL;
+
+	if ((loop->bufferSize > 0) && (posix_memalign(&buffer, POOL_BUFFER_ALIGNMENT, loop->bufferSize) != 0))
+	{
+		// Leave the items to the other workers
+		return argument;
+	}
+
+	while (true)
+	{
+		size_t index = atomic_fetch_add_explicit(&loop->nextIndex, 1, memory_order_relaxed);
+
+		if (index >= loop->itemCount)
+			break;
+
+		loop->work(index, buffer, loop->context);
+	}
+
+	free(buffer);
+
+	// The thread's counters are lost once it exits
+	MergeThreadStats();
+
+	return NULL;
+}
+
+/// Executes the provided function once for each index in [0, \p itemCount), distributing the items across worker threads.
+/// Items are claimed one at a time, so that a few expensive items do not stall the other workers.
+/// \param itemCount The number of items to process.
+/// \param threadCount The maximum number of threads to use, including the calling thread.
+/// \param bufferSize The size in bytes of the scratch buffer allocated for each worker. May be zero.
+/// \param work The function to execute for each item. It must be safe to call concurrently for different items.
+/// \param context The context pointer passed to \p work.
+/// \return true if all items were processed. false if none of the workers could allocate its scratch buffer.
+bool ParallelFor(size_t itemCount, unsigned int threadCount, size_t bufferSize, ParallelWork work, void* context)
+{
+	assert(work != NULL);
+
+
+	struct ParallelLoop loop =
+	{
+		.itemCount = itemCount,
+		.bufferSize = bufferSize,
+		.work = work,
+		.context = context,
+	};
+
+	atomic_init(&loop.nextIndex, 0);
+
+	if (threadCount < 1)
+		threadCount = 1;
+
+	// Never start more threads than there are items
+	if (threadCount > itemCount)
+		threadCount = (itemCount > 0) ? (unsigned int) itemCount : 1;
+
+	pthread_t* threads = calloc(threadCount, sizeof(pthread_t));
+	unsigned int startedCount = 0;
+
+	if (threads != NULL)
+	{
+		// The calling thread is the first worker; Start the others
+		for (unsigned int i = 1; i < threadCount; i++)
+		{
+			if (pthread_create(&threads[startedCount], NULL, RunParallelWorker, &loop) != 0)
+				break;
+
+			startedCount++;
+		}
+	}
+
+	RunParallelWorker(&loop);
+
+	for (unsigned int i = 0; i < startedCount; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+
+	// Every item has been claimed unless all workers failed to allocate their buffers
+	return atomic_load(&loop.nextIndex) >= itemCount;
+}
+
+
+/// Processes the items of an ordered pipeline until it is shut down.
+/// \param argument A pointer to the struct PipelineWorker to run.
+/// \return Always NULL.
+static void* RunPipelineWorker(void* argument)
+{
+	struct PipelineWorker* worker = argument;
+	struct OrderedPipeline* pipeline = worker->pipeline;
+
+	pthread_mutex_lock(&pipeline->lock);
+
+	while (true)
+	{
+		// Wait for an unclaimed item and, in an adaptive pipeline, for the permission to process it
+		while (((pipeline->next == pipeline->tail) || (pipeline->busyWorkers >= pipeline->activeLimit)) && !pipeline->shuttingDown)
+			pthread_cond_wait(&pipeline->itemSubmitted, &pipeline->lock);
+
+		if (pipeline->next == pipeline->tail)
+			break;
+
+		size_t slot = pipeline->next++ % pipeline->capacity;
+		void* item = pipeline->items[slot];
+
+		// Once cancelled, the items are only handed back so that they can be released
+		if (!pipeline->cancelled)
+		{
+			uint64_t startTime = pipeline->adaptive ? GetMonotonicNanoseconds() : 0;
+
+			pipeline->busyWorkers++;
+
+			// Process the item without holding the lock, so that the other workers can continue
+			pthread_mutex_unlock(&pipeline->lock);
+			pipeline->work(item, worker->buffer, pipeline->context);
+			pthread_mutex_lock(&pipeline->lock);
+
+			pipeline->busyWorkers--;
+
+			if (pipeline->adaptive)
+			{
+				pipeline->windowItems++;
+				pipeline->windowBusyNanoseconds += GetMonotonicNanoseconds() - startTime;
+
+				// Another worker might be waiting for the permission to process an item
+				pthread_cond_signal(&pipeline->itemSubmitted);
+			}
+		}
+
+		pipeline->processed[slot] = true;
+		pthread_cond_broadcast(&pipeline->itemProcessed);
+	}
+
+	pthread_mutex_unlock(&pipeline->lock);
+
+	// The thread's counters are lost once it exits
+	MergeThreadStats();
+
+	return NULL;
+}
+
+/// Starts another worker thread of an ordered pipeline.
+/// \param pipeline The pipeline to start the worker for. Must have room for another worker.
+/// \return true if the worker has been started. Otherwise, false.
+static bool StartPipelineWorker(struct OrderedPipeline* pipeline)
+{
+	assert(pipeline->threadCount < pipeline->maxThreadCount);
+
+
+	struct PipelineWorker* worker = &pipeline->workers[pipeline->threadCount];
+
+	worker->pipeline = pipeline;
+
+	if ((pipeline->bufferSize > 0) && (posix_memalign(&worker->buffer, POOL_BUFFER_ALIGNMENT, pipeline->bufferSize) != 0))
+	{
+		worker->buffer = NULL;
+
+		return false;
+	}
+
+	if (pthread_create(&worker->thread, NULL, RunPipelineWorker, worker) != 0)
+	{
+		free(worker->buffer);
+		worker->buffer = NULL;
+
+		return false;
+	}
+
+	pipeline->threadCount++;
+
+	return true;
+}
+
+/// Creates an ordered pipeline that starts with some worker threads and may start more later.
+/// \param threadCount The number of worker threads to start right away.
+/// \param maxThreadCount The maximum number of worker threads. If larger than \p threadCount, the pipeline is adaptive.
+/// \param bufferSize The size in bytes of the scratch buffer allocated for each worker. May be zero.
+/// \param work The function processing each item.
+/// \param emit The function handing back each processed item.
+/// \param context The context pointer passed to \p work and \p emit.
+/// \return The created pipeline, or NULL if not even a single worker could be started.
+static struct OrderedPipeline* CreatePipelineWithLimit(unsigned int threadCount, unsigned int maxThreadCount, size_t bufferSize, PipelineWork work, PipelineEmit emit, void* context)
+{
+	assert(work != NULL);
+	assert(emit != NULL);
+
+
+	if (threadCount < 1)
+		threadCount = 1;
+
+	if (maxThreadCount < threadCount)
+		maxThreadCount = threadCount;
+
+	struct OrderedPipeline* pipeline = calloc(1, sizeof(struct OrderedPipeline));
+
+	if (pipeline == NULL)
+		return NULL;
+
+	// The window of items in flight is sized for the maximum number of workers
+	pipeline->capacity = (size_t) maxThreadCount * PIPELINE_ITEMS_PER_WORKER;
+	pipeline->items = calloc(pipeline->capacity, sizeof(void*));
+	pipeline->processed = calloc(pipeline->capacity, sizeof(bool));
+	pipeline->workers = calloc(maxThreadCount, sizeof(struct PipelineWorker));
+	pipeline->maxThreadCount = maxThreadCount;
+	pipeline->bufferSize = bufferSize;
+	pipeline->adaptive = (maxThreadCount > threadCount);
+	pipeline->work = work;
+	pipeline->emit = emit;
+	pipeline->context = context;
+
+	if ((pipeline->items == NULL) || (pipeline->processed == NULL) || (pipeline->workers == NULL))
+	{
+		free(pipeline->items);
+		free(pipeline->processed);
+		free(pipeline->workers);
+		free(pipeline);
+
+		return NULL;
+	}
+
+	pthread_mutex_init(&pipeline->lock, NULL);
+	pthread_cond_init(&pipeline->itemSubmitted, NULL);
+	pthread_cond_init(&pipeline->itemProcessed, NULL);
+
+	pipeline->windowStart = GetMonotonicNanoseconds();
+
+	// The workers only start claiming items once the limit has been set
+	pthread_mutex_lock(&pipeline->lock);
+
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		if (!StartPipelineWorker(pipeline))
+			break;
+	}
+
+	pipeline->activeLimit = pipeline->threadCount;
+	pipeline->peakLimit = pipeline->threadCount;
+
+	pthread_mutex_unlock(&pipeline->lock);
+
+	if (pipeline->threadCount == 0)
+	{
+		FreePipeline(pipeline);
+
+		return NULL;
+	}
+
+	return pipeline;
+}
+
+/// Creates an ordered pipeline and starts its worker threads.
+/// Items are processed concurrently, but emitted on the submitting thread in exactly the order in which they were submitted.
+/// \param threadCount The number of worker threads to start.
+/// \param bufferSize The size in bytes of the scratch buffer allocated for each worker. May be zero.
+/// \param work The function processing each item. It must be safe to call concurrently for different items.
+/// \param emit The function handing back each processed item.
+/// \param context The context pointer passed to \p work and \p emit.
+/// \return The created pipeline, which needs to be released with FreePipeline(), or NULL if not even a single worker could be started.
+struct OrderedPipeline* CreatePipeline(unsigned int threadCount, size_t bufferSize, PipelineWork work, PipelineEmit emit, void* context)
+{
+	return CreatePipelineWithLimit(threadCount, threadCount, bufferSize, work, emit, context);
+}
+
+/// Creates an ordered pipeline that adjusts the number of its worker threads to the observed throughput, see CreatePipeline().
+/// \param maxThreadCount The maximum number of worker threads to start.
+/// \param bufferSize The size in bytes of the scratch buffer allocated for each worker. May be zero.
+/// \param work The function processing each item. It must be safe to call concurrently for different items.
+/// \param emit The function handing back each processed item.
+/// \param context The context pointer passed to \p work and \p emit.
+/// \return The created pipeline, which needs to be released with FreePipeline(), or NULL if not even a single worker could be started.
+struct OrderedPipeline* CreateAdaptivePipeline(unsigned int maxThreadCount, size_t bufferSize, PipelineWork work, PipelineEmit emit, void* context)
+{
+	if (maxThreadCount < 1)
+		maxThreadCount = 1;
+
+	unsigned int threadCount = (maxThreadCount < PIPELINE_ADAPTIVE_INITIAL_THREADS) ? maxThreadCount : PIPELINE_ADAPTIVE_INITIAL_THREADS;
+
+	return CreatePipelineWithLimit(threadCount, maxThreadCount, bufferSize, work, emit, context);
+}
+
+/// Adjusts the number of active workers of an adaptive pipeline to the throughput of the last measurement window. Must be called with the lock held.
+/// \param pipeline The pipeline to adjust.
+static void AdjustActiveLimit(struct OrderedPipeline* pipeline)
+{
+	uint64_t now = GetMonotonicNanoseconds();
+	uint64_t elapsed = now - pipeline->windowStart;
+
+	// Wait for enough items to tell the throughput of the current limit from noise
+	if ((elapsed < PIPELINE_ADJUST_INTERVAL_NANOSECONDS) || (pipeline->windowItems < pipeline->activeLimit))
+		return;
+
+	double throughput = pipeline->windowItems * 1e9 / elapsed;
+	double latency = (double) pipeline->windowBusyNanoseconds / pipeline->windowItems;
+	unsigned int limit = pipeline->activeLimit;
+
+	if ((pipeline->minimumLatency == 0.0) || (latency < pipeline->minimumLatency))
+		pipeline->minimumLatency = latency;
+
+	bool gained = (throughput >= pipeline->previousThroughput * PIPELINE_THROUGHPUT_GAIN);
+
+	if ((latency > pipeline->minimumLatency * PIPELINE_CONGESTION_FACTOR) && !gained)
+	{
+		// More workers only make each item slower; Back off multiplicatively
+		limit = (limit > 1) ? limit / 2 : 1;
+	}
+	else if (pipeline->probing && !gained && (limit > 1))
+	{
+		// The last worker added has not helped, e.g. because all processors are busy; Take it back
+		limit--;
+	}
+	else if ((pipeline->tail != pipeline->next) && (limit < pipeline->maxThreadCount))
+	{
+		// Items are waiting for a worker; Probe additively whether another one helps
+		limit++;
+	}
+
+	if ((limit > pipeline->threadCount) && !StartPipelineWorker(pipeline))
+		limit = pipeline->threadCount;
+
+	pipeline->probing = (limit > pipeline->activeLimit);
+
+	if (limit != pipeline->activeLimit)
+	{
+		pipeline->activeLimit = limit;
+		pipeline->adjustments++;
+
+		if (limit > pipeline->peakLimit)
+			pipeline->peakLimit = limit;
+
+		pthread_cond_broadcast(&pipeline->itemSubmitted);
+	}
+
+	pipeline->previousThroughput = throughput;
+	pipeline->windowStart = now;
+	pipeline->windowItems = 0;
+	pipeline->windowBusyNanoseconds = 0;
+}
+
+/// Emits all processed items at the head of the pipeline. Must be called with the lock held.
+/// \param pipeline The pipeline whose items to emit.
+static void EmitProcessedItems(struct OrderedPipeline* pipeline)
+{
+	while ((pipeline->head != pipeline->next) && pipeline->processed[pipeline->head % pipeline->capacity])
+	{
+		size_t slot = pipeline->head % pipeline->capacity;
+		void* item = pipeline->items[slot];
+
+		pipeline->processed[slot] = false;
+
+		// The slot stays reserved until the item was emitted, so the workers cannot touch it
+		pthread_mutex_unlock(&pipeline->lock);
+		pipeline->emit(item, pipeline->context);
+		pthread_mutex_lock(&pipeline->lock);
+
+		pipeline->head++;
+	}
+}
+
+/// Submits an item to the pipeline, emitting all items that have been processed in the meantime.
+/// Blocks while the pipeline is full until the oldest item has been processed.
+/// \param pipeline The pipeline to submit the item to.
+/// \param item The item to process.
+void SubmitToPipeline(struct OrderedPipeline* pipeline, void* item)
+{
+	assert(pipeline != NULL);
+
+
+	pthread_mutex_lock(&pipeline->lock);
+
+	while (true)
+	{
+		EmitProcessedItems(pipeline);
+
+		if (pipeline->tail - pipeline->head < pipeline->capacity)
+			break;
+
+		pthread_cond_wait(&pipeline->itemProcessed, &pipeline->lock);
+	}
+
+	pipeline->items[pipeline->tail % pipeline->capacity] = item;
+	pipeline->tail++;
+
+	if (pipeline->adaptive)
+		AdjustActiveLimit(pipeline);
+
+	pthread_cond_signal(&pipeline->itemSubmitted);
+	pthread_mutex_unlock(&pipeline->lock);
+}
+
+/// Waits until all submitted items have been processed and emits them.
+/// \param pipeline The pipeline to drain.
+void DrainPipeline(struct OrderedPipeline* pipeline)
+{
+	assert(pipeline != NULL);
+
+
+	pthread_mutex_lock(&pipeline->lock);
+
+	while (true)
+	{
+		EmitProcessedItems(pipeline);
+
+		if (pipeline->head == pipeline->tail)
+			break;
+
+		pthread_cond_wait(&pipeline->itemProcessed, &pipeline->lock);
+	}
+
+	pthread_mutex_unlock(&pipeline->lock);
+}
+
+/// Stops processing the items of the pipeline. Items that have not been claimed by a worker yet are emitted without being processed.
+/// May be called from any thread.
+/// \param pipeline The pipeline to cancel.
+void CancelPipeline(struct OrderedPipeline* pipeline)
+{
+	assert(pipeline != NULL);
+
+
+	pthread_mutex_lock(&pipeline->lock);
+	pipeline->cancelled = true;
+	pthread_mutex_unlock(&pipeline->lock);
+}
+
+/// Drains the pipeline, stops its worker threads and frees it.
+/// \param pipeline The pipeline to free. May be NULL.
+void FreePipeline(struct OrderedPipeline* pipeline)
+{
+	if (pipeline == NULL)
+		return;
+
+	if (pipeline->threadCount > 0)
+		DrainPipeline(pipeline);
+
+	pthread_mutex_lock(&pipeline->lock);
+	pipeline->shuttingDown = true;
+	pthread_cond_broadcast(&pipeline->itemSubmitted);
+	pthread_mutex_unlock(&pipeline->lock);
+
+	for (unsigned int i = 0; i < pipeline->threadCount; i++)
+	{
+		pthread_join(pipeline->workers[i].thread, NULL);
+		free(pipeline->workers[i].buffer);
+	}
+
+	if (pipeline->threadCount > 0)
+		RecordConcurrency(pipeline->adaptive, pipeline->activeLimit, pipeline->peakLimit, pipeline->maxThreadCount, pipeline->adjustments);
+
+	pthread_cond_destroy(&pipeline->itemProcessed);
+	pthread_cond_destroy(&pipeline->itemSubmitted);
+	pthread_mutex_destroy(&pipeline->lock);
+
+	free(pipeline->items);
+	free(pipeline->processed);
+	free(pipeline->workers);
+	free(pipeline);
+}
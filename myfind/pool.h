@@ -0,0 +1,43 @@
+/// \file pool.h
+/// Helpers for distributing independent work items across a set of worker threads.
+
+
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+
+/// The function executed for every item of a parallel loop.
+/// \param index The index of the item to process.
+/// \param buffer The scratch buffer owned by the calling worker. It is reused for all items processed by the same worker.
+/// \param context The context pointer that was passed to ParallelFor().
+typedef void (*ParallelWork)(size_t index, void* buffer, void* context);
+
+/// The function executed by a worker thread for every item submitted to an ordered pipeline.
+/// \param item The item to process.
+/// \param buffer The scratch buffer owned by the calling worker. It is reused for all items processed by the same worker.
+/// \param context The context pointer that was passed to CreatePipeline().
+typedef void (*PipelineWork)(void* item, void* buffer, void* context);
+
+/// The function executed on the submitting thread for every processed item, in the order in which the items were submitted.
+/// \param item The processed item.
+/// \param context The context pointer that was passed to CreatePipeline().
+typedef void (*PipelineEmit)(void* item, void* context);
+
+struct OrderedPipeline;
+
+unsigned int GetDefaultThreadCount();
+bool ParallelFor(size_t itemCount, unsigned int threadCount, size_t bufferSize, ParallelWork work, void* context);
+
+struct OrderedPipeline* CreatePipeline(unsigned int threadCount, size_t bufferSize, PipelineWork work, PipelineEmit emit, void* context);
+struct OrderedPipeline* CreateAdaptivePipeline(unsigned int maxThreadCount, size_t bufferSize, PipelineWork work, PipelineEmit emit, void* context);
+void SubmitToPipeline(struct OrderedPipeline* pipeline, void* item);
+void DrainPipeline(struct OrderedPipeline* pipeline);
+void CancelPipeline(struct OrderedPipeline* pipeline);
+void FreePipeline(struct OrderedPipeline* pipeline);
+
+#endif
@@ -0,0 +1,240 @@
+/// \file progress.c
+/// Periodic progress reports of a running search, enabled with "--progress".
+///
+/// The reports are printed by a separate thread, so that the search itself only
+/// pays for relaxed atomic increments and, once per directory, for publishing
+/// the path of the directory it has entered.
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "progress.h"
+
+
+
+/// The state shared between the search and the reporting thread.
+struct ProgressReporter
+{
+	/// The counters incremented by the search.
+	struct ProgressCounters counters;
+
+	/// The stream to print the reports to.
+	FILE* stream;
+
+	/// Indicates whether \p stream is a terminal, in which case each report overwrites the previous one.
+	bool isTerminal;
+
+	/// Protects \p path.
+	pthread_mutex_t pathLock;
+
+	/// The directory the search has entered last. Long paths are shortened at the front.
+	char path[PROGRESS_PATH_SIZE];
+
+	/// Protects \p stopping and is used with \p stopRequested.
+	pthread_mutex_t lock;
+
+	/// Signalled when the reporting thread should exit.
+	pthread_cond_t stopRequested;
+
+	/// Indicates whether the reporting thread should exit.
+	bool stopping;
+
+	/// The reporting thread.
+	pthread_t thread;
+
+	/// The number of entries at the time of the previous report.
+	unsigned long long previousEntries;
+
+	/// The time of the previous report.
+	struct timespec previousTime;
+};
+
+
+
+/// Prints a single report with the current counters and the rate since the previous report.
+/// \param reporter The reporter whose counters to print.
+static void PrintProgress(struct ProgressReporter* reporter)
+{
+	struct timespec now;
+	char path[PROGRESS_PATH_SIZE];
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	unsigned long long directories = atomic_load_explicit(&reporter->counters.directories, memory_order_relaxed);
+	unsigned long long entries = atomic_load_explicit(&reporter->counters.entries, memory_order_relaxed);
+	unsigned long long matches = atomic_load_explicit(&reporter->counters.matches, memory_order_relaxed);
+
+	pthread_mutex_lock(&reporter->pathLock);
+	memcpy(path, reporter->path, sizeof(path));
+	pthread_mutex_unlock(&reporter->pathLock);
+
+	double seconds = (now.tv_sec - reporter->previousTime.tv_sec) + (now.tv_nsec - reporter->previousTime.tv_nsec) / 1e9;
+	double rate = (seconds > 0) ? (entries - reporter->previousEntries) / seconds : 0.0;
+
+	reporter->previousEntries = entries;
+	reporter->previousTime = now;
+
+	// On a terminal, overwrite the previous report and clear what is left of it
+	fprintf(reporter->stream, "%smyfind: %llu directories, %llu entries, %.0f entries/sec, %llu matches, %s%s",
+		reporter->isTerminal ? "\r" : "", directories, entries, rate, matches, path, reporter->isTerminal ? "\033[K" : "\n");
+	fflush(reporter->stream);
+}
+
+/// Prints a report at a fixed interval until the reporter is stopped.
+/// \param argument A pointer to the struct ProgressReporter to print.
+/// \return Always NULL.
+static void* RunProgressReporter(void* argument)
+{
+	struct ProgressReporter* reporter = argument;
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	pthread_mutex_lock(&reporter->lock);
+
+	while (!reporter->stopping)
+	{
+		// Use absolute deadlines, so that the time spent printing does not add up
+		deadline.tv_sec += PROGRESS_INTERVAL_MILLISECONDS / 1000;
+		deadline.tv_nsec += (PROGRESS_INTERVAL_MILLISECONDS % 1000) * 1000000L;
+
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		while (!reporter->stopping && (pthread_cond_timedwait(&reporter->stopRequested, &reporter->lock, &deadline) == 0))
+			;
+
+		if (reporter->stopping)
+			break;
+
+		pthread_mutex_unlock(&reporter->lock);
+		PrintProgress(reporter);
+		pthread_mutex_lock(&reporter->lock);
+	}
+
+	pthread_mutex_unlock(&reporter->lock);
+
+	return NULL;
+}
+
+/// Starts a thread that periodically prints the progress of the search.
+/// \param stream The stream to print the reports to.
+/// \return The new reporter, which needs to be stopped with StopProgressReporter(). NULL if the reporter could not be started.
+struct ProgressReporter* StartProgressReporter(FILE* stream)
+{
+	assert(stream != NULL);
+
+
+	struct ProgressReporter* reporter = calloc(1, sizeof(struct ProgressReporter));
+
+	if (reporter == NULL)
+		return NULL;
+
+	reporter->stream = stream;
+	reporter->isTerminal = isatty(fileno(stream));
+
+	atomic_init(&reporter->counters.directories, 0);
+	atomic_init(&reporter->counters.entries, 0);
+	atomic_init(&reporter->counters.matches, 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &reporter->previousTime);
+
+	pthread_condattr_t attributes;
+
+	// The deadlines are measured on the monotonic clock, so that changes of the system time do not matter
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(&reporter->stopRequested, &attributes);
+	pthread_condattr_destroy(&attributes);
+
+	pthread_mutex_init(&reporter->pathLock, NULL);
+	pthread_mutex_init(&reporter->lock, NULL);
+
+	if (pthread_create(&reporter->thread, NULL, RunProgressReporter, reporter) != 0)
+	{
+		pthread_cond_destroy(&reporter->stopRequested);
+		pthread_mutex_destroy(&reporter->pathLock);
+		pthread_mutex_destroy(&reporter->lock);
+		free(reporter);
+
+		return NULL;
+	}
+
+	return reporter;
+}
+
+/// Stops the reporting thread, prints a final report and frees the reporter.
+/// \param reporter The reporter to stop. May be NULL.
+void StopProgressReporter(struct ProgressReporter* reporter)
+{
+	if (reporter == NULL)
+		return;
+
+	pthread_mutex_lock(&reporter->lock);
+	reporter->stopping = true;
+	pthread_cond_signal(&reporter->stopRequested);
+	pthread_mutex_unlock(&reporter->lock);
+
+	pthread_join(reporter->thread, NULL);
+
+	// The final report shows the totals; On a terminal, it also ends the line that was overwritten so far
+	PrintProgress(reporter);
+
+	if (reporter->isTerminal)
+		fprintf(reporter->stream, "\n");
+
+	pthread_cond_destroy(&reporter->stopRequested);
+	pthread_mutex_destroy(&reporter->pathLock);
+	pthread_mutex_destroy(&reporter->lock);
+	free(reporter);
+}
+
+/// Gets the counters that the search increments with CountProgress().
+/// \param reporter The reporter printing the counters.
+/// \return The counters of the reporter.
+struct ProgressCounters* GetProgressCounters(struct ProgressReporter* reporter)
+{
+	assert(reporter != NULL);
+
+
+	return &reporter->counters;
+}
+
+/// Publishes the path of the directory the search has entered, to be shown in the next report.
+/// \param reporter The reporter to publish the path to.
+/// \param path The path of the directory.
+void SetProgressPath(struct ProgressReporter* reporter, const char* path)
+{
+	assert(reporter != NULL);
+	assert(path != NULL);
+
+
+	size_t length = strlen(path);
+
+	pthread_mutex_lock(&reporter->pathLock);
+
+	if (length < PROGRESS_PATH_SIZE)
+	{
+		memcpy(reporter->path, path, length + 1);
+	}
+	else
+	{
+		// The end of the path is the most informative part
+		size_t tailLength = PROGRESS_PATH_SIZE - 4;
+
+		memcpy(reporter->path, "...", 3);
+		memcpy(reporter->path + 3, path + length - tailLength, tailLength + 1);
+	}
+
+	pthread_mutex_unlock(&reporter->pathLock);
+}
@@ -0,0 +1,47 @@
+/// \file progress.h
+/// Periodic progress reports of a running search, enabled with "--progress".
+
+
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+
+
+/// The number of milliseconds between two progress reports.
+#define PROGRESS_INTERVAL_MILLISECONDS 1000
+
+/// The maximum number of bytes of the current path shown in a progress report, including the terminator.
+#define PROGRESS_PATH_SIZE 256
+
+/// The counters read by the reporting thread. The search only increments them with relaxed atomic operations.
+struct ProgressCounters
+{
+	/// The number of directories opened so far.
+	atomic_ullong directories;
+
+	/// The number of directory entries read so far.
+	atomic_ullong entries;
+
+	/// The number of files that matched all search criteria so far.
+	atomic_ullong matches;
+};
+
+struct ProgressReporter;
+
+struct ProgressReporter* StartProgressReporter(FILE* stream);
+void StopProgressReporter(struct ProgressReporter* reporter);
+struct ProgressCounters* GetProgressCounters(struct ProgressReporter* reporter);
+void SetProgressPath(struct ProgressReporter* reporter, const char* path);
+
+/// Increments a progress counter. Cheap enough to be called for every directory entry.
+/// \param counter The counter to increment.
+static inline void CountProgress(atomic_ullong* counter)
+{
+	atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
+
+#endif
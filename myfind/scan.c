@@ -0,0 +1,81 @@
+/// \file scan.c
+/// Fast substring search used to inspect file contents.
+///
+/// On processors with SSE2, FindLiteral() compares the first and the last byte
+/// of the needle against 16 candidate positions at once and only verifies the
+/// positions where both bytes match. This rejects almost all positions in
+/// typical text without looking at them individually.
+
+
+
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <assert.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "scan.h"
+
+
+
+/// Finds the first occurrence of a literal byte sequence in a block of memory.
+/// \param haystack The memory to search.
+/// \param haystackLength The number of bytes in \p haystack.
+/// \param needle The byte sequence to search for.
+/// \param needleLength The number of bytes in \p needle.
+/// \return A pointer to the first occurrence of \p needle within \p haystack, or NULL if there is none. An empty needle matches at the beginning.
+const char* FindLiteral(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength)
+{
+	assert((haystack != NULL) || (haystackLength == 0));
+	assert((needle != NULL) || (needleLength == 0));
+
+
+	if (needleLength == 0)
+		return haystack;
+
+	if (needleLength > haystackLength)
+		return NULL;
+
+	// A single byte is best left to the C library's vectorized memchr()
+	if (needleLength == 1)
+		return memchr(haystack, needle[0], haystackLength);
+
+	size_t lastStart = haystackLength - needleLength;
+	size_t i = 0;
+
+#ifdef __SSE2__
+	const __m128i first = _mm_set1_epi8(needle[0]);
+	const __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+
+	// Test 16 start positions per iteration, as long as all of them lie within the haystack
+	for (; i + 16 <= lastStart + 1; i += 16)
+	{
+		__m128i blockFirst = _mm_loadu_si128((const __m128i*) (haystack + i));
+		__m128i blockLast = _mm_loadu_si128((const __m128i*) (haystack + i + needleLength - 1));
+
+		unsigned int mask = _mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(blockFirst, first),
+			_mm_cmpeq_epi8(blockLast, last)));
+
+		// Verify the candidate positions from left to right
+		while (mask != 0)
+		{
+			size_t position = i + __builtin_ctz(mask);
+
+			if (memcmp(haystack + position + 1, needle + 1, needleLength - 2) == 0)
+				return haystack + position;
+
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	// Search the remaining positions with the C library
+	if (i > lastStart)
+		return NULL;
+
+	return memmem(haystack + i, haystackLength - i, needle, needleLength);
+}
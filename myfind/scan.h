@@ -0,0 +1,15 @@
+/// \file scan.h
+/// Fast substring search used to inspect file contents.
+
+
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+
+
+const char* FindLiteral(const char* haystack, size_t haystackLength, const char* needle, size_t needleLength);
+
+#endif
@@ -0,0 +1,192 @@
+/// \file stats.c
+/// Counters describing the work done during a search, reported with "-D stats".
+
+
+
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "stats.h"
+
+
+
+/// The counters of the calling thread that have not been merged into the totals yet.
+_Thread_local struct RunStats ThreadStats;
+
+/// The sum of the counters of all threads that have called MergeThreadStats().
+static struct RunStats TotalStats;
+
+/// Protects \p TotalStats.
+static pthread_mutex_t TotalStatsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/// The point in time at which the search was started.
+static struct timespec StartTime;
+
+/// The concurrency of the content reading threads as recorded by RecordConcurrency(). All zero if no threads were used.
+static struct
+{
+	/// Indicates whether the number of threads has been adjusted to the observed throughput.
+	bool adaptive;
+
+	/// The number of threads processing items at the end.
+	unsigned int finalThreads;
+
+	/// The highest number of threads processing items at the same time.
+	unsigned int peakThreads;
+
+	/// The maximum number of threads allowed.
+	unsigned int maxThreads;
+
+	/// The number of times the number of threads has been adjusted.
+	unsigned int adjustments;
+} Concurrency;
+
+/// The work done on the chunks of large directories as recorded by RecordChunkWork(). All zero if no directory was split.
+static struct
+{
+	/// The number of directories that have been split into chunks.
+	unsigned long long directories;
+
+	/// The number of threads in \p chunks and \p entries. The walk comes first.
+	unsigned int threadCount;
+
+	/// The number of chunks tested per thread.
+	unsigned long long chunks[STATS_MAX_CHUNK_THREADS];
+
+	/// The number of entries tested per thread.
+	unsigned long long entries[STATS_MAX_CHUNK_THREADS];
+} ChunkWork;
+
+
+
+/// Records the current time as the start of the search, against which the elapsed wall time is measured.
+void StartStatsClock()
+{
+	clock_gettime(CLOCK_MONOTONIC, &StartTime);
+}
+
+/// Adds the counters of the calling thread to the totals and resets them. Must be called by every thread before it exits.
+void MergeThreadStats()
+{
+	pthread_mutex_lock(&TotalStatsLock);
+
+	TotalStats.directoriesOpened += ThreadStats.directoriesOpened;
+	TotalStats.entriesRead += ThreadStats.entriesRead;
+	TotalStats.statCalls += ThreadStats.statCalls;
+	TotalStats.statsSkipped += ThreadStats.statsSkipped;
+	TotalStats.entriesExcluded += ThreadStats.entriesExcluded;
+	TotalStats.callsTimedOut += ThreadStats.callsTimedOut;
+	TotalStats.pathBytes += ThreadStats.pathBytes;
+	TotalStats.allocations += ThreadStats.allocations;
+	TotalStats.matches += ThreadStats.matches;
+	TotalStats.filesRead += ThreadStats.filesRead;
+	TotalStats.bytesRead += ThreadStats.bytesRead;
+
+	pthread_mutex_unlock(&TotalStatsLock);
+
+	memset(&ThreadStats, 0, sizeof(ThreadStats));
+}
+
+/// Gets the sum of the counters of all threads, including the calling one.
+/// \param totals The struct in which to store the sums.
+void GetTotalStats(struct RunStats* totals)
+{
+	MergeThreadStats();
+
+	pthread_mutex_lock(&TotalStatsLock);
+	*totals = TotalStats;
+	pthread_mutex_unlock(&TotalStatsLock);
+}
+
+/// Records the number of threads used to read file contents, to be printed with the other statistics.
+/// \param adaptive Indicates whether the number of threads has been adjusted to the observed throughput.
+/// \param finalThreads The number of threads processing items at the end.
+/// \param peakThreads The highest number of threads processing items at the same time.
+/// \param maxThreads The maximum number of threads allowed.
+/// \param adjustments The number of times the number of threads has been adjusted.
+void RecordConcurrency(bool adaptive, unsigned int finalThreads, unsigned int peakThreads, unsigned int maxThreads, unsigned int adjustments)
+{
+	Concurrency.adaptive = adaptive;
+	Concurrency.finalThreads = finalThreads;
+	Concurrency.peakThreads = peakThreads;
+	Concurrency.maxThreads = maxThreads;
+	Concurrency.adjustments = adjustments;
+}
+
+/// Records the work done on the chunks of large directories by each thread, to be printed with the other statistics.
+/// \param directories The number of directories that have been split into chunks.
+/// \param threadCount The number of threads in \p chunks and \p entries, the walk first. At most STATS_MAX_CHUNK_THREADS are recorded.
+/// \param chunks The number of chunks tested per thread.
+/// \param entries The number of entries tested per thread.
+void RecordChunkWork(unsigned long long directories, unsigned int threadCount, const unsigned long long* chunks, const unsigned long long* entries)
+{
+	if (threadCount > STATS_MAX_CHUNK_THREADS)
+		threadCount = STATS_MAX_CHUNK_THREADS;
+
+	ChunkWork.directories = directories;
+	ChunkWork.threadCount = threadCount;
+	memcpy(ChunkWork.chunks, chunks, threadCount * sizeof(chunks[0]));
+	memcpy(ChunkWork.entries, entries, threadCount * sizeof(entries[0]));
+}
+
+/// Prints the sum of the counters of all threads together with the elapsed time.
+/// \param stream The stream to print to.
+void PrintStats(FILE* stream)
+{
+	struct RunStats totals;
+	struct timespec now;
+	struct rusage usage;
+
+	GetTotalStats(&totals);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	getrusage(RUSAGE_SELF, &usage);
+
+	double wallSeconds = (now.tv_sec - StartTime.tv_sec) + (now.tv_nsec - StartTime.tv_nsec) / 1e9;
+	double userSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+	double systemSeconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+	fprintf(stream, "myfind statistics:\n");
+	fprintf(stream, "  directories opened     %llu\n", totals.directoriesOpened);
+	fprintf(stream, "  entries read           %llu\n", totals.entriesRead);
+	fprintf(stream, "  stat calls             %llu\n", totals.statCalls);
+	fprintf(stream, "  stat calls skipped     %llu\n", totals.statsSkipped);
+	fprintf(stream, "  entries excluded       %llu\n", totals.entriesExcluded);
+	fprintf(stream, "  calls timed out        %llu\n", totals.callsTimedOut);
+	fprintf(stream, "  path bytes built       %llu\n", totals.pathBytes);
+	fprintf(stream, "  allocations            %llu\n", totals.allocations);
+	fprintf(stream, "  matches                %llu\n", totals.matches);
+	fprintf(stream, "  files read             %llu\n", totals.filesRead);
+	fprintf(stream, "  bytes read             %llu\n", totals.bytesRead);
+
+	// Only reported if the content was read at all
+	if (Concurrency.adaptive)
+		fprintf(stream, "  content threads        %u (adaptive: peak %u of %u, %u adjustments)\n", Concurrency.finalThreads, Concurrency.peakThreads, Concurrency.maxThreads, Concurrency.adjustments);
+	else if (Concurrency.maxThreads > 0)
+		fprintf(stream, "  content threads        %u\n", Concurrency.finalThreads);
+
+	// The share of each thread shows whether the chunks of large directories were balanced
+	if (ChunkWork.threadCount > 0)
+	{
+		fprintf(stream, "  chunked directories    %llu\n", ChunkWork.directories);
+		fprintf(stream, "  stat threads           %u besides the walk\n", ChunkWork.threadCount - 1);
+
+		for (unsigned int i = 0; i < ChunkWork.threadCount; i++)
+		{
+			char name[32];
+
+			if (i == 0)
+				snprintf(name, sizeof(name), "walk");
+			else
+				snprintf(name, sizeof(name), "thread %u", i);
+
+			fprintf(stream, "    %-20s %llu chunks, %llu entries\n", name, ChunkWork.chunks[i], ChunkWork.entries[i]);
+		}
+	}
+
+	fprintf(stream, "  wall time              %.3f s\n", wallSeconds);
+	fprintf(stream, "  cpu time               %.3f s user, %.3f s system\n", userSeconds, systemSeconds);
+	fprintf(stream, "  entries/sec            %.0f\n", (wallSeconds > 0) ? totals.entriesRead / wallSeconds : 0.0);
+}
@@ -0,0 +1,63 @@
+/// \file stats.h
+/// Counters describing the work done during a search, reported with "-D stats".
+
+
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+
+
+/// The maximum number of threads whose work on the chunks of large directories is recorded, including the walk.
+#define STATS_MAX_CHUNK_THREADS 256
+
+/// Counters describing the work done by a single thread. Each thread increments its own instance in \p ThreadStats without any synchronization.
+struct RunStats
+{
+	/// The number of directories that were opened successfully.
+	unsigned long long directoriesOpened;
+
+	/// The number of entries returned while reading directories.
+	unsigned long long entriesRead;
+
+	/// The number of lstat() calls.
+	unsigned long long statCalls;
+
+	/// The number of entries whose information could be determined without calling lstat().
+	unsigned long long statsSkipped;
+
+	/// The number of entries skipped because of an exclusion list, together with everything below them.
+	unsigned long long entriesExcluded;
+
+	/// The number of file system calls that have been given up on because they did not return in time.
+	unsigned long long callsTimedOut;
+
+	/// The number of bytes of all paths constructed for directory entries, including the terminators.
+	unsigned long long pathBytes;
+
+	/// The number of memory allocations made while walking the directory tree.
+	unsigned long long allocations;
+
+	/// The number of files that matched all search criteria.
+	unsigned long long matches;
+
+	/// The number of files whose content was read.
+	unsigned long long filesRead;
+
+	/// The number of bytes read from file contents.
+	unsigned long long bytesRead;
+};
+
+extern _Thread_local struct RunStats ThreadStats;
+
+void StartStatsClock();
+void MergeThreadStats();
+void GetTotalStats(struct RunStats* totals);
+void RecordConcurrency(bool adaptive, unsigned int finalThreads, unsigned int peakThreads, unsigned int maxThreads, unsigned int adjustments);
+void RecordChunkWork(unsigned long long directories, unsigned int threadCount, const unsigned long long* chunks, const unsigned long long* entries);
+void PrintStats(FILE* stream);
+
+#endif